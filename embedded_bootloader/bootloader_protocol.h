@@ -26,6 +26,8 @@
 #ifndef EMBEDDED_BOOTLOADER_BOOTLOADER_PROTOCOL_H_
 #define EMBEDDED_BOOTLOADER_BOOTLOADER_PROTOCOL_H_
 
+#include "config.h"  // EBH_MAX_BUFFER_SIZE, EBH_MAX_RESPONSE_SIZE
+
 /*
  * BSL commands
  */
@@ -76,6 +78,17 @@
 #define EBH_UART_ERROR_UNKNOWN_ERROR               0x55
 #define EBH_UART_ERROR_UNKNOWN_BAUD_RATE           0x56
 #define EBH_UART_ERROR_TIME_OUT                    0xEE
+#define EBH_UART_ERROR_VERIFY_FAILED               0xEF  // CRC of the written range does not match
+#define EBH_UART_ERROR_SOURCE_ENDED                0xED  // The source of ebh_write_stream() ended early
+#define EBH_UART_ERROR_IMAGE_SYNTAX                0xEC  // Image file: unexpected character (image.h)
+#define EBH_UART_ERROR_IMAGE_CHECKSUM              0xEB  // Image file: record checksum does not match
+#define EBH_UART_ERROR_IMAGE_RECORD                0xEA  // Image file: unknown record type or wrong record length
+#define EBH_UART_ERROR_IMAGE_FORMAT                0xE9  // ELF file: not an executable for the device, or truncated (elf.h)
+#define EBH_UART_ERROR_IMAGE_ADDRESS               0xE8  // Image data outside the address space of the device
+#define EBH_UART_ERROR_PLAN_RANGES                 0xE7  // Write or erase plan: ranges out of order or overlapping, bad alignment (plan.h, erase.h)
+#define EBH_UART_ERROR_PLAN_FULL                   0xE6  // Write or erase plan: more packets or segments than the schedule holds
+#define EBH_UART_ERROR_PART_ADDRESS                0xE5  // Address outside the writable or erasable memory of the part (part.h)
+#define EBH_UART_ERROR_RESPONSE_INVALID            0xE4  // Core response of an unexpected type or length
 
 /*
  * UART baud rates
@@ -92,10 +105,13 @@
  */
 
 #define EBH_HEADER           0x80  // BSL protocol header byte
-#define EBH_MAX_BUFFER_SIZE  262
+#define EBH_FRAME_OVERHEAD   5     // HDR, NL, NH, CKL and CKH around the BSL core data packet
+#define EBH_MAX_FRAME_SIZE   (EBH_MAX_BUFFER_SIZE + EBH_FRAME_OVERHEAD)
+#define EBH_MAX_RESPONSE_FRAME_SIZE  (EBH_MAX_RESPONSE_SIZE + EBH_FRAME_OVERHEAD)
 #define EBH_SYNC_CHARACTER   0xFF  // Sync char used for MSP432 automatic baud rate detection
 #define EBH_DELAY_BETWEEN_COMMANDS  1200  // Time between BSL commands in microseconds
-#define EBH_ACK_RETRIES      1000  // Number of total retires for ACK
-#define EBH_ACK_RETRY_DELAY  10    // Delay in us until checking for ACK again
+#define EBH_ACK_TIMEOUT      10000  // Time in us the target may take to ACK once the last byte of a frame is on the line
+#define EBH_RESPONSE_TIMEOUT 1000000  // Time in us a complete core response may take (includes erase times)
+#define EBH_DEFAULT_DATA_BLOCK  256  // Data block size if the target does not answer TX_BUFFER_SIZE
 
 #endif /* EMBEDDED_BOOTLOADER_BOOTLOADER_PROTOCOL_H_ */
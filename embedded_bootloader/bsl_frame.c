@@ -0,0 +1,232 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Max Groening
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <stdint.h>
+#include "bsl_frame.h"
+#include "crc_ccitt.h"
+#include "embedded_bootloader/bootloader_protocol.h"
+
+
+uint8_t ebh_build_frame_header(uint8_t *header, uint8_t cmd, uint8_t a_len, uint8_t a0, uint8_t a1, uint8_t a2, uint8_t a3, uint16_t length) {
+
+    /*
+     * HDR   Header (0x80)
+     * NL    Length of BSL core data packet (low byte)
+     * NH    ... (high byte)
+     * [..]  BSL core command
+     * CKL   CRC checksum on BSL core data packet (low byte)
+     * CKH   ... (high byte)
+     */
+
+    uint16_t core_length = length + 1 + a_len;
+    uint8_t addr[4];
+    uint_fast8_t i = 0;
+
+    header[0] = EBH_HEADER;
+    header[1] = core_length & 0xFF;
+    header[2] = (core_length >> 8) & 0xFF;
+    header[3] = cmd;
+
+    addr[0] = a0;
+    addr[1] = a1;
+    addr[2] = a2;
+    addr[3] = a3;
+    for(i = 0; i < a_len; i++) {
+        header[4 + i] = addr[i];
+    }
+
+    return 4 + a_len;
+}
+
+uint16_t ebh_build_frame(uint8_t *frame, uint16_t size, uint8_t cmd, uint8_t a_len, uint8_t a0, uint8_t a1, uint8_t a2, uint8_t a3, const uint8_t *payload, uint16_t length) {
+    uint16_t core_length = length + 1 + a_len;
+    uint16_t crc = 0;
+    uint16_t i = 0;
+
+    if((a_len > 4) || ((uint32_t)core_length + EBH_FRAME_OVERHEAD > size)) {
+        return 0;
+    }
+
+    ebh_build_frame_header(frame, cmd, a_len, a0, a1, a2, a3, length);
+    for(i = 0; i < length; i++) {
+        frame[4 + a_len + i] = payload[i];
+    }
+
+    crc = ebh_crc_update(0xFFFF, &frame[3], core_length);
+    frame[3 + core_length] = crc & 0xFF;
+    frame[4 + core_length] = (crc >> 8) & 0xFF;
+
+    return core_length + EBH_FRAME_OVERHEAD;
+}
+
+
+/*
+ * Core response parser
+ */
+
+enum {
+    ebh_parser_hunt,
+    ebh_parser_length_low,
+    ebh_parser_length_high,
+    ebh_parser_data,
+    ebh_parser_crc_low,
+    ebh_parser_crc_high
+};
+
+void ebh_parser_init(ebh_response_parser *parser, uint8_t *payload, uint16_t max_buffer) {
+    parser->payload = payload;
+    parser->max_buffer = max_buffer;
+    parser->length = 0;
+    parser->index = 0;
+    parser->crc = 0;
+    parser->discarded = 0;
+    parser->state = ebh_parser_hunt;
+    parser->length_low = 0;
+}
+
+/*
+ * Feeds the bytes after a header whose frame failed the CRC back through the hunt, the real
+ * header may be among them. The replay writes the payload behind the byte it reads.
+ */
+static uint8_t ebh_parser_replay(ebh_response_parser *parser) {
+    uint16_t length = parser->length;
+    uint16_t crc = parser->crc;
+    uint8_t status = EBH_PARSER_IN_PROGRESS;
+    uint8_t character = 0;
+    uint16_t i = 0;
+
+    for(i = 0; i < length + 4; i++) {
+        if(i == 0) {
+            character = length & 0xFF;
+        } else if(i == 1) {
+            character = (length >> 8) & 0xFF;
+        } else if(i < length + 2) {
+            character = parser->payload[i - 2];
+        } else if(i == length + 2) {
+            character = crc & 0xFF;
+        } else {
+            character = (crc >> 8) & 0xFF;
+        }
+        status = ebh_parser_feed_byte(parser, character);
+        if((status != EBH_PARSER_IN_PROGRESS) && (status != EBH_UART_ERROR_CHECKSUM_INCORRECT)) {
+            return status;
+        }
+    }
+
+    // A candidate frame continues with the bytes still to come
+    return (parser->state == ebh_parser_hunt) ? EBH_UART_ERROR_CHECKSUM_INCORRECT : EBH_PARSER_IN_PROGRESS;
+}
+
+uint8_t ebh_parser_feed_byte(ebh_response_parser *parser, uint8_t character) {
+    switch(parser->state) {
+    case ebh_parser_hunt:
+        if(character == EBH_HEADER) {
+            parser->state = ebh_parser_length_low;
+        } else {
+            parser->discarded++;
+        }
+        break;
+
+    case ebh_parser_length_low:
+        parser->length_low = character;
+        parser->state = ebh_parser_length_high;
+        break;
+
+    case ebh_parser_length_high:
+        parser->length = parser->length_low + (character << 8);
+        if((parser->length == 0) || (parser->length > EBH_MAX_RESPONSE_SIZE)) {
+            // Not a real header, search again starting with the two length bytes
+            parser->discarded++;
+            parser->state = ebh_parser_hunt;
+            ebh_parser_feed_byte(parser, parser->length_low);
+            return ebh_parser_feed_byte(parser, character);
+        }
+        parser->index = 0;
+        parser->state = ebh_parser_data;
+        break;
+
+    case ebh_parser_data:
+        // A frame larger than the caller's buffer is consumed anyway to stay in sync
+        if(parser->index < parser->max_buffer) {
+            parser->payload[parser->index] = character;
+        }
+        parser->index++;
+        if(parser->index == parser->length) {
+            parser->state = ebh_parser_crc_low;
+        }
+        break;
+
+    case ebh_parser_crc_low:
+        parser->crc = character;
+        parser->state = ebh_parser_crc_high;
+        break;
+
+    case ebh_parser_crc_high:
+        parser->crc += character << 8;
+        parser->state = ebh_parser_hunt;
+        if(parser->length > parser->max_buffer) {
+            return EBH_UART_ERROR_PACKET_SIZE_EXCEEDS_BUFFER;
+        }
+        if(parser->crc != ebh_crc_update(0xFFFF, parser->payload, parser->length)) {
+            parser->discarded++;
+            return ebh_parser_replay(parser);
+        }
+        return EBH_UART_ERROR_ACK;
+    }
+
+    return EBH_PARSER_IN_PROGRESS;
+}
+
+uint8_t ebh_parser_feed(ebh_response_parser *parser, const uint8_t *data, uint16_t length, uint16_t *consumed) {
+    uint8_t status = EBH_PARSER_IN_PROGRESS;
+    uint16_t i = 0;
+
+    while((i < length) && (status == EBH_PARSER_IN_PROGRESS)) {
+        status = ebh_parser_feed_byte(parser, data[i++]);
+    }
+    if(consumed) {
+        *consumed = i;
+    }
+    return status;
+}
+
+
+/*
+ * Precomputed frames, the CRC is evaluated by the compiler
+ */
+
+const uint8_t ebh_frame_tx_bsl_version[EBH_CONST_FRAME_1_SIZE] = EBH_CONST_FRAME_1(EBH_CMD_TX_BSL_VERSION);
+const uint8_t ebh_frame_tx_buffer_size[EBH_CONST_FRAME_1_SIZE] = EBH_CONST_FRAME_1(EBH_CMD_TX_BUFFER_SIZE);
+const uint8_t ebh_frame_mass_erase[EBH_CONST_FRAME_1_SIZE] = EBH_CONST_FRAME_1(EBH_CMD_MASS_ERASE);
+const uint8_t ebh_frame_reboot_reset[EBH_CONST_FRAME_1_SIZE] = EBH_CONST_FRAME_1(EBH_CMD_REBOOT_RESET);
+const uint8_t ebh_frame_unlock_and_lock_info[EBH_CONST_FRAME_1_SIZE] = EBH_CONST_FRAME_1(EBH_CMD_UNLOCK_AND_LOCK_INFO);
+
+const uint8_t ebh_frame_change_baud_rate[EBH_BAUD_RATE_FRAMES][EBH_CONST_FRAME_2_SIZE] = {
+    EBH_CONST_FRAME_2(EBH_CMD_CHANGE_BAUD_RATE, EBH_UART_BAUD_RATE_9600),
+    EBH_CONST_FRAME_2(EBH_CMD_CHANGE_BAUD_RATE, EBH_UART_BAUD_RATE_19200),
+    EBH_CONST_FRAME_2(EBH_CMD_CHANGE_BAUD_RATE, EBH_UART_BAUD_RATE_38400),
+    EBH_CONST_FRAME_2(EBH_CMD_CHANGE_BAUD_RATE, EBH_UART_BAUD_RATE_56700),
+    EBH_CONST_FRAME_2(EBH_CMD_CHANGE_BAUD_RATE, EBH_UART_BAUD_RATE_115200)
+};
@@ -0,0 +1,104 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Max Groening
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef EMBEDDED_BOOTLOADER_BSL_FRAME_H_
+#define EMBEDDED_BOOTLOADER_BSL_FRAME_H_
+
+#include <stdint.h>
+#include "crc_ccitt.h"
+#include "embedded_bootloader/bootloader_protocol.h"
+
+#define EBH_MAX_FRAME_HEADER_SIZE  8  // HDR, NL, NH, command and up to four address bytes
+
+/* ebh_build_frame_header(...) writes everything in front of the payload and returns its length. */
+uint8_t ebh_build_frame_header(uint8_t *header, uint8_t cmd, uint8_t a_len, uint8_t a0, uint8_t a1, uint8_t a2, uint8_t a3, uint16_t length);
+
+/* ebh_build_frame(...) writes the complete BSL packet into frame and returns its length (0 if size is too small). */
+uint16_t ebh_build_frame(uint8_t *frame, uint16_t size, uint8_t cmd, uint8_t a_len, uint8_t a0, uint8_t a1, uint8_t a2, uint8_t a3, const uint8_t *payload, uint16_t length);
+
+/*
+ * Core response parser
+ *
+ * Incremental state machine, fed byte by byte (e.g. from an ISR) or with whole buffers (e.g. DMA).
+ * Bytes in front of the header are skipped and counted, a header with an impossible length is
+ * treated as noise. After a CRC failure the bytes following the header are searched again, the
+ * failure is returned if no other frame starts among them. Return values are EBH_PARSER_IN_PROGRESS until a frame is complete, then
+ * EBH_UART_ERROR_ACK or the EBH_UART_ERROR_* code describing the received frame.
+ */
+
+#define EBH_PARSER_IN_PROGRESS  0xFF
+
+typedef struct {
+    uint8_t *payload;
+    uint16_t max_buffer;
+    uint16_t length;
+    uint16_t index;
+    uint16_t crc;
+    uint16_t discarded;  // Bytes skipped while hunting for the header
+    uint8_t state;
+    uint8_t length_low;
+} ebh_response_parser;
+
+void ebh_parser_init(ebh_response_parser *parser, uint8_t *payload, uint16_t max_buffer);
+uint8_t ebh_parser_feed_byte(ebh_response_parser *parser, uint8_t character);
+uint8_t ebh_parser_feed(ebh_response_parser *parser, const uint8_t *data, uint16_t length, uint16_t *consumed);
+
+/*
+ * Compile time CRC for constant frames
+ *
+ * The CRC is linear, so a byte is folded in as the XOR of the table entries of its set bits.
+ * Every step expands its argument nine times, which is fine for the one and two byte core packets below.
+ */
+
+#define EBH_CRC_CONST_BITS(x)  ((((x) & 0x01) ? 0x1021 : 0) ^ (((x) & 0x02) ? 0x2042 : 0) ^ \
+                                (((x) & 0x04) ? 0x4084 : 0) ^ (((x) & 0x08) ? 0x8108 : 0) ^ \
+                                (((x) & 0x10) ? 0x1231 : 0) ^ (((x) & 0x20) ? 0x2462 : 0) ^ \
+                                (((x) & 0x40) ? 0x48C4 : 0) ^ (((x) & 0x80) ? 0x9188 : 0))
+#define EBH_CRC_CONST_STEP(crc, data)  ((((crc) << 8) & 0xFFFF) ^ EBH_CRC_CONST_BITS((((crc) >> 8) ^ (data)) & 0xFF))
+#define EBH_CRC_CONST_1(b0)       EBH_CRC_CONST_STEP(0xFFFF, b0)
+#define EBH_CRC_CONST_2(b0, b1)   EBH_CRC_CONST_STEP(EBH_CRC_CONST_1(b0), b1)
+
+#define EBH_CONST_FRAME_1_SIZE  (1 + EBH_FRAME_OVERHEAD)
+#define EBH_CONST_FRAME_2_SIZE  (2 + EBH_FRAME_OVERHEAD)
+
+#define EBH_CONST_FRAME_1(cmd)  {EBH_HEADER, 0x01, 0x00, (cmd), \
+                                 EBH_CRC_CONST_1(cmd) & 0xFF, (EBH_CRC_CONST_1(cmd) >> 8) & 0xFF}
+#define EBH_CONST_FRAME_2(cmd, data)  {EBH_HEADER, 0x02, 0x00, (cmd), (data), \
+                                       EBH_CRC_CONST_2(cmd, data) & 0xFF, (EBH_CRC_CONST_2(cmd, data) >> 8) & 0xFF}
+
+/*
+ * Precomputed frames of commands without variable data
+ */
+
+#define EBH_BAUD_RATE_FRAMES  (EBH_UART_BAUD_RATE_115200 - EBH_UART_BAUD_RATE_9600 + 1)
+
+extern const uint8_t ebh_frame_tx_bsl_version[EBH_CONST_FRAME_1_SIZE];
+extern const uint8_t ebh_frame_tx_buffer_size[EBH_CONST_FRAME_1_SIZE];
+extern const uint8_t ebh_frame_mass_erase[EBH_CONST_FRAME_1_SIZE];
+extern const uint8_t ebh_frame_reboot_reset[EBH_CONST_FRAME_1_SIZE];
+extern const uint8_t ebh_frame_unlock_and_lock_info[EBH_CONST_FRAME_1_SIZE];
+extern const uint8_t ebh_frame_change_baud_rate[EBH_BAUD_RATE_FRAMES][EBH_CONST_FRAME_2_SIZE];  // Index: baud rate code - EBH_UART_BAUD_RATE_9600
+
+#endif /* EMBEDDED_BOOTLOADER_BSL_FRAME_H_ */
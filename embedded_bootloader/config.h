@@ -0,0 +1,264 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Max Groening
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef EMBEDDED_BOOTLOADER_CONFIG_H_
+#define EMBEDDED_BOOTLOADER_CONFIG_H_
+
+/*
+ * Build time configuration
+ *
+ * Every option may be overridden from the compiler command line,
+ * e.g. -DEBH_CRC_IMPLEMENTATION=EBH_CRC_BITWISE
+ */
+
+/*
+ * CRC CCITT implementation
+ */
+
+#define EBH_CRC_BITWISE     1  // No table, smallest and slowest
+#define EBH_CRC_TABLE       2  // 256 entry table (512 byte)
+#define EBH_CRC_SLICE_BY_4  3  // 4 x 256 entry tables (2 kbyte)
+#define EBH_CRC_SLICE_BY_8  4  // 8 x 256 entry tables (4 kbyte)
+
+#ifndef EBH_CRC_IMPLEMENTATION
+#define EBH_CRC_IMPLEMENTATION  EBH_CRC_TABLE
+#endif
+
+/*
+ * Largest BSL core data packet (command, address and data) the host sends.
+ * Data blocks are sized to the smaller one of this and the buffer reported by TX_BUFFER_SIZE.
+ * 262 is enough for the 256 byte blocks every BSL accepts; the TX buffers of the DMA UART
+ * grow with it.
+ */
+
+#ifndef EBH_MAX_BUFFER_SIZE
+#define EBH_MAX_BUFFER_SIZE  1029
+#endif
+
+/*
+ * Largest BSL core response the host accepts, longer lengths are taken as line noise.
+ * Limits the blocks read with TX_DATA_BLOCK and sizes the receive buffers of the SPI and
+ * I2C backends. Larger values speed up readback but resynchronize less reliably.
+ */
+
+#ifndef EBH_MAX_RESPONSE_SIZE
+#define EBH_MAX_RESPONSE_SIZE  262
+#endif
+
+/*
+ * UART (polling) interface
+ *
+ * Set EBH_UART_POLL_SEND_BUF to 0 if the BSP does not implement ebh_uart_poll_send_buf(),
+ * frames are then sent byte by byte through ebh_uart_poll_send_char().
+ */
+
+#ifndef EBH_UART_POLL_SEND_BUF
+#define EBH_UART_POLL_SEND_BUF  1
+#endif
+
+/*
+ * UART (polling) interface, time between two polls for a received byte (us)
+ */
+
+#ifndef EBH_UART_POLL_INTERVAL
+#define EBH_UART_POLL_INTERVAL  10
+#endif
+
+/*
+ * UART (interrupt) interface, ring buffer sizes (power of two)
+ */
+
+#ifndef EBH_UART_IRQ_TX_SIZE
+#define EBH_UART_IRQ_TX_SIZE  512
+#endif
+
+#ifndef EBH_UART_IRQ_RX_SIZE
+#define EBH_UART_IRQ_RX_SIZE  512
+#endif
+
+/*
+ * UART (DMA) interface, size of the circular RX buffer (max. 1024 on the TM4C uDMA)
+ */
+
+#ifndef EBH_UART_DMA_RX_SIZE
+#define EBH_UART_DMA_RX_SIZE  512
+#endif
+
+/*
+ * SPI interface, time between two polls for the answer of the target (us)
+ */
+
+#ifndef EBH_SPI_POLL_INTERVAL
+#define EBH_SPI_POLL_INTERVAL  10
+#endif
+
+/*
+ * I2C interface: 7 bit target address, time between two polls for the answer of the
+ * target (us) and longest clock stretching accepted (us)
+ */
+
+#ifndef EBH_I2C_ADDRESS
+#define EBH_I2C_ADDRESS  0x48
+#endif
+
+#ifndef EBH_I2C_POLL_INTERVAL
+#define EBH_I2C_POLL_INTERVAL  50
+#endif
+
+#ifndef EBH_I2C_STRETCH_TIMEOUT
+#define EBH_I2C_STRETCH_TIMEOUT  20000
+#endif
+
+/*
+ * Link (baud rate) management, see link.h:
+ * frames per monitoring window, line errors per window that step the baud rate down,
+ * TX_BSL_VERSION probes a negotiated baud rate has to pass and attempts of CHANGE_BAUD_RATE
+ */
+
+#ifndef EBH_LINK_WINDOW
+#define EBH_LINK_WINDOW  32
+#endif
+
+#ifndef EBH_LINK_MAX_ERRORS
+#define EBH_LINK_MAX_ERRORS  3
+#endif
+
+#ifndef EBH_LINK_PROBES
+#define EBH_LINK_PROBES  8
+#endif
+
+#ifndef EBH_LINK_RETRIES
+#define EBH_LINK_RETRIES  3
+#endif
+
+/*
+ * Retransmission of failed data block frames, see ebh_set_retry_policy():
+ * attempts after the first one, backoff before the first retry (doubled for every further
+ * one) and the largest random jitter added to it, both in us
+ */
+
+#ifndef EBH_RETRIES
+#define EBH_RETRIES  3
+#endif
+
+#ifndef EBH_RETRY_BACKOFF
+#define EBH_RETRY_BACKOFF  1000
+#endif
+
+#ifndef EBH_RETRY_JITTER
+#define EBH_RETRY_JITTER  500
+#endif
+
+/*
+ * Gap between BSL commands, see gap.h: policy used until ebh_gap_set_policy() is called,
+ * commands in a row a calibrated gap has to pass, resolution of the search and margin added
+ * to the shortest gap found, both in us
+ */
+
+#ifndef EBH_GAP_POLICY
+#define EBH_GAP_POLICY  ebh_gap_fixed
+#endif
+
+#ifndef EBH_GAP_TRIALS
+#define EBH_GAP_TRIALS  8
+#endif
+
+#ifndef EBH_GAP_RESOLUTION
+#define EBH_GAP_RESOLUTION  20
+#endif
+
+#ifndef EBH_GAP_MARGIN
+#define EBH_GAP_MARGIN  50
+#endif
+
+/*
+ * Image files (image.h), bytes ebh_image_load() pulls from the source at once (on the stack)
+ */
+
+#ifndef EBH_IMAGE_READ_SIZE
+#define EBH_IMAGE_READ_SIZE  64
+#endif
+
+/*
+ * Write planner (plan.h): default write granularity (128 bit MSP432 flash word) and shortest
+ * 0xFF run left out, time in us the target takes per command and per byte programmed
+ */
+
+#ifndef EBH_PLAN_ALIGN
+#define EBH_PLAN_ALIGN  16
+#endif
+
+#ifndef EBH_PLAN_BLANK
+#define EBH_PLAN_BLANK  32
+#endif
+
+#ifndef EBH_PLAN_COMMAND_TIME
+#define EBH_PLAN_COMMAND_TIME  100
+#endif
+
+#ifndef EBH_PLAN_BYTE_TIME
+#define EBH_PLAN_BYTE_TIME  15
+#endif
+
+/*
+ * Erase planner (erase.h), time in us the target takes to erase one segment and main memory
+ */
+
+#ifndef EBH_ERASE_SEGMENT_TIME
+#define EBH_ERASE_SEGMENT_TIME  25000
+#endif
+
+#ifndef EBH_ERASE_MASS_TIME
+#define EBH_ERASE_MASS_TIME  100000
+#endif
+
+/*
+ * Target part (part.h) if it is fixed at compile time, e.g. -DEBH_PART=ebh_part_msp430f5529.
+ * Not defined by default, the part is passed to the planners at run time then.
+ */
+
+/*
+ * Memory barrier between the ring buffer data and index accesses.
+ * A compiler barrier is sufficient on single core MCUs, hosts need a real fence.
+ */
+
+#ifndef EBH_MEMORY_BARRIER
+#if defined(__GNUC__)
+#define EBH_MEMORY_BARRIER()  __sync_synchronize()
+#else
+#define EBH_MEMORY_BARRIER()
+#endif
+#endif
+
+/*
+ * Transport used until ebh_set_transport() is called.
+ * Set to 0 if the application always selects one (the polling UART is not linked then).
+ */
+
+#ifndef EBH_DEFAULT_TRANSPORT
+#define EBH_DEFAULT_TRANSPORT  &ebh_transport_uart_poll
+#endif
+
+#endif /* EMBEDDED_BOOTLOADER_CONFIG_H_ */
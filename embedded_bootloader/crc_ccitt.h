@@ -0,0 +1,55 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Max Groening
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef EMBEDDED_BOOTLOADER_CRC_CCITT_H_
+#define EMBEDDED_BOOTLOADER_CRC_CCITT_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "config.h"
+
+/*
+ * CRC CCITT algorithm
+ */
+
+void ebh_crc_init(void);
+void ebh_crc(uint8_t data);
+void ebh_crc_block(const uint8_t *data, size_t length);
+uint16_t ebh_crc_result(void);
+
+/*
+ * Stateless backends, crc is the running value (0xFFFF to start).
+ * ebh_crc_update() uses the backend selected by EBH_CRC_IMPLEMENTATION.
+ * Table based backends are only linked if the selected one needs at least
+ * as many tables (e.g. EBH_CRC_SLICE_BY_8 provides all of them).
+ */
+
+uint16_t ebh_crc_update(uint16_t crc, const uint8_t *data, size_t length);
+uint16_t ebh_crc_update_bitwise(uint16_t crc, const uint8_t *data, size_t length);
+uint16_t ebh_crc_update_table(uint16_t crc, const uint8_t *data, size_t length);
+uint16_t ebh_crc_update_slice_by_4(uint16_t crc, const uint8_t *data, size_t length);
+uint16_t ebh_crc_update_slice_by_8(uint16_t crc, const uint8_t *data, size_t length);
+
+#endif /* EMBEDDED_BOOTLOADER_CRC_CCITT_H_ */
@@ -0,0 +1,688 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Max Groening
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <time.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <linux/spi/spidev.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+
+#include "embedded_bootloader/devices/bsp_posix.h"
+#include "embedded_bootloader/devices/devices.h"
+#include "embedded_bootloader/bootloader_protocol.h"
+#include "embedded_bootloader/config.h"
+
+#define EBH_POSIX_MAX_IOV  16
+#define EBH_POSIX_SPI_CHUNK  256
+
+static int ebh_posix_serial = -1;
+static const ebh_posix_gpio *ebh_posix_pins = 0;
+static uint8_t ebh_posix_irq_enabled = 0;
+static int ebh_posix_spi = -1;
+static uint32_t ebh_posix_spi_clock = 1000000;
+static uint8_t ebh_posix_spi_selected = 0;
+static int ebh_posix_i2c = -1;
+
+
+/*
+ * Serial port
+ */
+
+static speed_t ebh_posix_speed(uint32_t baud) {
+    switch(baud) {
+    case 9600: return B9600;
+    case 19200: return B19200;
+    case 38400: return B38400;
+    case 57600: return B57600;
+    case 115200: return B115200;
+    case 230400: return B230400;
+#ifdef B460800
+    case 460800: return B460800;
+#endif
+#ifdef B921600
+    case 921600: return B921600;
+#endif
+    default: return 0;
+    }
+}
+
+int ebh_posix_open(const char *path, uint32_t baud) {
+    ebh_posix_close();
+    ebh_posix_serial = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if(ebh_posix_serial < 0) {
+        return -1;
+    }
+    if(ebh_posix_configure(baud) < 0) {
+        ebh_posix_close();
+        return -1;
+    }
+    tcflush(ebh_posix_serial, TCIOFLUSH);
+    return 0;
+}
+
+void ebh_posix_close(void) {
+    if(ebh_posix_serial >= 0) {
+        close(ebh_posix_serial);
+        ebh_posix_serial = -1;
+    }
+}
+
+int ebh_posix_configure(uint32_t baud) {
+    struct termios tio;
+    speed_t speed = ebh_posix_speed(baud);
+
+    if(speed == 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    if(tcgetattr(ebh_posix_serial, &tio) < 0) {
+        return -1;
+    }
+
+    // Raw 8E1, no flow control
+    cfmakeraw(&tio);
+    tio.c_cflag &= ~(CSIZE | CSTOPB | PARODD | CRTSCTS);
+    tio.c_cflag |= CS8 | PARENB | CLOCAL | CREAD;
+    tio.c_iflag &= ~(IXON | IXOFF | IXANY | INPCK);
+    tio.c_cc[VMIN] = 0;
+    tio.c_cc[VTIME] = 0;
+    cfsetispeed(&tio, speed);
+    cfsetospeed(&tio, speed);
+
+    // Bytes still queued have to leave with the old baud rate
+    return tcsetattr(ebh_posix_serial, TCSADRAIN, &tio);
+}
+
+int ebh_posix_fd(void) {
+    return ebh_posix_serial;
+}
+
+/* Waits until the port is readable / writable, returns 0 on timeout */
+static uint8_t ebh_posix_wait(short events, uint32_t timeout_us) {
+    struct pollfd pfd;
+    int timeout_ms = (timeout_us == EBH_TIMEOUT_INFINITE) ? -1 : (int)((timeout_us + 999u) / 1000u);
+    int result = 0;
+
+    pfd.fd = ebh_posix_serial;
+    pfd.events = events;
+    do {
+        result = poll(&pfd, 1, timeout_ms);
+    } while((result < 0) && (errno == EINTR));
+    return (result > 0) ? 1 : 0;
+}
+
+static void ebh_posix_write(const uint8_t *data, size_t length) {
+    ssize_t written = 0;
+
+    while(length) {
+        written = write(ebh_posix_serial, data, length);
+        if(written > 0) {
+            data += written;
+            length -= written;
+        } else if((written < 0) && (errno != EAGAIN) && (errno != EINTR)) {
+            return;  // Port gone, the missing answer reports the error
+        } else {
+            ebh_posix_wait(POLLOUT, EBH_TIMEOUT_INFINITE);
+        }
+    }
+}
+
+static uint16_t ebh_posix_read(uint8_t *data, uint16_t length) {
+    ssize_t result = read(ebh_posix_serial, data, length);
+    return (result > 0) ? (uint16_t)result : 0;
+}
+
+static uint16_t ebh_posix_available(void) {
+    int count = 0;
+
+    if(ioctl(ebh_posix_serial, FIONREAD, &count) < 0) {
+        return 0;
+    }
+    return (count > 0xFFFF) ? 0xFFFF : (uint16_t)count;
+}
+
+static uint8_t ebh_posix_tx_done(void) {
+    int count = 0;
+
+    if(ioctl(ebh_posix_serial, TIOCOUTQ, &count) < 0) {
+        return 1;
+    }
+    return (count == 0) ? 1 : 0;
+}
+
+
+/*
+ * General device initialization and support functions
+ */
+
+void ebh_device_init(void) {
+}
+
+void ebh_delay_100_us(void) {
+    ebh_delay_us(100);
+}
+
+void ebh_delay_us(uint16_t time) {
+    struct timespec deadline;
+
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_nsec += time * 1000l;
+    if(deadline.tv_nsec >= 1000000000l) {
+        deadline.tv_sec += deadline.tv_nsec / 1000000000l;
+        deadline.tv_nsec %= 1000000000l;
+    }
+    while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, 0) == EINTR);
+
+    // Received bytes raise the "interrupt" while the application waits
+    if(ebh_posix_irq_enabled && ebh_posix_available()) {
+        ebh_uart_irq_isr();
+    }
+}
+
+uint32_t ebh_time_us(void) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint32_t)((uint64_t)now.tv_sec * 1000000u + (uint64_t)now.tv_nsec / 1000u);
+}
+
+
+/*
+ * UART peripheral interface - polling based
+ */
+
+void ebh_uart_poll_init() {
+}
+
+void ebh_uart_poll_configure_9600_baud() {
+    ebh_posix_configure(9600);
+}
+
+void ebh_uart_poll_configure_115200_baud() {
+    ebh_posix_configure(115200);
+}
+
+uint8_t ebh_uart_poll_configure_baud(uint32_t baud) {
+    return (ebh_posix_configure(baud) < 0) ? EBH_UART_ERROR_UNKNOWN_BAUD_RATE : 0;
+}
+
+void ebh_uart_poll_send_char(uint8_t character) {
+    ebh_posix_write(&character, 1);
+}
+
+void ebh_uart_poll_send_buf(const uint8_t *data, uint16_t length) {
+    ebh_posix_write(data, length);
+}
+
+uint8_t ebh_uart_poll_receive_char() {
+    uint8_t character = 0;
+
+    while(!ebh_posix_read(&character, 1)) {
+        if(!ebh_posix_wait(POLLIN, EBH_TIMEOUT_INFINITE)) {
+            break;
+        }
+    }
+    return character;
+}
+
+uint16_t ebh_uart_poll_receive_char_available() {
+    return ebh_posix_available();
+}
+
+
+/*
+ * UART peripheral interface - interrupt based
+ * There is no interrupt on a serial port file: the ISR runs synchronously when TX is
+ * enabled and while delays find received bytes.
+ */
+
+void ebh_uart_irq_init(void) {
+    ebh_posix_irq_enabled = 1;
+}
+
+uint8_t ebh_uart_irq_hw_rx_ready(void) {
+    return ebh_posix_available() ? 1 : 0;
+}
+
+uint8_t ebh_uart_irq_hw_read(void) {
+    uint8_t character = 0;
+    ebh_posix_read(&character, 1);
+    return character;
+}
+
+uint8_t ebh_uart_irq_hw_tx_ready(void) {
+    return 1;
+}
+
+void ebh_uart_irq_hw_write(uint8_t character) {
+    ebh_posix_write(&character, 1);
+}
+
+uint8_t ebh_uart_irq_hw_tx_done(void) {
+    return ebh_posix_tx_done();
+}
+
+void ebh_uart_irq_hw_tx_enable(uint8_t enable) {
+    if(enable) {
+        ebh_uart_irq_isr();
+    }
+}
+
+
+/*
+ * UART peripheral interface - DMA based
+ * The kernel driver is the DMA: TX is handed over with one write(), RX moves the bytes
+ * received up to now whenever the remaining count is polled.
+ */
+
+static ebh_dma_callback ebh_posix_dma_tx_done = 0;
+static ebh_dma_callback ebh_posix_dma_rx_done = 0;
+static uint8_t *ebh_posix_dma_rx_data = 0;
+static uint16_t ebh_posix_dma_rx_length = 0;
+static uint16_t ebh_posix_dma_rx_count = 0;
+
+void ebh_uart_dma_init(ebh_dma_callback tx_done, ebh_dma_callback rx_done) {
+    ebh_posix_dma_tx_done = tx_done;
+    ebh_posix_dma_rx_done = rx_done;
+    ebh_posix_dma_rx_data = 0;
+}
+
+void ebh_uart_dma_tx_start(const uint8_t *data, uint16_t length) {
+    ebh_posix_write(data, length);
+    if(ebh_posix_dma_tx_done) {
+        ebh_posix_dma_tx_done();
+    }
+}
+
+void ebh_uart_dma_rx_start(uint8_t *data, uint16_t length) {
+    ebh_posix_dma_rx_data = data;
+    ebh_posix_dma_rx_length = length;
+    ebh_posix_dma_rx_count = 0;
+}
+
+uint8_t ebh_uart_dma_tx_busy(void) {
+    return !ebh_posix_tx_done();
+}
+
+uint16_t ebh_uart_dma_rx_remaining(void) {
+    uint16_t received = 0;
+
+    while(ebh_posix_dma_rx_data) {
+        received = ebh_posix_read(&ebh_posix_dma_rx_data[ebh_posix_dma_rx_count], ebh_posix_dma_rx_length - ebh_posix_dma_rx_count);
+        if(received == 0) {
+            break;
+        }
+        ebh_posix_dma_rx_count += received;
+        if(ebh_posix_dma_rx_count == ebh_posix_dma_rx_length) {
+            ebh_posix_dma_rx_data = 0;
+            if(ebh_posix_dma_rx_done) {
+                ebh_posix_dma_rx_done();
+            }
+        }
+    }
+    return ebh_posix_dma_rx_data ? (ebh_posix_dma_rx_length - ebh_posix_dma_rx_count) : 0;
+}
+
+
+/*
+ * SPI peripheral interface - Linux spidev
+ * The kernel drives the chip select per message: while selected, every transfer keeps it
+ * asserted (cs_change), deselecting sends an empty transfer that releases it.
+ */
+
+static uint8_t ebh_posix_spi_fill[EBH_POSIX_SPI_CHUNK];  // MOSI while only reading
+
+static void ebh_posix_spi_message(const uint8_t *tx, uint8_t *rx, uint16_t length, uint8_t keep_selected) {
+    struct spi_ioc_transfer transfer;
+
+    memset(&transfer, 0, sizeof(transfer));
+    transfer.tx_buf = (unsigned long)tx;
+    transfer.rx_buf = (unsigned long)rx;
+    transfer.len = length;
+    transfer.speed_hz = ebh_posix_spi_clock;
+    transfer.bits_per_word = 8;
+    transfer.cs_change = keep_selected;
+    ioctl(ebh_posix_spi, SPI_IOC_MESSAGE(1), &transfer);
+}
+
+int ebh_posix_spi_open(const char *path, uint32_t clock_hz) {
+    uint8_t mode = SPI_MODE_0;
+    uint8_t bits = 8;
+
+    ebh_posix_spi_close();
+    memset(ebh_posix_spi_fill, 0xFF, sizeof(ebh_posix_spi_fill));
+    ebh_posix_spi = open(path, O_RDWR);
+    if(ebh_posix_spi < 0) {
+        return -1;
+    }
+    if((ioctl(ebh_posix_spi, SPI_IOC_WR_MODE, &mode) < 0) || (ioctl(ebh_posix_spi, SPI_IOC_WR_BITS_PER_WORD, &bits) < 0)) {
+        ebh_posix_spi_close();
+        return -1;
+    }
+    ebh_spi_configure(clock_hz);
+    return 0;
+}
+
+void ebh_posix_spi_close(void) {
+    if(ebh_posix_spi >= 0) {
+        close(ebh_posix_spi);
+        ebh_posix_spi = -1;
+    }
+}
+
+void ebh_spi_init(void) {
+}
+
+void ebh_spi_configure(uint32_t clock_hz) {
+    ebh_posix_spi_clock = clock_hz;
+    ioctl(ebh_posix_spi, SPI_IOC_WR_MAX_SPEED_HZ, &ebh_posix_spi_clock);
+}
+
+void ebh_spi_select(uint8_t active) {
+    if(!active && ebh_posix_spi_selected) {
+        ebh_posix_spi_message(0, 0, 0, 0);
+    }
+    ebh_posix_spi_selected = active;
+}
+
+void ebh_spi_transfer(const uint8_t *tx, uint8_t *rx, uint16_t length) {
+    uint16_t chunk = 0;
+
+    while(length) {
+        chunk = tx ? length : ((length > EBH_POSIX_SPI_CHUNK) ? EBH_POSIX_SPI_CHUNK : length);
+        ebh_posix_spi_message(tx ? tx : ebh_posix_spi_fill, rx, chunk, ebh_posix_spi_selected);
+        if(tx) {
+            tx += chunk;
+        }
+        if(rx) {
+            rx += chunk;
+        }
+        length -= chunk;
+    }
+}
+
+
+/*
+ * I2C peripheral interface - Linux i2c-dev
+ */
+
+static uint8_t ebh_posix_i2c_frame[EBH_MAX_FRAME_SIZE];
+
+int ebh_posix_i2c_open(const char *path) {
+    ebh_posix_i2c_close();
+    ebh_posix_i2c = open(path, O_RDWR);
+    if(ebh_posix_i2c < 0) {
+        return -1;
+    }
+    ioctl(ebh_posix_i2c, I2C_TIMEOUT, (EBH_I2C_STRETCH_TIMEOUT + 9999) / 10000);  // Units of 10 ms
+    return 0;
+}
+
+void ebh_posix_i2c_close(void) {
+    if(ebh_posix_i2c >= 0) {
+        close(ebh_posix_i2c);
+        ebh_posix_i2c = -1;
+    }
+}
+
+static uint8_t ebh_posix_i2c_transfer(uint8_t address, uint16_t flags, uint8_t *data, uint16_t length) {
+    struct i2c_msg message;
+    struct i2c_rdwr_ioctl_data transfer;
+
+    message.addr = address;
+    message.flags = flags;
+    message.len = length;
+    message.buf = data;
+    transfer.msgs = &message;
+    transfer.nmsgs = 1;
+    if(ioctl(ebh_posix_i2c, I2C_RDWR, &transfer) < 0) {
+        return (errno == ETIMEDOUT) ? EBH_I2C_TIMEOUT : EBH_I2C_NACK;
+    }
+    return EBH_I2C_OK;
+}
+
+void ebh_i2c_init(void) {
+}
+
+void ebh_i2c_configure(uint32_t clock_hz) {
+    // Fixed by the kernel (device tree), nothing to do from user space
+}
+
+uint8_t ebh_i2c_write(uint8_t address, const ebh_iovec *iov, uint8_t count) {
+    uint16_t length = 0;
+
+    // One message has to be one buffer
+    while(count--) {
+        if(length + iov->length > sizeof(ebh_posix_i2c_frame)) {
+            return EBH_I2C_NACK;
+        }
+        memcpy(&ebh_posix_i2c_frame[length], iov->data, iov->length);
+        length += iov->length;
+        iov++;
+    }
+    return ebh_posix_i2c_transfer(address, 0, ebh_posix_i2c_frame, length);
+}
+
+uint8_t ebh_i2c_read(uint8_t address, uint8_t *data, uint16_t length) {
+    return ebh_posix_i2c_transfer(address, I2C_M_RD, data, length);
+}
+
+
+/*
+ * Reset and Test pin
+ */
+
+void ebh_posix_set_gpio(const ebh_posix_gpio *gpio) {
+    ebh_posix_pins = gpio;
+}
+
+static void ebh_posix_modem_line(int line, uint8_t level) {
+    ioctl(ebh_posix_serial, level ? TIOCMBIS : TIOCMBIC, &line);
+}
+
+static void ebh_posix_rts(void *context, uint8_t level) {
+    ebh_posix_modem_line(TIOCM_RTS, level);
+}
+
+static void ebh_posix_dtr(void *context, uint8_t level) {
+    ebh_posix_modem_line(TIOCM_DTR, level);
+}
+
+const ebh_posix_gpio ebh_posix_gpio_modem_lines = {
+    ebh_posix_rts,
+    ebh_posix_dtr,
+    0
+};
+
+void ebh_invoke_seqence_pre(void) {
+}
+
+void ebh_invoke_seqence_post(void) {
+}
+
+void ebh_rst_pin_high(void) {
+    if(ebh_posix_pins) {
+        ebh_posix_pins->rst(ebh_posix_pins->context, 1);
+    }
+}
+
+void ebh_rst_pin_low(void) {
+    if(ebh_posix_pins) {
+        ebh_posix_pins->rst(ebh_posix_pins->context, 0);
+    }
+}
+
+void ebh_test_pin_high(void) {
+    if(ebh_posix_pins) {
+        ebh_posix_pins->test(ebh_posix_pins->context, 1);
+    }
+}
+
+void ebh_test_pin_low(void) {
+    if(ebh_posix_pins) {
+        ebh_posix_pins->test(ebh_posix_pins->context, 0);
+    }
+}
+
+
+/*
+ * Serial port transport
+ */
+
+static void ebh_posix_send(void *context, const ebh_iovec *iov, uint8_t count) {
+    struct iovec vec[EBH_POSIX_MAX_IOV];
+    ssize_t written = 0;
+    uint8_t n = 0;
+    uint8_t i = 0;
+
+    while(count) {
+        n = (count > EBH_POSIX_MAX_IOV) ? EBH_POSIX_MAX_IOV : count;
+        for(i = 0; i < n; i++) {
+            vec[i].iov_base = (void *)iov[i].data;
+            vec[i].iov_len = iov[i].length;
+        }
+
+        written = writev(ebh_posix_serial, vec, n);
+        if(written < 0) {
+            written = 0;
+        }
+        // Partial write: the rest of the segments byte exact
+        for(i = 0; i < n; i++) {
+            if((size_t)written >= iov[i].length) {
+                written -= iov[i].length;
+            } else {
+                ebh_posix_write(&iov[i].data[written], iov[i].length - written);
+                written = 0;
+            }
+        }
+        iov += n;
+        count -= n;
+    }
+}
+
+static uint8_t ebh_posix_wait_readable(void *context, uint32_t timeout_us) {
+    return ebh_posix_wait(POLLIN, timeout_us);
+}
+
+static uint16_t ebh_posix_receive(void *context, uint8_t *data, uint16_t length, uint32_t timeout_us) {
+    uint16_t received = 0;
+
+    while(received < length) {
+        received += ebh_posix_read(&data[received], length - received);
+        if((received < length) && !ebh_posix_wait(POLLIN, timeout_us)) {
+            break;
+        }
+    }
+    return received;
+}
+
+static void ebh_posix_flush(void *context) {
+    tcflush(ebh_posix_serial, TCIFLUSH);
+}
+
+static void ebh_posix_wait_tx_idle(void *context) {
+    tcdrain(ebh_posix_serial);
+}
+
+static uint8_t ebh_posix_set_baud(void *context, uint32_t baud) {
+    return (ebh_posix_configure(baud) < 0) ? EBH_UART_ERROR_UNKNOWN_BAUD_RATE : 0;
+}
+
+const ebh_transport ebh_transport_posix = {
+    ebh_posix_send,
+    ebh_posix_receive,
+    ebh_posix_wait_readable,
+    ebh_posix_flush,
+    ebh_posix_set_baud,
+    ebh_posix_wait_tx_idle,
+    0
+};
+
+
+/*
+ * Readback into a file
+ */
+
+uint8_t ebh_posix_write_sink(void *context, uint32_t addr, const uint8_t *data, uint16_t length) {
+    int fd = *(const int *)context;
+    ssize_t written = 0;
+
+    while(length > 0) {
+        written = write(fd, data, length);
+        if(written < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            return EBH_UART_ERROR_UNKNOWN_ERROR;
+        }
+        data += written;
+        length -= written;
+    }
+    return 0;
+}
+
+uint16_t ebh_posix_read_source(void *context, uint8_t *data, uint16_t length) {
+    int fd = *(const int *)context;
+    ssize_t received = 0;
+
+    do {
+        received = read(fd, data, length);
+    } while((received < 0) && (errno == EINTR));
+    return (received > 0) ? (uint16_t)received : 0;
+}
+
+const uint8_t *ebh_posix_map(const char *path, uint32_t *size) {
+    struct stat status;
+    void *data = MAP_FAILED;
+    int fd = open(path, O_RDONLY);
+
+    if(fd < 0) {
+        return 0;
+    }
+    if((fstat(fd, &status) == 0) && (status.st_size > 0) && (status.st_size <= 0xFFFFFFFF)) {
+        data = mmap(0, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);  // The mapping stays valid
+
+    if(data == MAP_FAILED) {
+        return 0;
+    }
+    *size = (uint32_t)status.st_size;
+    return (const uint8_t *)data;
+}
+
+void ebh_posix_unmap(const uint8_t *data, uint32_t size) {
+    munmap((void *)data, size);
+}
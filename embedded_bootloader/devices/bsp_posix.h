@@ -0,0 +1,89 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Max Groening
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef EMBEDDED_BOOTLOADER_DEVICES_BSP_POSIX_H_
+#define EMBEDDED_BOOTLOADER_DEVICES_BSP_POSIX_H_
+
+#include <stdint.h>
+#include "embedded_bootloader/transport.h"
+
+/*
+ * POSIX board support package (Linux, serial port via termios)
+ *
+ * Call ebh_posix_open() before ebh_uart_poll_init() / any BSL command.
+ * For the SPI / I2C transport open a spidev / i2c-dev device with ebh_posix_spi_open() /
+ * ebh_posix_i2c_open() instead.
+ * The RST and TEST pins are driven through ebh_posix_gpio callbacks, by default they are
+ * not connected. ebh_posix_gpio_modem_lines drives them with the RTS / DTR lines of the
+ * serial port, as used by common USB-serial BSL adapters.
+ */
+
+typedef struct {
+    void (*rst)(void *context, uint8_t level);
+    void (*test)(void *context, uint8_t level);
+    void *context;
+} ebh_posix_gpio;
+
+int ebh_posix_open(const char *path, uint32_t baud);  // Returns 0, or -1 with errno set
+void ebh_posix_close(void);
+int ebh_posix_configure(uint32_t baud);  // 8E1, returns -1 for baud rates termios does not know
+int ebh_posix_fd(void);
+void ebh_posix_set_gpio(const ebh_posix_gpio *gpio);  // 0 restores the no-op default
+int ebh_posix_spi_open(const char *path, uint32_t clock_hz);  // e.g. "/dev/spidev0.0", returns 0 or -1
+void ebh_posix_spi_close(void);
+int ebh_posix_i2c_open(const char *path);  // e.g. "/dev/i2c-1", the bus clock is set by the kernel
+void ebh_posix_i2c_close(void);
+
+extern const ebh_posix_gpio ebh_posix_gpio_modem_lines;  // RST on RTS, TEST on DTR
+
+/*
+ * Transport on the serial port: writev() for frames, poll() for readiness, bulk read()
+ * and any baud rate termios supports.
+ */
+
+extern const ebh_transport ebh_transport_posix;
+
+/*
+ * Readback sink (ebh_sink) writing the blocks to a file, context points to the file descriptor.
+ * E.g. ebh_tx_data_block_32(0, 0x40000, ebh_posix_write_sink, &fd) dumps a 256 kB MSP432 flash.
+ */
+
+uint8_t ebh_posix_write_sink(void *context, uint32_t addr, const uint8_t *data, uint16_t length);
+
+/*
+ * Source (ebh_source) reading a file, context points to the file descriptor.
+ * E.g. ebh_image_write(ebh_image_auto, ebh_posix_read_source, &fd) writes a HEX or TI-TXT file.
+ */
+
+uint16_t ebh_posix_read_source(void *context, uint8_t *data, uint16_t length);
+
+/*
+ * Read only mapping of a whole file, e.g. an ELF file for ebh_elf_write(). Returns 0 on errors.
+ */
+
+const uint8_t *ebh_posix_map(const char *path, uint32_t *size);
+void ebh_posix_unmap(const uint8_t *data, uint32_t size);
+
+#endif /* EMBEDDED_BOOTLOADER_DEVICES_BSP_POSIX_H_ */
@@ -31,10 +31,22 @@
  */
 
 #include "inc/hw_memmap.h"
+#include "inc/hw_ints.h"
+#include "inc/hw_uart.h"
 #include "driverlib/sysctl.h"
 #include "driverlib/gpio.h"
 #include "driverlib/uart.h"
 #include "driverlib/pin_map.h"
+#include "driverlib/interrupt.h"
+#include "driverlib/udma.h"
+#include "driverlib/ssi.h"
+#include "driverlib/i2c.h"
+#include "driverlib/timer.h"
+
+#include "embedded_bootloader/transport.h"
+#include "embedded_bootloader/devices/devices.h"
+#include "embedded_bootloader/config.h"
+#include "embedded_bootloader/bootloader_protocol.h"
 
 
 /*
@@ -43,14 +55,28 @@
 
 void ebh_device_init(void) {
     SysCtlClockSet(SYSCTL_SYSDIV_1 | SYSCTL_USE_OSC | SYSCTL_OSC_MAIN | SYSCTL_XTAL_16MHZ);  // Configure to use external 16 MHz clock.
+
+    // Microsecond counter: WTIMER0 A, 32 bit down counter with a prescaler of one tick per us
+    SysCtlPeripheralEnable(SYSCTL_PERIPH_WTIMER0);
+    while(!SysCtlPeripheralReady(SYSCTL_PERIPH_WTIMER0));
+    TimerConfigure(WTIMER0_BASE, TIMER_CFG_SPLIT_PAIR | TIMER_CFG_A_PERIODIC);
+    TimerPrescaleSet(WTIMER0_BASE, TIMER_A, SysCtlClockGet() / 1000000u - 1u);
+    TimerLoadSet(WTIMER0_BASE, TIMER_A, 0xFFFFFFFF);
+    TimerEnable(WTIMER0_BASE, TIMER_A);
 }
 
 void ebh_delay_100_us(void) {
-    SysCtlDelay(SysCtlClockGet() / 1000000 * 100 / 3);
+    ebh_delay_us(100);
 }
 
 void ebh_delay_us(uint16_t time) {
-    SysCtlDelay(SysCtlClockGet() / 1000000u * time / 3u);
+    uint32_t start = ebh_time_us();
+
+    while((ebh_time_us() - start) < time);
+}
+
+uint32_t ebh_time_us(void) {
+    return 0xFFFFFFFF - TimerValueGet(WTIMER0_BASE, TIMER_A);
 }
 
 
@@ -82,10 +108,26 @@ void ebh_uart_poll_configure_115200_baud() {
     UARTConfigSetExpClk(UART1_BASE, SysCtlClockGet(), 115200, (UART_CONFIG_WLEN_8 | UART_CONFIG_STOP_ONE | UART_CONFIG_PAR_EVEN));
 }
 
+uint8_t ebh_uart_poll_configure_baud(uint32_t baud) {
+    // The fractional baud rate divider needs at least 16 system clocks per bit
+    if((baud == 0) || (baud > SysCtlClockGet() / 16)) {
+        return EBH_UART_ERROR_UNKNOWN_BAUD_RATE;
+    }
+    UARTConfigSetExpClk(UART1_BASE, SysCtlClockGet(), baud, (UART_CONFIG_WLEN_8 | UART_CONFIG_STOP_ONE | UART_CONFIG_PAR_EVEN));
+    return 0;
+}
+
 void ebh_uart_poll_send_char(uint8_t character) {
     UARTCharPut(UART1_BASE, (unsigned char)character);
 }
 
+void ebh_uart_poll_send_buf(const uint8_t *data, uint16_t length) {
+    // UARTCharPut() only blocks while the TX FIFO is full, so the FIFO stays filled
+    while(length--) {
+        UARTCharPut(UART1_BASE, (unsigned char)*data++);
+    }
+}
+
 uint8_t ebh_uart_poll_receive_char() {
     return (uint8_t)UARTCharGet(UART1_BASE);
 }
@@ -95,6 +137,299 @@ uint16_t ebh_uart_poll_receive_char_available() {
 }
 
 
+/*
+ * UART peripheral interface - interrupt based
+ * Same UART and pins as the polling interface
+ */
+
+static void ebh_uart1_int_handler(void) {
+    UARTIntClear(UART1_BASE, UARTIntStatus(UART1_BASE, true));
+    ebh_uart_irq_isr();
+}
+
+void ebh_uart_irq_init(void) {
+    ebh_uart_poll_init();
+    UARTFIFOEnable(UART1_BASE);
+    UARTFIFOLevelSet(UART1_BASE, UART_FIFO_TX2_8, UART_FIFO_RX4_8);
+    UARTIntRegister(UART1_BASE, ebh_uart1_int_handler);
+    UARTIntEnable(UART1_BASE, UART_INT_RX | UART_INT_RT);  // RX FIFO level and receive timeout
+}
+
+uint8_t ebh_uart_irq_hw_rx_ready(void) {
+    return UARTCharsAvail(UART1_BASE) ? 1 : 0;
+}
+
+uint8_t ebh_uart_irq_hw_read(void) {
+    return (uint8_t)UARTCharGetNonBlocking(UART1_BASE);
+}
+
+uint8_t ebh_uart_irq_hw_tx_ready(void) {
+    return UARTSpaceAvail(UART1_BASE) ? 1 : 0;
+}
+
+void ebh_uart_irq_hw_write(uint8_t character) {
+    UARTCharPutNonBlocking(UART1_BASE, (unsigned char)character);
+}
+
+uint8_t ebh_uart_irq_hw_tx_done(void) {
+    return UARTBusy(UART1_BASE) ? 0 : 1;
+}
+
+void ebh_uart_irq_hw_tx_enable(uint8_t enable) {
+    if(enable) {
+        UARTIntEnable(UART1_BASE, UART_INT_TX);
+        IntPendSet(INT_UART1);  // The TX interrupt only fires on a FIFO level change, start an idle UART manually
+    } else {
+        UARTIntDisable(UART1_BASE, UART_INT_TX);
+    }
+}
+
+
+/*
+ * UART peripheral interface - DMA based
+ * Same UART and pins as the polling interface
+ * uDMA channel 22 (UART1 RX), channel 23 (UART1 TX)
+ * Transfer completion is signaled on the UART interrupt.
+ */
+
+#if defined(ewarm)
+#pragma data_alignment=1024
+static uint8_t ebh_udma_control_table[1024];
+#elif defined(ccs)
+#pragma DATA_ALIGN(ebh_udma_control_table, 1024)
+static uint8_t ebh_udma_control_table[1024];
+#else
+static uint8_t ebh_udma_control_table[1024] __attribute__ ((aligned(1024)));
+#endif
+
+static ebh_dma_callback ebh_uart_dma_tx_callback = 0;
+static ebh_dma_callback ebh_uart_dma_rx_callback = 0;
+static volatile uint8_t ebh_uart_dma_tx_running = 0;
+static volatile uint8_t ebh_uart_dma_rx_running = 0;
+
+static void ebh_uart1_dma_int_handler(void) {
+    UARTIntClear(UART1_BASE, UARTIntStatus(UART1_BASE, true));
+
+    if(ebh_uart_dma_tx_running && !uDMAChannelIsEnabled(UDMA_CH23_UART1TX)) {
+        ebh_uart_dma_tx_running = 0;
+        if(ebh_uart_dma_tx_callback) {
+            ebh_uart_dma_tx_callback();
+        }
+    }
+    if(ebh_uart_dma_rx_running && (uDMAChannelModeGet(UDMA_CH22_UART1RX | UDMA_PRI_SELECT) == UDMA_MODE_STOP)) {
+        ebh_uart_dma_rx_running = 0;
+        if(ebh_uart_dma_rx_callback) {
+            ebh_uart_dma_rx_callback();  // May start the next reception
+        }
+    }
+}
+
+void ebh_uart_dma_init(ebh_dma_callback tx_done, ebh_dma_callback rx_done) {
+    ebh_uart_dma_tx_callback = tx_done;
+    ebh_uart_dma_rx_callback = rx_done;
+    ebh_uart_poll_init();
+
+    SysCtlPeripheralEnable(SYSCTL_PERIPH_UDMA);
+    while(!SysCtlPeripheralReady(SYSCTL_PERIPH_UDMA));
+    uDMAEnable();
+    uDMAControlBaseSet(ebh_udma_control_table);
+
+    uDMAChannelAssign(UDMA_CH22_UART1RX);
+    uDMAChannelAssign(UDMA_CH23_UART1TX);
+    uDMAChannelAttributeDisable(UDMA_CH22_UART1RX, UDMA_ATTR_ALTSELECT | UDMA_ATTR_USEBURST | UDMA_ATTR_HIGH_PRIORITY | UDMA_ATTR_REQMASK);
+    uDMAChannelAttributeDisable(UDMA_CH23_UART1TX, UDMA_ATTR_ALTSELECT | UDMA_ATTR_USEBURST | UDMA_ATTR_HIGH_PRIORITY | UDMA_ATTR_REQMASK);
+    uDMAChannelControlSet(UDMA_CH22_UART1RX | UDMA_PRI_SELECT, UDMA_SIZE_8 | UDMA_SRC_INC_NONE | UDMA_DST_INC_8 | UDMA_ARB_4);
+    uDMAChannelControlSet(UDMA_CH23_UART1TX | UDMA_PRI_SELECT, UDMA_SIZE_8 | UDMA_SRC_INC_8 | UDMA_DST_INC_NONE | UDMA_ARB_4);
+
+    UARTFIFOEnable(UART1_BASE);
+    UARTFIFOLevelSet(UART1_BASE, UART_FIFO_TX4_8, UART_FIFO_RX4_8);
+    UARTDMAEnable(UART1_BASE, UART_DMA_RX | UART_DMA_TX);
+    UARTIntRegister(UART1_BASE, ebh_uart1_dma_int_handler);
+}
+
+void ebh_uart_dma_tx_start(const uint8_t *data, uint16_t length) {
+    ebh_uart_dma_tx_running = 1;
+    uDMAChannelTransferSet(UDMA_CH23_UART1TX | UDMA_PRI_SELECT, UDMA_MODE_BASIC, (void *)data, (void *)(UART1_BASE + UART_O_DR), length);
+    uDMAChannelEnable(UDMA_CH23_UART1TX);
+}
+
+void ebh_uart_dma_rx_start(uint8_t *data, uint16_t length) {
+    ebh_uart_dma_rx_running = 1;
+    uDMAChannelTransferSet(UDMA_CH22_UART1RX | UDMA_PRI_SELECT, UDMA_MODE_BASIC, (void *)(UART1_BASE + UART_O_DR), data, length);
+    uDMAChannelEnable(UDMA_CH22_UART1RX);
+}
+
+uint8_t ebh_uart_dma_tx_busy(void) {
+    return (uDMAChannelIsEnabled(UDMA_CH23_UART1TX) || UARTBusy(UART1_BASE)) ? 1 : 0;
+}
+
+uint16_t ebh_uart_dma_rx_remaining(void) {
+    return (uint16_t)uDMAChannelSizeGet(UDMA_CH22_UART1RX | UDMA_PRI_SELECT);
+}
+
+
+/*
+ * SPI peripheral interface
+ * SSI - SSI0 (master, mode 0)
+ * CLK - PA2
+ * CS  - PA3 (GPIO, active low)
+ * RX  - PA4
+ * TX  - PA5
+ */
+
+#define EBH_SPI_CS_PIN  GPIO_PIN_3
+
+void ebh_spi_init(void) {
+    SysCtlPeripheralEnable(SYSCTL_PERIPH_SSI0);
+    while(!SysCtlPeripheralReady(SYSCTL_PERIPH_SSI0));
+    SysCtlPeripheralEnable(SYSCTL_PERIPH_GPIOA);
+    while(!SysCtlPeripheralReady(SYSCTL_PERIPH_GPIOA));
+
+    GPIOPinConfigure(GPIO_PA2_SSI0CLK);
+    GPIOPinConfigure(GPIO_PA4_SSI0RX);
+    GPIOPinConfigure(GPIO_PA5_SSI0TX);
+    GPIOPinTypeSSI(GPIO_PORTA_BASE, GPIO_PIN_2 | GPIO_PIN_4 | GPIO_PIN_5);
+    GPIOPinTypeGPIOOutput(GPIO_PORTA_BASE, EBH_SPI_CS_PIN);
+    GPIOPinWrite(GPIO_PORTA_BASE, EBH_SPI_CS_PIN, EBH_SPI_CS_PIN);
+
+    ebh_spi_configure(1000000);
+}
+
+void ebh_spi_configure(uint32_t clock_hz) {
+    uint32_t dummy = 0;
+
+    SSIDisable(SSI0_BASE);
+    SSIConfigSetExpClk(SSI0_BASE, SysCtlClockGet(), SSI_FRF_MOTO_MODE_0, SSI_MODE_MASTER, clock_hz, 8);
+    SSIEnable(SSI0_BASE);
+    while(SSIDataGetNonBlocking(SSI0_BASE, &dummy));  // Empty the RX FIFO
+}
+
+void ebh_spi_select(uint8_t active) {
+    while(SSIBusy(SSI0_BASE));
+    GPIOPinWrite(GPIO_PORTA_BASE, EBH_SPI_CS_PIN, active ? 0 : EBH_SPI_CS_PIN);
+}
+
+void ebh_spi_transfer(const uint8_t *tx, uint8_t *rx, uint16_t length) {
+    uint32_t value = 0;
+
+    while(length--) {
+        SSIDataPut(SSI0_BASE, tx ? *tx++ : 0xFF);
+        SSIDataGet(SSI0_BASE, &value);
+        if(rx) {
+            *rx++ = (uint8_t)value;
+        }
+    }
+}
+
+
+/*
+ * I2C peripheral interface
+ * I2C - I2C0 (master)
+ * SCL - PB2
+ * SDA - PB3
+ */
+
+static uint8_t ebh_i2c_status(uint32_t error_stop) {
+    uint32_t error = 0;
+
+    while(I2CMasterBusy(I2C0_BASE));
+    error = I2CMasterErr(I2C0_BASE);
+    if(error == I2C_MASTER_ERR_NONE) {
+        return EBH_I2C_OK;
+    }
+    if(!(error & I2C_MASTER_ERR_ARB_LOST)) {
+        I2CMasterControl(I2C0_BASE, error_stop);
+        while(I2CMasterBusy(I2C0_BASE));
+    }
+    return (error & I2C_MASTER_ERR_CLK_TOUT) ? EBH_I2C_TIMEOUT : EBH_I2C_NACK;
+}
+
+void ebh_i2c_init(void) {
+    SysCtlPeripheralEnable(SYSCTL_PERIPH_I2C0);
+    while(!SysCtlPeripheralReady(SYSCTL_PERIPH_I2C0));
+    SysCtlPeripheralEnable(SYSCTL_PERIPH_GPIOB);
+    while(!SysCtlPeripheralReady(SYSCTL_PERIPH_GPIOB));
+
+    GPIOPinConfigure(GPIO_PB2_I2C0SCL);
+    GPIOPinConfigure(GPIO_PB3_I2C0SDA);
+    GPIOPinTypeI2CSCL(GPIO_PORTB_BASE, GPIO_PIN_2);
+    GPIOPinTypeI2C(GPIO_PORTB_BASE, GPIO_PIN_3);
+
+    ebh_i2c_configure(100000);
+}
+
+void ebh_i2c_configure(uint32_t clock_hz) {
+    uint32_t timeout = 0;
+
+    // 100 kHz or 400 kHz, 1 MHz would need a system clock of at least 20 MHz
+    I2CMasterInitExpClk(I2C0_BASE, SysCtlClockGet(), clock_hz > 100000);
+
+    // Clock low timeout, counted in units of 16 SCL periods
+    timeout = (uint32_t)((uint64_t)clock_hz * EBH_I2C_STRETCH_TIMEOUT / 1000000u / 16u);
+    I2CMasterTimeoutSet(I2C0_BASE, (timeout > 0xFF) ? 0xFF : timeout);
+}
+
+uint8_t ebh_i2c_write(uint8_t address, const ebh_iovec *iov, uint8_t count) {
+    uint32_t total = 0;
+    uint32_t sent = 0;
+    uint16_t i = 0;
+    uint8_t j = 0;
+    uint8_t status = EBH_I2C_OK;
+
+    for(j = 0; j < count; j++) {
+        total += iov[j].length;
+    }
+
+    I2CMasterSlaveAddrSet(I2C0_BASE, address, false);
+    for(j = 0; j < count; j++) {
+        for(i = 0; i < iov[j].length; i++) {
+            I2CMasterDataPut(I2C0_BASE, iov[j].data[i]);
+            if(total == 1) {
+                I2CMasterControl(I2C0_BASE, I2C_MASTER_CMD_SINGLE_SEND);
+            } else if(sent == 0) {
+                I2CMasterControl(I2C0_BASE, I2C_MASTER_CMD_BURST_SEND_START);
+            } else if(sent == total - 1) {
+                I2CMasterControl(I2C0_BASE, I2C_MASTER_CMD_BURST_SEND_FINISH);
+            } else {
+                I2CMasterControl(I2C0_BASE, I2C_MASTER_CMD_BURST_SEND_CONT);
+            }
+            sent++;
+
+            status = ebh_i2c_status(I2C_MASTER_CMD_BURST_SEND_ERROR_STOP);
+            if(status != EBH_I2C_OK) {
+                return status;
+            }
+        }
+    }
+    return EBH_I2C_OK;
+}
+
+uint8_t ebh_i2c_read(uint8_t address, uint8_t *data, uint16_t length) {
+    uint16_t i = 0;
+    uint8_t status = EBH_I2C_OK;
+
+    I2CMasterSlaveAddrSet(I2C0_BASE, address, true);
+    for(i = 0; i < length; i++) {
+        if(length == 1) {
+            I2CMasterControl(I2C0_BASE, I2C_MASTER_CMD_SINGLE_RECEIVE);
+        } else if(i == 0) {
+            I2CMasterControl(I2C0_BASE, I2C_MASTER_CMD_BURST_RECEIVE_START);
+        } else if(i == length - 1) {
+            I2CMasterControl(I2C0_BASE, I2C_MASTER_CMD_BURST_RECEIVE_FINISH);
+        } else {
+            I2CMasterControl(I2C0_BASE, I2C_MASTER_CMD_BURST_RECEIVE_CONT);
+        }
+
+        status = ebh_i2c_status(I2C_MASTER_CMD_BURST_RECEIVE_ERROR_STOP);
+        if(status != EBH_I2C_OK) {
+            return status;
+        }
+        data[i] = (uint8_t)I2CMasterDataGet(I2C0_BASE);
+    }
+    return EBH_I2C_OK;
+}
+
+
 /*
  * Reset and Test pin configuration
  * for MSP430 entry sequence
@@ -130,31 +465,3 @@ void ebh_test_pin_high() {
 void ebh_test_pin_low() {
     GPIOPinWrite(GPIO_PORTA_BASE, EBH_TEST_PIN, 0);
 }
-
-/*
- * CRC CCITT algorithm
- */
-
-const uint16_t polynom = 0x1021;
-uint16_t crc = 0;
-
-void ebh_crc_init(void) {
-    crc = 0xffff;
-}
-
-void ebh_crc(uint8_t data) {
-    uint_fast8_t i;
-
-    for (i = 0; i < 8; i++) {
-        if (((crc & 0x8000) >> 8) ^ (data & 0x80)) {
-            crc = (crc << 1) ^ polynom;
-        } else {
-            crc = (crc << 1);
-        }
-        data <<= 1;
-    }
-}
-
-uint16_t ebh_crc_result(void) {
-    return crc;
-}
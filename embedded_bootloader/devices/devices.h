@@ -26,6 +26,9 @@
 #ifndef EMBEDDED_BOOTLOADER_DEVICES_DEVICES_H_
 #define EMBEDDED_BOOTLOADER_DEVICES_DEVICES_H_
 
+#include <stdint.h>
+#include "embedded_bootloader/transport.h"
+
 
 /*
  * General device initialization and support function
@@ -34,6 +37,7 @@
 void ebh_device_init(void);
 void ebh_delay_100_us(void);
 void ebh_delay_us(uint16_t time);
+uint32_t ebh_time_us(void);  // Free-running microsecond counter, wraps around
 
 /*
  * UART (polling) interface
@@ -42,10 +46,66 @@ void ebh_delay_us(uint16_t time);
 void ebh_uart_poll_init();
 void ebh_uart_poll_configure_9600_baud();
 void ebh_uart_poll_configure_115200_baud();
+uint8_t ebh_uart_poll_configure_baud(uint32_t baud);  // 8E1 at any BSL baud rate, returns 0 or EBH_UART_ERROR_UNKNOWN_BAUD_RATE
 void ebh_uart_poll_send_char(uint8_t character);
+void ebh_uart_poll_send_buf(const uint8_t *data, uint16_t length);  // Only needed if EBH_UART_POLL_SEND_BUF is set
 uint8_t ebh_uart_poll_receive_char();
 uint16_t ebh_uart_poll_receive_char_available();
 
+/*
+ * UART (interrupt) interface
+ * The interrupt handler has to clear the interrupt and call ebh_uart_irq_isr().
+ */
+
+void ebh_uart_irq_init(void);
+uint8_t ebh_uart_irq_hw_rx_ready(void);  // RX FIFO not empty
+uint8_t ebh_uart_irq_hw_read(void);
+uint8_t ebh_uart_irq_hw_tx_ready(void);  // TX FIFO not full
+void ebh_uart_irq_hw_write(uint8_t character);
+uint8_t ebh_uart_irq_hw_tx_done(void);   // TX FIFO and shift register empty
+void ebh_uart_irq_hw_tx_enable(uint8_t enable);  // Enabling also has to trigger the interrupt once
+
+/*
+ * UART (DMA) interface
+ * The callbacks passed to ebh_uart_dma_init() are called from interrupt context once a
+ * transfer completed. rx_done may start the next reception right away.
+ * Without callbacks, completion can be polled with ebh_uart_dma_tx_busy() / _rx_remaining().
+ */
+
+typedef void (*ebh_dma_callback)(void);
+
+void ebh_uart_dma_init(ebh_dma_callback tx_done, ebh_dma_callback rx_done);
+void ebh_uart_dma_tx_start(const uint8_t *data, uint16_t length);
+void ebh_uart_dma_rx_start(uint8_t *data, uint16_t length);
+uint8_t ebh_uart_dma_tx_busy(void);        // Transfer running or UART still shifting out
+uint16_t ebh_uart_dma_rx_remaining(void);  // Bytes the running RX transfer still waits for, 0 when done
+
+/*
+ * SPI (master) interface
+ * Mode 0, MSB first. ebh_spi_transfer() is full duplex: it clocks out tx (0xFF if tx is 0)
+ * and stores the bytes clocked in at rx (discarded if rx is 0).
+ */
+
+void ebh_spi_init(void);
+void ebh_spi_configure(uint32_t clock_hz);
+void ebh_spi_select(uint8_t active);  // Chip select of the target
+void ebh_spi_transfer(const uint8_t *tx, uint8_t *rx, uint16_t length);
+
+/*
+ * I2C (master) interface
+ * Each call is one complete transaction (START, address, data, STOP). SCL held low by the
+ * target (clock stretching) is waited for up to EBH_I2C_STRETCH_TIMEOUT (config.h).
+ */
+
+#define EBH_I2C_OK       0
+#define EBH_I2C_NACK     1  // Address or data byte not acknowledged, e.g. target busy
+#define EBH_I2C_TIMEOUT  2  // Clock stretched longer than EBH_I2C_STRETCH_TIMEOUT
+
+void ebh_i2c_init(void);
+void ebh_i2c_configure(uint32_t clock_hz);
+uint8_t ebh_i2c_write(uint8_t address, const ebh_iovec *iov, uint8_t count);  // All segments in one transaction
+uint8_t ebh_i2c_read(uint8_t address, uint8_t *data, uint16_t length);
+
 /*
  * Invoke sequence, RST and TST pin
  */
@@ -57,16 +117,4 @@ void ebh_rst_pin_low(void);
 void ebh_test_pin_high(void);
 void ebh_test_pin_low(void);
 
-/*
- * CRC CCITT algorithm
- */
-
-void ebh_crc_init(void);
-void ebh_crc(uint8_t data);
-uint16_t ebh_crc_result(void);
-
-void ebh_send_char(uint8_t character);
-uint8_t ebh_receive_char();
-uint16_t ebh_receive_char_available();
-
 #endif /* EMBEDDED_BOOTLOADER_DEVICES_DEVICES_H_ */
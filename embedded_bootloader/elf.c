@@ -0,0 +1,127 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Max Groening
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <stdint.h>
+#include "elf.h"
+#include "part.h"
+#include "embedded_bootloader.h"
+#include "embedded_bootloader/bootloader_protocol.h"
+
+#define EBH_ELF_HEADER_SIZE   52
+#define EBH_ELF_PHDR_SIZE     32
+#define EBH_ELF_EXEC          2
+#define EBH_ELF_PT_LOAD       1
+#define EBH_ELF_EM_ARM        40
+#define EBH_ELF_EM_MSP430     105
+
+/* Fields are read byte by byte, the file may be at any alignment */
+static uint16_t ebh_elf_u16(const uint8_t *data) {
+    return (uint16_t)data[0] | ((uint16_t)data[1] << 8);
+}
+
+static uint32_t ebh_elf_u32(const uint8_t *data) {
+    return (uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+/* Reads program header `index`, 0 if it is not a PT_LOAD segment with file data */
+static uint8_t ebh_elf_phdr(const ebh_elf *elf, uint16_t index, ebh_elf_segment *segment, uint32_t *offset) {
+    uint16_t entry = ebh_elf_u16(&elf->file[42]);
+    const uint8_t *phdr = &elf->file[ebh_elf_u32(&elf->file[28]) + (uint32_t)index * entry];
+
+    *offset = ebh_elf_u32(&phdr[4]);
+    segment->addr = ebh_elf_u32(&phdr[12]);
+    segment->length = ebh_elf_u32(&phdr[16]);
+    segment->data = 0;
+    return (ebh_elf_u32(&phdr[0]) == EBH_ELF_PT_LOAD) && (segment->length > 0);
+}
+
+uint8_t ebh_elf_open(ebh_elf *elf, const uint8_t *file, uint32_t size, ebh_device device) {
+    uint16_t machine = (device == ebh_device_msp432) ? EBH_ELF_EM_ARM : EBH_ELF_EM_MSP430;
+    ebh_elf_segment segment;
+    uint32_t offset = 0;
+    uint32_t phoff = 0;
+    uint16_t entry = 0;
+    uint16_t i = 0;
+
+    elf->file = file;
+    elf->size = size;
+    elf->count = 0;
+    elf->index = 0;
+
+    // 32 bit, little endian executable for the device
+    if((size < EBH_ELF_HEADER_SIZE) || (file[0] != 0x7F) || (file[1] != 'E') || (file[2] != 'L') || (file[3] != 'F') ||
+       (file[4] != 1) || (file[5] != 1) || (ebh_elf_u16(&file[16]) != EBH_ELF_EXEC)) {
+        return EBH_UART_ERROR_IMAGE_FORMAT;
+    }
+    if(ebh_elf_u16(&file[18]) != machine) {
+        return EBH_UART_ERROR_IMAGE_FORMAT;
+    }
+
+    phoff = ebh_elf_u32(&file[28]);
+    entry = ebh_elf_u16(&file[42]);
+    elf->count = ebh_elf_u16(&file[44]);
+    if((elf->count > 0) && ((entry < EBH_ELF_PHDR_SIZE) || (phoff > size) || ((size - phoff) / entry < elf->count))) {
+        elf->count = 0;
+        return EBH_UART_ERROR_IMAGE_FORMAT;
+    }
+
+    for(i = 0; i < elf->count; i++) {
+        if(!ebh_elf_phdr(elf, i, &segment, &offset)) {
+            continue;
+        }
+        if((offset > size) || (segment.length > size - offset) || (segment.addr + segment.length < segment.addr)) {
+            elf->count = 0;
+            return EBH_UART_ERROR_IMAGE_FORMAT;
+        }
+        if(!ebh_part_allows(ebh_part_of(device), segment.addr, segment.length, EBH_MEMORY_WRITE)) {
+            elf->count = 0;
+            return EBH_UART_ERROR_IMAGE_ADDRESS;
+        }
+    }
+    return EBH_UART_ERROR_ACK;
+}
+
+uint8_t ebh_elf_next(ebh_elf *elf, ebh_elf_segment *segment) {
+    uint32_t offset = 0;
+
+    while(elf->index < elf->count) {
+        if(ebh_elf_phdr(elf, elf->index++, segment, &offset)) {
+            segment->data = &elf->file[offset];
+            return 1;
+        }
+    }
+    return 0;
+}
+
+uint8_t ebh_elf_write(const uint8_t *file, uint32_t size, ebh_device device) {
+    ebh_elf elf;
+    ebh_elf_segment segment;
+    uint8_t status = ebh_elf_open(&elf, file, size, device);
+
+    while((status == EBH_UART_ERROR_ACK) && ebh_elf_next(&elf, &segment)) {
+        status = ebh_write_region(segment.addr, segment.data, segment.length);
+    }
+    return status;
+}
@@ -0,0 +1,64 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Max Groening
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef EMBEDDED_BOOTLOADER_ELF_H_
+#define EMBEDDED_BOOTLOADER_ELF_H_
+
+#include <stdint.h>
+#include "embedded_bootloader.h"
+
+/*
+ * ELF32 firmware files (linker output)
+ *
+ * The file is read in place (e.g. mapped with ebh_posix_map() or stored in memory), the
+ * data of the PT_LOAD segments is written straight from it. Segments are placed at their
+ * physical (load) address, so initialized data is written to its flash image. Segments
+ * without file data (.bss) are skipped.
+ *
+ * The machine has to match the device (EM_MSP430 / EM_ARM). Segments have to lie in memory
+ * the BSL may write on ebh_part_of(device), for the generic MSP430 parts the 20 bit address
+ * space. MSP432 segments above 16 MB (e.g. SRAM) are written with RX_DATA_BLOCK_32.
+ */
+
+typedef struct {
+    uint32_t addr;        // Physical address (p_paddr)
+    const uint8_t *data;  // Points into the file
+    uint32_t length;      // p_filesz
+} ebh_elf_segment;
+
+typedef struct {
+    const uint8_t *file;
+    uint32_t size;
+    uint16_t count;       // Program headers
+    uint16_t index;       // Next program header
+} ebh_elf;
+
+/* ebh_elf_open() checks the header and all program headers, ebh_elf_next() then cannot fail. */
+uint8_t ebh_elf_open(ebh_elf *elf, const uint8_t *file, uint32_t size, ebh_device device);
+uint8_t ebh_elf_next(ebh_elf *elf, ebh_elf_segment *segment);  // 1 for the next segment with data, 0 at the end
+
+uint8_t ebh_elf_write(const uint8_t *file, uint32_t size, ebh_device device);
+
+#endif /* EMBEDDED_BOOTLOADER_ELF_H_ */
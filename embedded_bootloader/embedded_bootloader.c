@@ -25,9 +25,34 @@
 
 #include <stdint.h>
 #include "embedded_bootloader.h"
+#include "bsl_frame.h"
+#include "link.h"
+#include "gap.h"
+#include "timing.h"
+#include "part.h"
 #include "devices/devices.h"
 #include "embedded_bootloader/bootloader_protocol.h"
 
+static uint16_t ebh_response_discarded = 0;  // Bytes skipped in front of the last core response
+static uint16_t ebh_session_buffer_size = 0;  // Reported by TX_BUFFER_SIZE, 0 until known
+static uint8_t ebh_session_buffer_unsupported = 0;
+static ebh_progress ebh_progress_callback = 0;
+static void *ebh_progress_context = 0;
+static ebh_retry_policy ebh_retry = {EBH_RETRIES, EBH_RETRY_BACKOFF, EBH_RETRY_JITTER, 0, 0};
+static uint32_t ebh_retry_total = 0;
+static uint32_t ebh_retry_random = 1;
+static ebh_deadline ebh_ack_deadline = 0;  // Armed when a frame is sent, see ebh_receive_ack()
+static uint8_t ebh_ack_armed = 0;
+
+static uint8_t ebh_crc_check_command(uint8_t cmd, uint8_t a_len, uint32_t addr, uint16_t length, uint16_t *data, uint8_t (*receive_ack)(void));
+
+void ebh_session_reset(void) {
+    ebh_session_buffer_size = 0;
+    ebh_session_buffer_unsupported = 0;
+    ebh_retry_total = 0;
+    ebh_ack_armed = 0;
+    ebh_link_reset();
+}
 
 void ebh_invoke_sequence(void) {
 
@@ -40,6 +65,8 @@ void ebh_invoke_sequence(void) {
      *
      */
 
+    ebh_session_reset();
+
     // Setup the GPIOs
     ebh_invoke_seqence_pre();
 
@@ -80,196 +107,424 @@ void ebh_invoke_sequence(void) {
 }
 
 void ebh_sync_character(void) {
+    ebh_session_reset();
     ebh_send_char(EBH_SYNC_CHARACTER);
     ebh_receive_char();
+    ebh_gap_command(EBH_SYNC_CHARACTER);
 }
 
 void ebh_delay_between_commands(void) {
-    // A 1.2 ms delay is recommended between the BSL commands.
-    ebh_delay_us(EBH_DELAY_BETWEEN_COMMANDS);
+    // Gap armed by the last command, EBH_DELAY_BETWEEN_COMMANDS (1.2 ms) is recommended by default
+    ebh_gap_wait();
 }
 
-uint8_t ebh_format_package(uint8_t cmd, uint8_t a_len, uint8_t a0, uint8_t a1, uint8_t a2, uint8_t a3, uint8_t *payload, uint16_t length) {
+/* Sends a prepared frame (see bsl_frame.h) after the gap of the last command */
+static void ebh_ack_arm(uint32_t bytes) {
+    // The frame and the ACK itself still have to cross the line
+    ebh_ack_deadline = ebh_deadline_in(EBH_ACK_TIMEOUT + ebh_line_time_us(bytes + 1));
+    ebh_ack_armed = 1;
+}
 
-    /*
-     * HDR   Header (0x80)
-     * NL    Length of BSL core data packet (low byte)
-     * NH    ... (high byte)
-     * [..]  BSL core command
-     * CKL   CRC checksum on BSL core data packet (low byte)
-     * CKH   ... (high byte)
-     */
+static void ebh_send_frame(const uint8_t *frame, uint16_t length) {
+    ebh_link_next_frame();
+    ebh_gap_wait();
+    ebh_ack_arm(length);
+    ebh_send_buf(frame, length);
+    ebh_gap_command(frame[3]);
+}
 
-    uint8_t nl = (length + 1 + a_len) & 0xFF;
-    uint8_t nh = ((length + 1 + a_len) >> 8) & 0xFF;
+uint8_t ebh_format_package(uint8_t cmd, uint8_t a_len, uint8_t a0, uint8_t a1, uint8_t a2, uint8_t a3, const uint8_t *payload, uint16_t length) {
+    uint8_t header[EBH_MAX_FRAME_HEADER_SIZE];
+    uint8_t checksum[2];
+    ebh_iovec iov[3];
     uint16_t crc = 0;
 
-    ebh_send_char(EBH_HEADER);
-    ebh_send_char(nl);
-    ebh_send_char(nh);
-    ebh_send_char(cmd);
-    ebh_crc_init();
-    ebh_crc(cmd);
+    if((a_len > 4) || (length + 1 + a_len > EBH_MAX_BUFFER_SIZE)) {
+        return EBH_UART_ERROR_PACKET_SIZE_EXCEEDS_BUFFER;
+    }
+
+    // The payload is sent straight from the caller's buffer, the CRC runs over the segments in order.
+    iov[0].data = header;
+    iov[0].length = ebh_build_frame_header(header, cmd, a_len, a0, a1, a2, a3, length);
+    iov[1].data = payload;
+    iov[1].length = length;
+    iov[2].data = checksum;
+    iov[2].length = 2;
+
+    crc = ebh_crc_update(0xFFFF, &header[3], 1 + a_len);
+    crc = ebh_crc_update(crc, payload, length);
+    checksum[0] = crc & 0xFF;
+    checksum[1] = (crc >> 8) & 0xFF;
+
+    ebh_link_next_frame();
+    ebh_gap_wait();
+    ebh_ack_arm(iov[0].length + length + 2);
+    ebh_send_iov(iov, 3);
+    ebh_gap_command(cmd);
+
+    return 0;
+}
+
+uint8_t ebh_receive_ack() {
+    uint8_t ack = EBH_UART_ERROR_TIME_OUT;
 
-    if(a_len > 0) {
-        ebh_send_char(a0);
-        ebh_crc(a0);
+    // Without a frame sent by ebh_format_package() (e.g. after a sync character) only the ACK is on the way
+    if(!ebh_ack_armed) {
+        ebh_ack_arm(0);
     }
-    if(a_len > 1) {
-        ebh_send_char(a1);
-        ebh_crc(a1);
+    ebh_ack_armed = 0;
+
+    if(ebh_wait_readable(ebh_deadline_left(ebh_ack_deadline))) {
+        ack = ebh_receive_char();
     }
-    if(a_len > 2) {
-        ebh_send_char(a2);
-        ebh_crc(a2);
+    ebh_link_record(ack, 1);
+    return ack;
+}
+
+uint8_t ebh_receive_core_response(uint8_t *payload, uint16_t max_buffer, uint16_t *length) {
+    ebh_response_parser parser;
+    uint8_t status = EBH_PARSER_IN_PROGRESS;
+    ebh_deadline deadline = ebh_deadline_in(EBH_RESPONSE_TIMEOUT);
+
+    // Usually EBH_MAX_BUFFER_SIZE would be allowed,
+    // but we can prevent buffer overrun if smaller rx buffer is used.
+    ebh_parser_init(&parser, payload, max_buffer);
+
+    // Noise in front of the header is skipped, the whole frame has to arrive within EBH_RESPONSE_TIMEOUT.
+    while(status == EBH_PARSER_IN_PROGRESS) {
+        if(ebh_wait_readable(ebh_deadline_left(deadline))) {
+            status = ebh_parser_feed_byte(&parser, ebh_receive_char());
+        } else {
+            status = EBH_UART_ERROR_TIME_OUT;
+        }
+    }
+
+    ebh_response_discarded = parser.discarded;
+    if(status == EBH_UART_ERROR_ACK) {
+        ebh_gap_response();
     }
-    if(a_len > 3) {
-        ebh_send_char(a3);
-        ebh_crc(a3);
+    if(length) {
+        *length = (status == EBH_UART_ERROR_TIME_OUT) ? 0 : parser.length;
     }
+    ebh_link_record(status, 0);
+    return status;
+}
 
-    if(length > 0) {
-        uint16_t i = 0;
-        for(i = 0; i < length; i++) {
-            ebh_send_char(payload[i]);
-            ebh_crc(payload[i]);
+void ebh_resync(void) {
+    static const uint8_t fill[16] = {0};
+    uint16_t length = ebh_session_buffer_size ? ebh_session_buffer_size : EBH_MAX_RESPONSE_SIZE;
+    uint16_t left = 0;
+    uint16_t chunk = 0;
+    ebh_deadline deadline = 0;
+
+    // A corrupted length keeps the target collecting bytes, fill up its buffer so the frame ends
+    length += EBH_FRAME_OVERHEAD;
+    left = length;
+    while(left > 0) {
+        chunk = (left > sizeof(fill)) ? sizeof(fill) : left;
+        ebh_send_buf(fill, chunk);
+        left -= chunk;
+    }
+
+    // The target rejects the fill bytes one by one, its answers are dropped until they stop
+    ebh_wait_tx_idle();
+    deadline = ebh_deadline_in(ebh_line_time_us(length) + EBH_ACK_TIMEOUT);
+    while(!ebh_deadline_expired(deadline)) {
+        if(ebh_wait_readable(ebh_deadline_left(deadline))) {
+            ebh_flush();
         }
     }
+    ebh_flush();
+    ebh_ack_armed = 0;
+}
 
-    crc = ebh_crc_result();
-    ebh_send_char(crc & 0xFF);
-    ebh_send_char((crc >> 8) & 0xFF);
-
-    return 0;
+uint16_t ebh_receive_discarded(void) {
+    return ebh_response_discarded;
 }
 
-uint8_t ebh_receive_ack() {
-    uint_fast16_t i = 0;
-    for (i = 0; i < EBH_ACK_RETRIES; i++) {
-        ebh_delay_us(EBH_ACK_RETRY_DELAY);
-        if(ebh_receive_char_available()) {
-            return ebh_receive_char();
+static uint16_t ebh_data_block_size(uint8_t a_len) {
+    uint16_t size = 0;
+    uint8_t status = 0;
+
+#ifdef EBH_PART
+    (void)status;
+    size = EBH_PART.buffer_size;  // Known at compile time
+#else
+    // Queried once per session. A locked BSL is asked again, any other failure means not supported.
+    if((ebh_session_buffer_size == 0) && !ebh_session_buffer_unsupported) {
+        status = ebh_tx_buffer_size(&size);
+        if((status != EBH_UART_ERROR_ACK) && (status != EBH_CORE_MSG_BSL_LOCKED)) {
+            ebh_flush();
+            ebh_session_buffer_unsupported = 1;
         }
     }
-    return EBH_UART_ERROR_TIME_OUT;
+
+    size = ebh_session_buffer_size;
+#endif
+    if(size > EBH_MAX_BUFFER_SIZE) {
+        size = EBH_MAX_BUFFER_SIZE;
+    }
+    if(size <= 1 + a_len) {
+        return EBH_DEFAULT_DATA_BLOCK;
+    }
+    return size - 1 - a_len;
+}
+
+void ebh_set_retry_policy(const ebh_retry_policy *policy) {
+    ebh_retry = *policy;
+}
+
+uint32_t ebh_retries(void) {
+    return ebh_retry_total;
 }
 
-uint8_t ebh_receive_core_response(uint8_t *payload, uint16_t max_buffer) {
-    // Header
-    uint8_t header = ebh_receive_char();
-    if(header != EBH_HEADER) {
-        return EBH_UART_ERROR_HEADER_INCORRECT;
+/* Failures the same frame may not run into again */
+static uint8_t ebh_retry_line_error(uint8_t status) {
+    switch(status) {
+    case EBH_UART_ERROR_TIME_OUT:
+    case EBH_UART_ERROR_HEADER_INCORRECT:
+    case EBH_UART_ERROR_CHECKSUM_INCORRECT:
+        return 1;
+
+    // NAKs of the frame as it was sent, the target rejects it again
+    case EBH_UART_ERROR_PACKET_SIZE_ZERO:
+    case EBH_UART_ERROR_PACKET_SIZE_EXCEEDS_BUFFER:
+    case EBH_UART_ERROR_UNKNOWN_ERROR:
+    case EBH_UART_ERROR_UNKNOWN_BAUD_RATE:
+        return 0;
     }
-    // Length
-    uint16_t length = ebh_receive_char();
-    length += ebh_receive_char() << 8;
-    // Usually EBH_MAX_BUFFER_SIZE would be allowed here,
-    // but we can prevent buffer overrun if smaller rx buffer is used.
-    if(length > max_buffer) {
-        return EBH_UART_ERROR_PACKET_SIZE_EXCEEDS_BUFFER;
+
+    // No answer of the BSL at all: the ACK was corrupted on the way back
+    return 1;
+}
+
+/* Prepares the next attempt of a frame that failed on the line, 0 once the retries are used up */
+static uint8_t ebh_retry_frame(uint8_t attempt, uint8_t status) {
+    uint32_t delay = 0;
+
+    if((attempt >= ebh_retry.retries) || !ebh_retry_line_error(status)) {
+        return 0;
     }
+    ebh_retry_total++;
 
-    // Core response
-    uint_fast16_t i = 0;
-    uint_fast8_t character = 0;
-    ebh_crc_init();
-    for(i = 0; i < length; i++) {
-        character = ebh_receive_char();
-        payload[i] = character;
-        ebh_crc(character);
+    // A timeout may be a frame the target still collects, a NAK ended it already
+    if(status == EBH_UART_ERROR_TIME_OUT) {
+        ebh_resync();
+    }
+
+    if(ebh_retry.downshift && ebh_retry.downshift_after && (attempt + 1 == ebh_retry.downshift_after)) {
+        ebh_retry.downshift();
     }
 
-    // CRC
-    uint16_t crc = ebh_receive_char();
-    crc += ebh_receive_char() << 8;
+    // Exponential backoff, the jitter (xorshift32) keeps hosts sharing a bus apart
+    delay = (uint32_t)ebh_retry.backoff << attempt;
+    if(ebh_retry.jitter) {
+        ebh_retry_random ^= ebh_retry_random << 13;
+        ebh_retry_random ^= ebh_retry_random >> 17;
+        ebh_retry_random ^= ebh_retry_random << 5;
+        delay += ebh_retry_random % ebh_retry.jitter;
+    }
+    while(delay > 0) {
+        ebh_delay_us((delay > 0xFFFF) ? 0xFFFF : delay);
+        delay -= (delay > 0xFFFF) ? 0xFFFF : delay;
+    }
+    ebh_flush();
+    return 1;
+}
 
-    if(crc != ebh_crc_result()) {
-        return EBH_UART_ERROR_CHECKSUM_INCORRECT;
+/* Returns the line status, the core message of the target in *message */
+static uint8_t ebh_rx_data_frame_once(uint8_t cmd, uint8_t a_len, uint32_t addr, const uint8_t *data, uint16_t length, uint8_t *message) {
+    uint8_t ack = 0;
+    uint8_t rx_buf[2];  // This command expects no core response message bigger than 2.
+
+    *message = EBH_CORE_MSG_OPERATION_SUCCESSFUL;
+    ack = ebh_format_package(cmd, a_len, addr & 0xFF, (addr >> 8) & 0xFF, (addr >> 16) & 0xFF, (addr >> 24) & 0xFF, data, length);
+    if(ack != EBH_UART_ERROR_ACK) {
+        return ack;
+    }
+    ack = ebh_receive_ack();
+    if(ack != EBH_UART_ERROR_ACK) {
+        return ack;
+    }
+    ack = ebh_receive_core_response(rx_buf, 2, 0);
+    if(ack != EBH_UART_ERROR_ACK) {
+        return ack;
+    }
+    if(rx_buf[0] == EBH_CORE_MSG_MESSAGE) {
+        *message = rx_buf[1];
     }
     return EBH_UART_ERROR_ACK;
 }
 
+static uint8_t ebh_rx_data_frame(uint8_t cmd, uint8_t a_len, uint32_t addr, const uint8_t *data, uint16_t length) {
+    uint8_t status = 0;
+    uint8_t message = 0;
+    uint8_t attempt = 0;
 
+    // Writing the same block again is harmless, only the failed frame is repeated
+    do {
+        status = ebh_rx_data_frame_once(cmd, a_len, addr, data, length, &message);
+        if(status == EBH_UART_ERROR_ACK) {
+            return message;
+        }
+    } while(ebh_retry_frame(attempt++, status));
 
-uint8_t ebh_rx_data_block(uint32_t addr, uint8_t *data, uint16_t length) {
-    uint8_t ack = 0;
-    uint8_t rx_buf[2];  // This command expects no core response message bigger than 2.
+    return status;
+}
 
-    uint16_t offset = 0;
-    uint8_t a0 = addr & 0xFF;
-    uint8_t a1 = (addr >> 8) & 0xFF;
-    uint8_t a2 = (addr >> 16) & 0xFF;
+static uint8_t ebh_rx_data_blocks(uint8_t cmd, uint8_t a_len, uint32_t addr, const uint8_t *data, uint16_t length) {
+    uint8_t ack = 0;
+    uint16_t block = ebh_data_block_size(a_len);
+    uint16_t chunk = 0;
+    uint32_t offset = 0;
 
-    while(length > 256) {
-        ebh_format_package(EBH_CMD_RX_DATA_BLOCK, 3, a0, a1, a2, 0, &data[offset], 256u);
-        ack = ebh_receive_ack();
+    do {
+        chunk = (length - offset > block) ? block : (length - offset);
+        ack = ebh_rx_data_frame(cmd, a_len, addr + offset, &data[offset], chunk);
         if(ack != EBH_UART_ERROR_ACK) {
             return ack;
         }
-        ebh_receive_core_response(rx_buf, 2);
-        if((rx_buf[0] == EBH_CORE_MSG_MESSAGE) && (rx_buf[1] != EBH_CORE_MSG_OPERATION_SUCCESSFUL)) {
-            return rx_buf[1];
+        offset += chunk;
+    } while(offset < length);
+
+    return EBH_UART_ERROR_ACK;
+}
+
+uint8_t ebh_rx_data_block(uint32_t addr, const uint8_t *data, uint16_t length) {
+    return ebh_rx_data_blocks(EBH_CMD_RX_DATA_BLOCK, 3, addr, data, length);
+}
+
+uint8_t ebh_rx_data_block_32(uint32_t addr, const uint8_t *data, uint16_t length) {
+    return ebh_rx_data_blocks(EBH_CMD_RX_DATA_BLOCK_32, 4, addr, data, length);
+}
+
+void ebh_set_progress(ebh_progress progress, void *context) {
+    ebh_progress_callback = progress;
+    ebh_progress_context = context;
+}
+
+/* Fills data from the source, fewer bytes than length only at its end */
+static uint16_t ebh_source_read(ebh_source source, void *context, uint8_t *data, uint16_t length) {
+    uint16_t count = 0;
+    uint16_t n = 0;
+
+    while(count < length) {
+        n = source(context, &data[count], length - count);
+        if(n == 0) {
+            break;
         }
-        offset += 256;
-        length -= 256;
-        a1 = ((addr + offset) >> 8) & 0xFF;
-        a2 = ((addr + offset) >> 16) & 0xFF;
+        count += n;
     }
-    ebh_format_package(EBH_CMD_RX_DATA_BLOCK, 3, a0, a1, a2, 0, &data[offset], length);
+    return count;
+}
 
-    ack = ebh_receive_ack();
-    if(ack != EBH_UART_ERROR_ACK) {
-        return ack;
-    }
+/* Data either from memory or pulled from a source. Frames starting below 16 MB use the 24 bit address of RX_DATA_BLOCK. */
+static uint8_t ebh_write(uint32_t addr, const uint8_t *data, ebh_source source, void *context, uint32_t length) {
+    static uint8_t buffer[EBH_MAX_BUFFER_SIZE];
+    const uint8_t *chunk_data = 0;
+    uint8_t ack = 0;
+    uint8_t a_len = 0;
+    uint32_t chunk = 0;
+    uint32_t chunk_addr = 0;
+    uint32_t offset = 0;
+
+#ifdef EBH_PART
+    if(!ebh_part_allows(&EBH_PART, addr, length, EBH_MEMORY_WRITE)) {
+        return EBH_UART_ERROR_PART_ADDRESS;
+    }
+#endif
+
+    while(offset < length) {
+        chunk_addr = addr + offset;
+        a_len = (chunk_addr < 0x1000000u) ? 3 : 4;
+        chunk = ebh_data_block_size(a_len);
+        if(chunk > length - offset) {
+            chunk = length - offset;
+        }
+        if((a_len == 3) && (chunk > 0x1000000u - chunk_addr)) {
+            chunk = 0x1000000u - chunk_addr;  // The rest continues with 32 bit addresses
+        }
 
-    ebh_receive_core_response(rx_buf, 2);
-    if((rx_buf[0] == EBH_CORE_MSG_MESSAGE) && (rx_buf[1] != EBH_CORE_MSG_OPERATION_SUCCESSFUL)) {
-        return rx_buf[1];
+        if(data) {
+            chunk_data = &data[offset];
+        } else {
+            if(ebh_source_read(source, context, buffer, chunk) != chunk) {
+                return EBH_UART_ERROR_SOURCE_ENDED;
+            }
+            chunk_data = buffer;
+        }
+
+        ack = ebh_rx_data_frame((a_len == 3) ? EBH_CMD_RX_DATA_BLOCK : EBH_CMD_RX_DATA_BLOCK_32, a_len, chunk_addr, chunk_data, chunk);
+        if(ack != EBH_UART_ERROR_ACK) {
+            return ack;
+        }
+        offset += chunk;
+        if(ebh_progress_callback) {
+            ebh_progress_callback(ebh_progress_context, offset, length);
+        }
     }
+
     return EBH_UART_ERROR_ACK;
 }
 
-uint8_t ebh_rx_data_block_32(uint32_t addr, uint8_t *data, uint16_t length) {
-    uint8_t ack = 0;
-    uint8_t rx_buf[2];  // This command expects no core response message bigger than 2.
+uint16_t ebh_write_block_size(uint32_t addr) {
+    return ebh_data_block_size((addr < 0x1000000u) ? 3 : 4);
+}
 
-    uint16_t offset = 0;
-    uint8_t a0 = addr & 0xFF;
-    uint8_t a1 = (addr >> 8) & 0xFF;
-    uint8_t a2 = (addr >> 16) & 0xFF;
-    uint8_t a3 = (addr >> 24) & 0xFF;
+uint8_t ebh_write_region(uint32_t addr, const uint8_t *data, uint32_t length) {
+    return ebh_write(addr, data, 0, 0, length);
+}
 
-    while(length > 256) {
-        ebh_format_package(EBH_CMD_RX_DATA_BLOCK_32, 4, a0, a1, a2, a3, &data[offset], 256u);
-        ack = ebh_receive_ack();
+uint8_t ebh_write_stream(uint32_t addr, uint32_t length, ebh_source source, void *context) {
+    return ebh_write(addr, 0, source, context, length);
+}
+
+static uint8_t ebh_receive_ack_after_write(void) {
+    // The target takes the next frame once the previous block is programmed, which may exceed EBH_ACK_TIMEOUT
+    if(ebh_ack_armed) {
+        ebh_ack_deadline += EBH_RESPONSE_TIMEOUT;
+    }
+    return ebh_receive_ack();
+}
+
+uint8_t ebh_rx_data_block_fast(uint32_t addr, const uint8_t *data, uint16_t length) {
+    uint8_t ack = 0;
+    uint8_t attempt = 0;
+    uint16_t crc = 0;
+    uint16_t block = ebh_data_block_size(3);
+    uint16_t chunk = 0;
+    uint16_t offset = 0;
+    uint32_t chunk_addr = 0;
+
+    // The target answers each frame with the ACK only, there is no core response to wait for.
+    while(offset < length) {
+        chunk = (length - offset > block) ? block : (length - offset);
+        chunk_addr = addr + offset;
+        attempt = 0;
+        do {
+            ack = ebh_format_package(EBH_CMD_RX_DATA_BLOCK_FAST, 3, chunk_addr & 0xFF, (chunk_addr >> 8) & 0xFF, (chunk_addr >> 16) & 0xFF, 0, &data[offset], chunk);
+            if(ack == EBH_UART_ERROR_ACK) {
+                ack = ebh_receive_ack_after_write();
+            }
+        } while((ack != EBH_UART_ERROR_ACK) && ebh_retry_frame(attempt++, ack));
         if(ack != EBH_UART_ERROR_ACK) {
             return ack;
         }
-        ebh_receive_core_response(rx_buf, 2);
-        if((rx_buf[0] == EBH_CORE_MSG_MESSAGE) && (rx_buf[1] != EBH_CORE_MSG_OPERATION_SUCCESSFUL)) {
-            return rx_buf[1];
-        }
-        offset += 256;
-        length -= 256;
-        a1 = ((addr + offset) >> 8) & 0xFF;
-        a2 = ((addr + offset) >> 16) & 0xFF;
-        a3 = ((addr + offset) >> 24) & 0xFF;
+        offset += chunk;
     }
-    ebh_format_package(EBH_CMD_RX_DATA_BLOCK_32, 4, a0, a1, a2, a3, &data[offset], length);
 
-    ack = ebh_receive_ack();
+    // Write errors are only caught by verifying the whole range afterwards
+    ack = ebh_crc_check_command(EBH_CMD_CRC_CHECK, 3, addr, length, &crc, ebh_receive_ack_after_write);
     if(ack != EBH_UART_ERROR_ACK) {
         return ack;
     }
-
-    ebh_receive_core_response(rx_buf, 2);
-    if((rx_buf[0] == EBH_CORE_MSG_MESSAGE) && (rx_buf[1] != EBH_CORE_MSG_OPERATION_SUCCESSFUL)) {
-        return rx_buf[1];
+    if(crc != ebh_crc_update(0xFFFF, data, length)) {
+        return EBH_UART_ERROR_VERIFY_FAILED;
     }
     return EBH_UART_ERROR_ACK;
 }
 
-uint8_t ebh_rx_password(uint8_t *data) {
+uint8_t ebh_rx_password(const uint8_t *data) {
     uint8_t ack = 0;
     uint8_t rx_buf[2];  // This command expects no core response message bigger than 2.
 
@@ -279,15 +534,17 @@ uint8_t ebh_rx_password(uint8_t *data) {
     if(ack != EBH_UART_ERROR_ACK) {
         return ack;
     }
-
-    ebh_receive_core_response(rx_buf, 2);
+    ack = ebh_receive_core_response(rx_buf, 2, 0);
+    if(ack != EBH_UART_ERROR_ACK) {
+        return ack;
+    }
     if((rx_buf[0] == EBH_CORE_MSG_MESSAGE) && (rx_buf[1] != EBH_CORE_MSG_OPERATION_SUCCESSFUL)) {
         return rx_buf[1];
     }
     return EBH_UART_ERROR_ACK;
 }
 
-uint8_t ebh_rx_password_32(uint8_t *data) {
+uint8_t ebh_rx_password_32(const uint8_t *data) {
     uint8_t ack = 0;
     uint8_t rx_buf[2];  // This command expects no core response message bigger than 2.
 
@@ -297,8 +554,10 @@ uint8_t ebh_rx_password_32(uint8_t *data) {
     if(ack != EBH_UART_ERROR_ACK) {
         return ack;
     }
-
-    ebh_receive_core_response(rx_buf, 2);
+    ack = ebh_receive_core_response(rx_buf, 2, 0);
+    if(ack != EBH_UART_ERROR_ACK) {
+        return ack;
+    }
     if((rx_buf[0] == EBH_CORE_MSG_MESSAGE) && (rx_buf[1] != EBH_CORE_MSG_OPERATION_SUCCESSFUL)) {
         return rx_buf[1];
     }
@@ -313,14 +572,22 @@ uint8_t ebh_erase_segment(uint32_t addr) {
     uint8_t a1 = (addr >> 8) & 0xFF;
     uint8_t a2 = (addr >> 16) & 0xFF;
 
+#ifdef EBH_PART
+    if(!ebh_part_allows(&EBH_PART, addr, 1, EBH_MEMORY_ERASE)) {
+        return EBH_UART_ERROR_PART_ADDRESS;
+    }
+#endif
+
     ebh_format_package(EBH_CMD_ERASE_SEGMENT, 3, a0, a1, a2, 0, 0, 0);
 
     ack = ebh_receive_ack();
     if(ack != EBH_UART_ERROR_ACK) {
         return ack;
     }
-
-    ebh_receive_core_response(rx_buf, 2);
+    ack = ebh_receive_core_response(rx_buf, 2, 0);
+    if(ack != EBH_UART_ERROR_ACK) {
+        return ack;
+    }
     if((rx_buf[0] == EBH_CORE_MSG_MESSAGE) && (rx_buf[1] != EBH_CORE_MSG_OPERATION_SUCCESSFUL)) {
         return rx_buf[1];
     }
@@ -336,14 +603,22 @@ uint8_t ebh_erase_segment_32(uint32_t addr) {
     uint8_t a2 = (addr >> 16) & 0xFF;
     uint8_t a3 = (addr >> 24) & 0xFF;
 
+#ifdef EBH_PART
+    if(!ebh_part_allows(&EBH_PART, addr, 1, EBH_MEMORY_ERASE)) {
+        return EBH_UART_ERROR_PART_ADDRESS;
+    }
+#endif
+
     ebh_format_package(EBH_CMD_ERASE_SEGMENT_32, 4, a0, a1, a2, a3, 0, 0);
 
     ack = ebh_receive_ack();
     if(ack != EBH_UART_ERROR_ACK) {
         return ack;
     }
-
-    ebh_receive_core_response(rx_buf, 2);
+    ack = ebh_receive_core_response(rx_buf, 2, 0);
+    if(ack != EBH_UART_ERROR_ACK) {
+        return ack;
+    }
     if((rx_buf[0] == EBH_CORE_MSG_MESSAGE) && (rx_buf[1] != EBH_CORE_MSG_OPERATION_SUCCESSFUL)) {
         return rx_buf[1];
     }
@@ -354,14 +629,16 @@ uint8_t ebh_unlock_and_lock_info(void) {
     uint8_t ack = 0;
     uint8_t rx_buf[2];  // This command expects no core response message bigger than 2.
 
-    ebh_format_package(EBH_CMD_UNLOCK_AND_LOCK_INFO, 0, 0, 0, 0, 0, 0, 0);
+    ebh_send_frame(ebh_frame_unlock_and_lock_info, sizeof(ebh_frame_unlock_and_lock_info));
 
     ack = ebh_receive_ack();
     if(ack != EBH_UART_ERROR_ACK) {
         return ack;
     }
-
-    ebh_receive_core_response(rx_buf, 2);
+    ack = ebh_receive_core_response(rx_buf, 2, 0);
+    if(ack != EBH_UART_ERROR_ACK) {
+        return ack;
+    }
     if((rx_buf[0] == EBH_CORE_MSG_MESSAGE) && (rx_buf[1] != EBH_CORE_MSG_OPERATION_SUCCESSFUL)) {
         return rx_buf[1];
     }
@@ -372,7 +649,7 @@ uint8_t ebh_mass_erase(ebh_device device) {
     uint8_t ack = 0;
     uint8_t rx_buf[2];  // This command expects no core response message bigger than 2.
 
-    ebh_format_package(EBH_CMD_MASS_ERASE, 0, 0, 0, 0, 0, 0, 0);
+    ebh_send_frame(ebh_frame_mass_erase, sizeof(ebh_frame_mass_erase));
 
     // MSP430 FRAM devices do not return a ACK or core message as they reboot on mass erase
     if(device != ebh_device_msp430_fram) {
@@ -380,8 +657,10 @@ uint8_t ebh_mass_erase(ebh_device device) {
         if(ack != EBH_UART_ERROR_ACK) {
             return ack;
         }
-
-        ebh_receive_core_response(rx_buf, 2);
+        ack = ebh_receive_core_response(rx_buf, 2, 0);
+        if(ack != EBH_UART_ERROR_ACK) {
+            return ack;
+        }
         if((rx_buf[0] == EBH_CORE_MSG_MESSAGE) && (rx_buf[1] != EBH_CORE_MSG_OPERATION_SUCCESSFUL)) {
             return rx_buf[1];
         }
@@ -391,31 +670,29 @@ uint8_t ebh_mass_erase(ebh_device device) {
 }
 
 uint8_t ebh_reboot_reset(void) {
-    ebh_format_package(EBH_CMD_REBOOT_RESET, 0, 0, 0, 0, 0, 0, 0);
+    ebh_send_frame(ebh_frame_reboot_reset, sizeof(ebh_frame_reboot_reset));
     return EBH_UART_ERROR_ACK;
 }
 
-uint8_t ebh_crc_check(uint32_t addr, uint16_t length, uint16_t *data) {
+static uint8_t ebh_crc_check_command(uint8_t cmd, uint8_t a_len, uint32_t addr, uint16_t length, uint16_t *data, uint8_t (*receive_ack)(void)) {
     uint8_t ack = 0;
     uint8_t rx_buf[3];  // This command expects no core response message bigger than 3.
 
-    uint8_t a0 = addr & 0xFF;
-    uint8_t a1 = (addr >> 8) & 0xFF;
-    uint8_t a2 = (addr >> 16) & 0xFF;
-
     uint8_t len[2];
     len[0] = length & 0xFF;
     len[1] = (length >> 8) & 0xFF;
 
-    ebh_format_package(EBH_CMD_CRC_CHECK, 3, a0, a1, a2, 0, len, 2u);
+    ebh_format_package(cmd, a_len, addr & 0xFF, (addr >> 8) & 0xFF, (addr >> 16) & 0xFF, (addr >> 24) & 0xFF, len, 2u);
 
-    ack = ebh_receive_ack();
+    ack = receive_ack();
     if(ack != EBH_UART_ERROR_ACK) {
         return ack;
     }
-
-    ebh_receive_core_response(rx_buf, 3);
-    if((rx_buf[0] == EBH_CORE_MSG_DATA)) {
+    ack = ebh_receive_core_response(rx_buf, 3, 0);
+    if(ack != EBH_UART_ERROR_ACK) {
+        return ack;
+    }
+    if(rx_buf[0] == EBH_CORE_MSG_DATA) {
         *data = rx_buf[1] + (rx_buf[2] << 8);
     } else {  // Error case
         return rx_buf[1];
@@ -424,34 +701,94 @@ uint8_t ebh_crc_check(uint32_t addr, uint16_t length, uint16_t *data) {
     return EBH_UART_ERROR_ACK;
 }
 
+uint8_t ebh_crc_check(uint32_t addr, uint16_t length, uint16_t *data) {
+    return ebh_crc_check_command(EBH_CMD_CRC_CHECK, 3, addr, length, data, ebh_receive_ack);
+}
+
 uint8_t ebh_crc_check_32(uint32_t addr, uint16_t length, uint16_t *data) {
+    return ebh_crc_check_command(EBH_CMD_CRC_CHECK_32, 4, addr, length, data, ebh_receive_ack);
+}
+
+static uint8_t ebh_tx_data_blocks(uint8_t cmd, uint8_t a_len, uint32_t addr, uint32_t length, ebh_sink sink, void *context) {
+    static uint8_t rx_buf[EBH_MAX_RESPONSE_SIZE];  // Core response: EBH_CORE_MSG_DATA and the block
     uint8_t ack = 0;
-    uint8_t rx_buf[3];  // This command expects no core response message bigger than 3.
+    uint8_t attempt = 0;
+    uint8_t len[2];
+    uint16_t block = ebh_data_block_size(a_len);
+    uint16_t chunk = 0;
+    uint16_t received = 0;
+    uint32_t offset = 0;
+    uint32_t chunk_addr = 0;
+
+    if(block > EBH_MAX_RESPONSE_SIZE - 1) {
+        block = EBH_MAX_RESPONSE_SIZE - 1;
+    }
+
+    while(offset < length) {
+        chunk = (length - offset > block) ? block : (length - offset);
+        chunk_addr = addr + offset;
+        len[0] = chunk & 0xFF;
+        len[1] = (chunk >> 8) & 0xFF;
+
+        attempt = 0;
+        do {
+            ebh_format_package(cmd, a_len, chunk_addr & 0xFF, (chunk_addr >> 8) & 0xFF, (chunk_addr >> 16) & 0xFF, (chunk_addr >> 24) & 0xFF, len, 2u);
+            ack = ebh_receive_ack();
+            if(ack == EBH_UART_ERROR_ACK) {
+                ack = ebh_receive_core_response(rx_buf, sizeof(rx_buf), &received);
+            }
+        } while((ack != EBH_UART_ERROR_ACK) && ebh_retry_frame(attempt++, ack));
+        if(ack != EBH_UART_ERROR_ACK) {
+            return ack;
+        }
+        if((rx_buf[0] == EBH_CORE_MSG_MESSAGE) && (received == 2) && (rx_buf[1] != EBH_CORE_MSG_OPERATION_SUCCESSFUL)) {  // Error case
+            return rx_buf[1];
+        }
+        if((rx_buf[0] != EBH_CORE_MSG_DATA) || (received != 1 + chunk)) {  // A block of another length would shift the image
+            return EBH_UART_ERROR_RESPONSE_INVALID;
+        }
 
-    uint8_t a0 = addr & 0xFF;
-    uint8_t a1 = (addr >> 8) & 0xFF;
-    uint8_t a2 = (addr >> 16) & 0xFF;
-    uint8_t a3 = (addr >> 24) & 0xFF;
+        ack = sink(context, chunk_addr, &rx_buf[1], chunk);
+        if(ack != 0) {
+            return ack;
+        }
+        offset += chunk;
+    }
 
-    uint8_t len[2];
-    len[0] = length & 0xFF;
-    len[1] = (length >> 8) & 0xFF;
+    return EBH_UART_ERROR_ACK;
+}
 
-    ebh_format_package(EBH_CMD_CRC_CHECK_32, 4, a0, a1, a2, a3, len, 2u);
+uint8_t ebh_tx_data_block(uint32_t addr, uint32_t length, ebh_sink sink, void *context) {
+    return ebh_tx_data_blocks(EBH_CMD_TX_DATA_BLOCK, 3, addr, length, sink, context);
+}
 
-    ack = ebh_receive_ack();
-    if(ack != EBH_UART_ERROR_ACK) {
-        return ack;
-    }
+uint8_t ebh_tx_data_block_32(uint32_t addr, uint32_t length, ebh_sink sink, void *context) {
+    return ebh_tx_data_blocks(EBH_CMD_TX_DATA_BLOCK_32, 4, addr, length, sink, context);
+}
 
-    ebh_receive_core_response(rx_buf, 3);
-    if((rx_buf[0] == EBH_CORE_MSG_DATA)) {
-        *data = rx_buf[1] + (rx_buf[2] << 8);
-    } else {  // Error case
-        return rx_buf[1];
-    }
+void ebh_verify_init(ebh_verify *verify, uint32_t addr, const uint8_t *image) {
+    verify->image = image;
+    verify->addr = addr;
+    verify->mismatches = 0;
+    verify->first_mismatch = 0;
+    verify->last_mismatch = 0;
+}
 
-    return EBH_UART_ERROR_ACK;
+uint8_t ebh_verify_sink(void *context, uint32_t addr, const uint8_t *data, uint16_t length) {
+    ebh_verify *verify = (ebh_verify *)context;
+    const uint8_t *image = &verify->image[addr - verify->addr];
+    uint16_t i = 0;
+
+    // Blocks are compared as they arrive, the first and last differing address bound the damage
+    for(i = 0; i < length; i++) {
+        if(data[i] != image[i]) {
+            if(verify->mismatches++ == 0) {
+                verify->first_mismatch = addr + i;
+            }
+            verify->last_mismatch = addr + i;
+        }
+    }
+    return 0;
 }
 
 uint8_t ebh_load_pc(uint32_t addr) {
@@ -495,14 +832,16 @@ uint8_t ebh_tx_bsl_version(ebh_device device, uint8_t *data) {
                          // Given that at least two conditions more would be required to lower the buffer size for MSP430 only
                          // 'spending' the additional 6 byte seems acceptable.
 
-    ebh_format_package(EBH_CMD_TX_BSL_VERSION, 0, 0, 0, 0, 0, 0, 0);
+    ebh_send_frame(ebh_frame_tx_bsl_version, sizeof(ebh_frame_tx_bsl_version));
 
     ack = ebh_receive_ack();
     if(ack != EBH_UART_ERROR_ACK) {
         return ack;
     }
-
-    ebh_receive_core_response(rx_buf, 11);
+    ack = ebh_receive_core_response(rx_buf, 11, 0);
+    if(ack != EBH_UART_ERROR_ACK) {
+        return ack;
+    }
 
     if((rx_buf[0] != EBH_CORE_MSG_DATA)) {  // Error case
         return rx_buf[1];
@@ -522,7 +861,31 @@ uint8_t ebh_tx_bsl_version(ebh_device device, uint8_t *data) {
     return EBH_UART_ERROR_ACK;
 }
 
-uint8_t ebh_factory_reset(uint8_t *data) {
+uint8_t ebh_tx_buffer_size(uint16_t *size) {
+    uint8_t ack = 0;
+    uint8_t rx_buf[3];  // This command expects no core response message bigger than 3.
+
+    ebh_send_frame(ebh_frame_tx_buffer_size, sizeof(ebh_frame_tx_buffer_size));
+
+    ack = ebh_receive_ack();
+    if(ack != EBH_UART_ERROR_ACK) {
+        return ack;
+    }
+    ack = ebh_receive_core_response(rx_buf, 3, 0);
+    if(ack != EBH_UART_ERROR_ACK) {
+        return ack;
+    }
+    if(rx_buf[0] == EBH_CORE_MSG_DATA) {
+        *size = rx_buf[1] + (rx_buf[2] << 8);
+        ebh_session_buffer_size = *size;
+    } else {  // Error case
+        return rx_buf[1];
+    }
+
+    return EBH_UART_ERROR_ACK;
+}
+
+uint8_t ebh_factory_reset(const uint8_t *data) {
 
     ebh_format_package(EBH_CMD_FACTORY_RESET, 0, 0, 0, 0, 0, data, 16u);
 
@@ -530,6 +893,10 @@ uint8_t ebh_factory_reset(uint8_t *data) {
 }
 
 uint8_t ebh_change_baud_rate(uint8_t baud_rate) {
-    ebh_format_package(EBH_CMD_CHANGE_BAUD_RATE, 1, baud_rate, 0, 0, 0, 0, 0);
+    if((baud_rate >= EBH_UART_BAUD_RATE_9600) && (baud_rate <= EBH_UART_BAUD_RATE_115200)) {
+        ebh_send_frame(ebh_frame_change_baud_rate[baud_rate - EBH_UART_BAUD_RATE_9600], EBH_CONST_FRAME_2_SIZE);
+    } else {
+        ebh_format_package(EBH_CMD_CHANGE_BAUD_RATE, 1, baud_rate, 0, 0, 0, 0, 0);  // The BSL answers with EBH_UART_ERROR_UNKNOWN_BAUD_RATE
+    }
     return ebh_receive_ack();
 }
@@ -28,26 +28,83 @@
 
 #include <stdint.h>
 #include "devices/devices.h"
+#include "transport.h"
+#include "bsl_frame.h"
 
 typedef enum {ebh_device_msp430_flash, ebh_device_msp430_fram, ebh_device_msp432} ebh_device;
 
+/* Receives the blocks read from the target in address order. Any return value but 0 aborts the readback and is returned. */
+typedef uint8_t (*ebh_sink)(void *context, uint32_t addr, const uint8_t *data, uint16_t length);
+
+/* Delivers the next bytes of a stream written by ebh_write_stream(). Returns the number of bytes copied to data, 0 at the end. */
+typedef uint16_t (*ebh_source)(void *context, uint8_t *data, uint16_t length);
+
+/* Called after every block written by ebh_write_region() / ebh_write_stream() */
+typedef void (*ebh_progress)(void *context, uint32_t done, uint32_t total);
+
+/*
+ * Retransmission of data block frames that failed on the line (NAK, timeout, corrupted
+ * response). Answers of the BSL (e.g. BSL locked) are not retried. Before attempt n + 1 the
+ * host waits backoff << n plus up to jitter microseconds, resyncs after a timeout and calls
+ * downshift (e.g. ebh_link_downshift) after downshift_after failed attempts.
+ */
+typedef struct {
+    uint8_t retries;           // Attempts after the first one, 0 disables retransmission
+    uint16_t backoff;          // us
+    uint16_t jitter;           // us
+    uint8_t (*downshift)(void);
+    uint8_t downshift_after;   // 0: never
+} ebh_retry_policy;
+
+/* Context of ebh_verify_sink(): compares the readback with the image starting at addr */
+typedef struct {
+    const uint8_t *image;
+    uint32_t addr;
+    uint32_t mismatches;       // Number of differing bytes
+    uint32_t first_mismatch;   // Address of the first differing byte
+    uint32_t last_mismatch;    // Address of the last differing byte
+} ebh_verify;
+
+/* ebh_session_reset() forgets what was learned about the target (e.g. its buffer size). Called by ebh_invoke_sequence() and ebh_sync_character(). */
+void ebh_session_reset(void);
+
 void ebh_invoke_sequence(void);
 
 void ebh_sync_character(void);
 
 void ebh_delay_between_commands(void);
 
-uint8_t ebh_format_package(uint8_t cmd, uint8_t a_len, uint8_t a0, uint8_t a1, uint8_t a2, uint8_t a3, uint8_t  *payload, uint16_t length);
+uint8_t ebh_format_package(uint8_t cmd, uint8_t a_len, uint8_t a0, uint8_t a1, uint8_t a2, uint8_t a3, const uint8_t *payload, uint16_t length);
 
 uint8_t ebh_receive_ack();
 
-uint8_t ebh_receive_core_response(uint8_t *payload, uint16_t max_buffer);
+uint8_t ebh_receive_core_response(uint8_t *payload, uint16_t max_buffer, uint16_t *length);  // length (if not 0): size of the core response, which may exceed max_buffer
+uint16_t ebh_receive_discarded(void);  // Bytes dropped while resynchronizing on the last core response
 
-uint8_t ebh_rx_data_block(uint32_t addr, uint8_t *data, uint16_t length);
-uint8_t ebh_rx_data_block_32(uint32_t addr, uint8_t *data, uint16_t length);
+/* ebh_resync() ends a frame the target may still be receiving after line errors and drops its answers. */
+void ebh_resync(void);
 
-uint8_t ebh_rx_password(uint8_t *data);
-uint8_t ebh_rx_password_32(uint8_t *data);
+uint8_t ebh_rx_data_block(uint32_t addr, const uint8_t *data, uint16_t length);
+uint8_t ebh_rx_data_block_32(uint32_t addr, const uint8_t *data, uint16_t length);
+
+/*
+ * ebh_write_region() writes an image of any size in blocks sized to the buffer of the target.
+ * Blocks below 16 MB are sent with RX_DATA_BLOCK, all others with RX_DATA_BLOCK_32.
+ * ebh_write_stream() does the same with data pulled from `source`.
+ */
+uint8_t ebh_write_region(uint32_t addr, const uint8_t *data, uint32_t length);
+uint8_t ebh_write_stream(uint32_t addr, uint32_t length, ebh_source source, void *context);
+void ebh_set_progress(ebh_progress progress, void *context);  // 0 disables the progress report
+uint16_t ebh_write_block_size(uint32_t addr);  // Data bytes per RX_DATA_BLOCK(_32) frame at addr
+
+void ebh_set_retry_policy(const ebh_retry_policy *policy);  // Default: EBH_RETRIES, EBH_RETRY_BACKOFF, EBH_RETRY_JITTER
+uint32_t ebh_retries(void);  // Frames sent again in this session
+
+/* ebh_rx_data_block_fast() streams the blocks without core responses and verifies the range with CRC_CHECK. MSP430 5xx/6xx only. */
+uint8_t ebh_rx_data_block_fast(uint32_t addr, const uint8_t *data, uint16_t length);
+
+uint8_t ebh_rx_password(const uint8_t *data);
+uint8_t ebh_rx_password_32(const uint8_t *data);
 
 uint8_t ebh_erase_segment(uint32_t addr);
 uint8_t ebh_erase_segment_32(uint32_t addr);
@@ -62,12 +119,22 @@ uint8_t ebh_reboot_reset(void);
 uint8_t ebh_crc_check(uint32_t addr, uint16_t length, uint16_t *data);
 uint8_t ebh_crc_check_32(uint32_t addr, uint16_t length, uint16_t *data);
 
+/* ebh_tx_data_block() reads `length` bytes at `addr` in blocks sized to the buffer of the target and passes them to `sink`. */
+uint8_t ebh_tx_data_block(uint32_t addr, uint32_t length, ebh_sink sink, void *context);
+uint8_t ebh_tx_data_block_32(uint32_t addr, uint32_t length, ebh_sink sink, void *context);
+
+void ebh_verify_init(ebh_verify *verify, uint32_t addr, const uint8_t *image);
+uint8_t ebh_verify_sink(void *context, uint32_t addr, const uint8_t *data, uint16_t length);
+
 uint8_t ebh_load_pc(uint32_t addr);
 uint8_t ebh_load_pc_32(uint32_t addr);
 
 uint8_t ebh_tx_bsl_version(ebh_device device, uint8_t *data);
 
-uint8_t ebh_factory_reset(uint8_t *data);
+/* ebh_tx_buffer_size() reads the size of the BSL core data packet buffer. The data block writers query it once per session. (MSP430) */
+uint8_t ebh_tx_buffer_size(uint16_t *size);
+
+uint8_t ebh_factory_reset(const uint8_t *data);
 
 uint8_t ebh_change_baud_rate(uint8_t baud_rate);
 
@@ -0,0 +1,232 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Max Groening
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <stdint.h>
+#include <string.h>
+#include "config.h"
+#include "erase.h"
+#include "gap.h"
+#include "timing.h"
+#include "crc_ccitt.h"
+#include "embedded_bootloader.h"
+#include "embedded_bootloader/bootloader_protocol.h"
+
+#define EBH_ERASE_ADDR_24   0x1000000u   // ERASE_SEGMENT below, ERASE_SEGMENT_32 above
+#define EBH_ERASE_RESPONSE  8            // ACK and core response frame
+
+typedef struct {
+    ebh_erase_plan *plan;
+    const ebh_erase_options *options;
+    uint8_t seen;
+    uint32_t last;              // Last segment of the image so far
+    const ebh_memory *memory;   // Memory of the naive span
+    uint32_t first;
+    uint32_t mass_us;           // Planned segments MASS_ERASE clears
+    uint16_t mass_count;
+} ebh_erase_state;
+
+uint32_t ebh_erase_segment_time(uint32_t addr) {
+    uint32_t line = EBH_FRAME_OVERHEAD + 1 + ((addr < EBH_ERASE_ADDR_24) ? 3 : 4) + EBH_ERASE_RESPONSE;
+    return ebh_line_time_us(line) + EBH_PLAN_COMMAND_TIME + EBH_ERASE_SEGMENT_TIME + ebh_gap_after(EBH_CMD_ERASE_SEGMENT);
+}
+
+uint32_t ebh_erase_mass_time(void) {
+    return ebh_line_time_us(EBH_FRAME_OVERHEAD + 1 + EBH_ERASE_RESPONSE) + EBH_PLAN_COMMAND_TIME + EBH_ERASE_MASS_TIME +
+           ebh_gap_after(EBH_CMD_MASS_ERASE);
+}
+
+/* Every segment from the lowest to the highest image address of the memory */
+static void ebh_erase_naive(ebh_erase_state *state) {
+    uint32_t addr = 0;
+
+    if(state->memory) {
+        for(addr = state->first; addr <= state->last; addr += state->memory->segment) {
+            state->plan->naive_us += ebh_erase_segment_time(addr);
+        }
+    }
+    state->memory = 0;
+}
+
+/* Plans the segments of the image data [start, end) inside the memory */
+static uint8_t ebh_erase_span(ebh_erase_state *state, const ebh_memory *memory, uint32_t start, uint32_t end) {
+    ebh_erase_plan *plan = state->plan;
+    uint32_t addr = 0;
+
+    if(memory != state->memory) {
+        ebh_erase_naive(state);
+        state->memory = memory;
+        state->first = start & ~(memory->segment - 1u);
+    }
+
+    for(addr = start & ~(memory->segment - 1u); addr < end; addr += memory->segment) {
+        if(state->seen && (addr <= state->last)) {
+            continue;  // Shared with the range in front
+        }
+        state->seen = 1;
+        state->last = addr;
+
+        if(state->options->blank && state->options->blank(state->options->context, addr, memory->segment)) {
+            plan->blank++;
+            continue;
+        }
+        if(plan->count == plan->max_segments) {
+            return EBH_UART_ERROR_PLAN_FULL;
+        }
+        plan->segments[plan->count++] = addr;
+        plan->time_us += ebh_erase_segment_time(addr);
+        if(memory->flags & EBH_MEMORY_MASS) {
+            state->mass_us += ebh_erase_segment_time(addr);
+            state->mass_count++;
+        }
+    }
+    return EBH_UART_ERROR_ACK;
+}
+
+static uint8_t ebh_erase_range(ebh_erase_state *state, const ebh_part *part, const ebh_range *range) {
+    const ebh_memory *memory = ebh_part_memory(part, range->addr);
+    const ebh_memory *last = &part->memory[part->memory_count - 1];
+    uint32_t end = range->addr + range->length;
+    uint8_t status = EBH_UART_ERROR_ACK;
+
+    if(!ebh_part_allows(part, range->addr, range->length, EBH_MEMORY_WRITE)) {
+        return EBH_UART_ERROR_PART_ADDRESS;
+    }
+    for(; (range->length > 0) && (memory <= last) && (memory->start < end) && (status == EBH_UART_ERROR_ACK); memory++) {
+        if(memory->flags & EBH_MEMORY_ERASE) {
+            status = ebh_erase_span(state, memory, (range->addr > memory->start) ? range->addr : memory->start,
+                                    (end < memory->end) ? end : memory->end);
+        }
+    }
+    return status;
+}
+
+uint8_t ebh_erase_make(ebh_erase_plan *plan, const ebh_range *ranges, uint16_t range_count, const ebh_part *part,
+                       const ebh_erase_options *options, uint32_t *segments, uint16_t max_segments) {
+    ebh_erase_state state;
+    const ebh_memory *memory = 0;
+    uint8_t status = EBH_UART_ERROR_ACK;
+    uint16_t count = 0;
+    uint16_t i = 0;
+
+    plan->strategy = ebh_erase_none;
+    plan->segments = segments;
+    plan->max_segments = max_segments;
+    plan->count = 0;
+    plan->blank = 0;
+    plan->time_us = 0;
+    plan->naive_us = 0;
+
+    for(i = 0; i < part->memory_count; i++) {
+        memory = &part->memory[i];
+        if((memory->flags & EBH_MEMORY_ERASE) && ((memory->segment == 0) || (memory->segment & (memory->segment - 1)))) {
+            return EBH_UART_ERROR_PLAN_RANGES;
+        }
+    }
+    for(i = 1; i < range_count; i++) {
+        if(ranges[i].addr < ranges[i - 1].addr + ranges[i - 1].length) {
+            return EBH_UART_ERROR_PLAN_RANGES;
+        }
+    }
+
+    state.plan = plan;
+    state.options = options;
+    state.seen = 0;
+    state.last = 0;
+    state.memory = 0;
+    state.first = 0;
+    state.mass_us = 0;
+    state.mass_count = 0;
+    for(i = 0; (i < range_count) && (status == EBH_UART_ERROR_ACK); i++) {
+        status = ebh_erase_range(&state, part, &ranges[i]);
+    }
+    if(status != EBH_UART_ERROR_ACK) {
+        return status;
+    }
+    ebh_erase_naive(&state);
+
+    if(plan->count == 0) {
+        return EBH_UART_ERROR_ACK;
+    }
+    plan->strategy = ebh_erase_segments;
+    if(!options->keep && state.mass_count && (ebh_erase_mass_time() < state.mass_us)) {
+        // MASS_ERASE replaces the segments of the memory it clears
+        for(i = 0; i < plan->count; i++) {
+            if(!(ebh_part_memory(part, segments[i])->flags & EBH_MEMORY_MASS)) {
+                segments[count++] = segments[i];
+            }
+        }
+        plan->count = count;
+        plan->strategy = ebh_erase_mass;
+        plan->time_us = plan->time_us - state.mass_us + ebh_erase_mass_time();
+    }
+    return EBH_UART_ERROR_ACK;
+}
+
+uint8_t ebh_erase_run(const ebh_erase_plan *plan, ebh_device device, int32_t *saved_us) {
+    uint32_t start = ebh_time_us();
+    uint8_t status = EBH_UART_ERROR_ACK;
+    uint16_t i = 0;
+
+    for(i = 0; (i < plan->count) && (status == EBH_UART_ERROR_ACK); i++) {
+        if(plan->segments[i] < EBH_ERASE_ADDR_24) {
+            status = ebh_erase_segment(plan->segments[i]);
+        } else {
+            status = ebh_erase_segment_32(plan->segments[i]);
+        }
+    }
+    if((status == EBH_UART_ERROR_ACK) && (plan->strategy == ebh_erase_mass)) {
+        status = ebh_mass_erase(device);
+    }
+    if(saved_us) {
+        *saved_us = (int32_t)(plan->naive_us - (ebh_time_us() - start));
+    }
+    return status;
+}
+
+uint8_t ebh_erase_blank_crc(void *context, uint32_t addr, uint16_t length) {
+    uint8_t erased[16];
+    uint16_t expected = 0xFFFF;
+    uint16_t crc = 0;
+    uint16_t chunk = 0;
+    uint16_t i = 0;
+    uint8_t status = 0;
+
+    (void)context;
+    memset(erased, 0xFF, sizeof(erased));
+    for(i = 0; i < length; i += chunk) {
+        chunk = length - i;
+        if(chunk > sizeof(erased)) {
+            chunk = sizeof(erased);
+        }
+        expected = ebh_crc_update(expected, erased, chunk);
+    }
+
+    if(addr < EBH_ERASE_ADDR_24) {
+        status = ebh_crc_check(addr, length, &crc);
+    } else {
+        status = ebh_crc_check_32(addr, length, &crc);
+    }
+    return (status == EBH_UART_ERROR_ACK) && (crc == expected);
+}
@@ -0,0 +1,83 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Max Groening
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef EMBEDDED_BOOTLOADER_ERASE_H_
+#define EMBEDDED_BOOTLOADER_ERASE_H_
+
+#include <stdint.h>
+#include "config.h"
+#include "plan.h"
+#include "part.h"
+#include "embedded_bootloader.h"
+
+/*
+ * Erase planner
+ *
+ * Decides how to erase the memory an image (address ranges as for plan.h) is written to on
+ * a part (part.h):
+ *  - ebh_erase_segments: one ERASE_SEGMENT per segment the image touches
+ *  - ebh_erase_mass:     MASS_ERASE for the memory it clears (main memory) and ERASE_SEGMENT
+ *                        for the other segments the image touches (info memory)
+ * Segments the `blank` callback reports as erased are left out. Memory without segment erase
+ * (RAM, FRAM) is written without erasing. Image bytes the BSL may not write fail the plan.
+ *
+ * The cost model counts the frame and response bytes on the line, the gap the current policy
+ * puts after the command and EBH_ERASE_SEGMENT_TIME or EBH_ERASE_MASS_TIME. The naive approach
+ * it is compared with erases every segment from the lowest to the highest image address.
+ *
+ * MASS_ERASE is sent last: MSP430 FRAM devices reboot on it and have to be unlocked again.
+ */
+
+typedef enum {ebh_erase_none, ebh_erase_segments, ebh_erase_mass} ebh_erase_strategy;
+
+// Returns 1 if the segment is known to be erased
+typedef uint8_t (*ebh_erase_blank)(void *context, uint32_t addr, uint16_t length);
+
+typedef struct {
+    uint8_t keep;           // 1: memory outside the image must survive, no MASS_ERASE
+    ebh_erase_blank blank;  // 0: no segment is known to be erased
+    void *context;
+} ebh_erase_options;
+
+typedef struct {
+    ebh_erase_strategy strategy;
+    uint32_t *segments;     // ERASE_SEGMENT addresses to send
+    uint16_t max_segments;
+    uint16_t count;
+    uint16_t blank;         // Segments of the image left out as erased
+    uint32_t time_us;       // Predicted time of the plan
+    uint32_t naive_us;      // Predicted time of the naive approach
+} ebh_erase_plan;
+
+uint32_t ebh_erase_segment_time(uint32_t addr);  // Predicted us of one ERASE_SEGMENT
+uint32_t ebh_erase_mass_time(void);
+
+uint8_t ebh_erase_make(ebh_erase_plan *plan, const ebh_range *ranges, uint16_t range_count, const ebh_part *part,
+                       const ebh_erase_options *options, uint32_t *segments, uint16_t max_segments);
+uint8_t ebh_erase_run(const ebh_erase_plan *plan, ebh_device device, int32_t *saved_us);  // Measured time saved against naive_us
+
+uint8_t ebh_erase_blank_crc(void *context, uint32_t addr, uint16_t length);  // Asks the target with CRC_CHECK, context unused
+
+#endif /* EMBEDDED_BOOTLOADER_ERASE_H_ */
@@ -0,0 +1,189 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Max Groening
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <stdint.h>
+#include "config.h"
+#include "gap.h"
+#include "embedded_bootloader.h"
+#include "embedded_bootloader/bootloader_protocol.h"
+
+#define EBH_GAP_DEVICES  3
+#define EBH_GAP_SLOTS    16  // Command & 0x0F, 16 and 32 bit variants share a slot
+
+static ebh_gap_mode ebh_gap_current = EBH_GAP_POLICY;
+static ebh_device ebh_gap_device = ebh_device_msp430_flash;
+static uint16_t ebh_gap_table[EBH_GAP_DEVICES][EBH_GAP_SLOTS];
+static uint16_t ebh_gap_known[EBH_GAP_DEVICES];  // One bit per slot
+static uint16_t ebh_gap_pending = 0;
+static uint8_t ebh_gap_unanswered = 0;  // The pending gap falls away with the core response
+
+/* Commands the calibration cannot repeat safely, they take the longest calibrated gap */
+static const uint8_t ebh_gap_derived[] = {
+    EBH_CMD_RX_DATA_BLOCK, EBH_CMD_RX_PASSWORD, EBH_CMD_ERASE_SEGMENT, EBH_CMD_UNLOCK_AND_LOCK_INFO,
+    EBH_CMD_MASS_ERASE, EBH_CMD_TX_DATA_BLOCK
+};
+
+static uint8_t ebh_gap_always_fixed(uint8_t cmd) {
+    return (cmd == EBH_CMD_CHANGE_BAUD_RATE) || (cmd == EBH_CMD_LOAD_PC) || (cmd == EBH_CMD_LOAD_PC_32) ||
+           (cmd == EBH_CMD_REBOOT_RESET) || (cmd == EBH_CMD_FACTORY_RESET) || (cmd == EBH_SYNC_CHARACTER);
+}
+
+void ebh_gap_set_policy(ebh_gap_mode mode, ebh_device device) {
+    ebh_gap_current = mode;
+    ebh_gap_device = device;
+}
+
+uint16_t ebh_gap_get(ebh_device device, uint8_t cmd) {
+    if(ebh_gap_always_fixed(cmd) || !(ebh_gap_known[device] & (1u << (cmd & 0x0F)))) {
+        return EBH_DELAY_BETWEEN_COMMANDS;
+    }
+    return ebh_gap_table[device][cmd & 0x0F];
+}
+
+void ebh_gap_learn(ebh_device device, uint8_t cmd, uint16_t gap) {
+    ebh_gap_table[device][cmd & 0x0F] = gap;
+    ebh_gap_known[device] |= 1u << (cmd & 0x0F);
+}
+
+uint16_t ebh_gap_after(uint8_t cmd) {
+    if((ebh_gap_current == ebh_gap_fixed) || ebh_gap_always_fixed(cmd)) {
+        return EBH_DELAY_BETWEEN_COMMANDS;
+    } else if((ebh_gap_current == ebh_gap_after_response) || (cmd == EBH_CMD_RX_DATA_BLOCK_FAST)) {
+        return 0;
+    }
+    return ebh_gap_get(ebh_gap_device, cmd);
+}
+
+void ebh_gap_command(uint8_t cmd) {
+    ebh_gap_pending = ebh_gap_after(cmd);
+    ebh_gap_unanswered = 0;
+
+    // Until the core response arrives the target may still be busy, e.g. after a timeout or NAK
+    if((ebh_gap_current == ebh_gap_after_response) && !ebh_gap_always_fixed(cmd) && (cmd != EBH_CMD_RX_DATA_BLOCK_FAST)) {
+        ebh_gap_pending = EBH_DELAY_BETWEEN_COMMANDS;
+        ebh_gap_unanswered = 1;
+    }
+}
+
+void ebh_gap_response(void) {
+    if(ebh_gap_unanswered) {
+        ebh_gap_pending = 0;
+        ebh_gap_unanswered = 0;
+    }
+}
+
+void ebh_gap_wait(void) {
+    if(ebh_gap_pending) {
+        ebh_delay_us(ebh_gap_pending);
+        ebh_gap_pending = 0;
+    }
+    ebh_gap_unanswered = 0;
+}
+
+static uint8_t ebh_gap_run(ebh_device device, uint8_t cmd, uint32_t addr) {
+    uint8_t version[11];
+    uint16_t value = 0;
+
+    switch(cmd) {
+    case EBH_CMD_TX_BSL_VERSION:
+        return ebh_tx_bsl_version(device, version);
+    case EBH_CMD_TX_BUFFER_SIZE:
+        return ebh_tx_buffer_size(&value);
+    default:
+        return (device == ebh_device_msp432) ? ebh_crc_check_32(addr, 16, &value) : ebh_crc_check(addr, 16, &value);
+    }
+}
+
+/* Any core response counts, e.g. BSL locked. Line errors and timeouts fail the gap. */
+static uint8_t ebh_gap_trial(ebh_device device, uint8_t cmd, uint32_t addr, uint16_t gap) {
+    uint8_t status = 0;
+    uint8_t i = 0;
+
+    ebh_gap_learn(device, cmd, gap);
+    ebh_gap_wait();
+    ebh_delay_us(gap);  // The command in front may have been another one
+    for(i = 0; i < EBH_GAP_TRIALS; i++) {
+        status = ebh_gap_run(device, cmd, addr);
+        if(status >= EBH_UART_ERROR_HEADER_INCORRECT) {
+            ebh_resync();  // A lost header byte may leave a frame started in the middle
+            return status;
+        }
+    }
+    return EBH_UART_ERROR_ACK;
+}
+
+uint8_t ebh_gap_calibrate(ebh_device device, uint32_t addr) {
+    static const uint8_t commands[] = {EBH_CMD_TX_BSL_VERSION, EBH_CMD_CRC_CHECK, EBH_CMD_TX_BUFFER_SIZE};
+    ebh_gap_mode mode = ebh_gap_current;
+    ebh_device mode_device = ebh_gap_device;
+    uint8_t status = EBH_UART_ERROR_ACK;
+    uint16_t longest = 0;
+    uint16_t lo = 0;
+    uint16_t hi = 0;
+    uint16_t mid = 0;
+    uint8_t i = 0;
+
+    ebh_gap_set_policy(ebh_gap_learned, device);
+
+    for(i = 0; (i < sizeof(commands)) && (status == EBH_UART_ERROR_ACK); i++) {
+        if((commands[i] == EBH_CMD_TX_BUFFER_SIZE) && (device == ebh_device_msp432)) {
+            continue;
+        }
+
+        // Binary search between no gap and the fixed one
+        lo = 0;
+        hi = EBH_DELAY_BETWEEN_COMMANDS;
+        status = ebh_gap_trial(device, commands[i], addr, hi);
+        if((status == EBH_UART_ERROR_ACK) && (ebh_gap_trial(device, commands[i], addr, 0) == EBH_UART_ERROR_ACK)) {
+            hi = 0;
+        }
+        while((status == EBH_UART_ERROR_ACK) && (hi - lo > EBH_GAP_RESOLUTION)) {
+            mid = lo + (hi - lo) / 2;
+            if(ebh_gap_trial(device, commands[i], addr, mid) == EBH_UART_ERROR_ACK) {
+                hi = mid;
+            } else {
+                lo = mid;
+            }
+        }
+
+        hi = (hi + EBH_GAP_MARGIN < EBH_DELAY_BETWEEN_COMMANDS) ? hi + EBH_GAP_MARGIN : EBH_DELAY_BETWEEN_COMMANDS;
+        ebh_gap_learn(device, commands[i], hi);
+        if(hi > longest) {
+            longest = hi;
+        }
+    }
+
+    if(status == EBH_UART_ERROR_ACK) {
+        for(i = 0; i < sizeof(ebh_gap_derived); i++) {
+            ebh_gap_learn(device, ebh_gap_derived[i], longest);
+        }
+    } else {
+        ebh_gap_known[device] = 0;
+    }
+
+    ebh_gap_set_policy(mode, mode_device);
+    ebh_delay_us(EBH_DELAY_BETWEEN_COMMANDS);
+    return status;
+}
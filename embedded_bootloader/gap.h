@@ -0,0 +1,67 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Max Groening
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef EMBEDDED_BOOTLOADER_GAP_H_
+#define EMBEDDED_BOOTLOADER_GAP_H_
+
+#include <stdint.h>
+#include "config.h"
+#include "embedded_bootloader.h"
+
+/*
+ * Gap between BSL commands
+ *
+ * The protocol layer arms the gap of every command it sends and waits for it before the
+ * next frame, ebh_delay_between_commands() waits for it right away.
+ *
+ * ebh_gap_fixed:           EBH_DELAY_BETWEEN_COMMANDS after every command (default)
+ * ebh_gap_after_response:  no gap once a complete core response proved the target idle again,
+ *                          the fixed one after a timeout, NAK or resync
+ * ebh_gap_learned:         shortest gap per command and device family, see ebh_gap_calibrate()
+ *
+ * Commands without a core response (CHANGE_BAUD_RATE, LOAD_PC, REBOOT_RESET, the sync
+ * character) and FACTORY_RESET always get the fixed gap. RX_DATA_BLOCK_FAST frames follow
+ * each other without a gap unless the policy is fixed.
+ */
+
+typedef enum {ebh_gap_fixed, ebh_gap_after_response, ebh_gap_learned} ebh_gap_mode;
+
+void ebh_gap_set_policy(ebh_gap_mode mode, ebh_device device);  // Default: EBH_GAP_POLICY
+uint16_t ebh_gap_get(ebh_device device, uint8_t cmd);  // Learned gap in us
+void ebh_gap_learn(ebh_device device, uint8_t cmd, uint16_t gap);
+uint16_t ebh_gap_after(uint8_t cmd);  // Gap in us the current policy puts after the command once it is answered
+
+/*
+ * ebh_gap_calibrate() searches the shortest gap after which EBH_GAP_TRIALS commands in a row
+ * are answered, for TX_BSL_VERSION, CRC_CHECK(_32) at addr and TX_BUFFER_SIZE (MSP430).
+ * The other commands with a core response learn the longest of those. Works on a locked BSL.
+ */
+uint8_t ebh_gap_calibrate(ebh_device device, uint32_t addr);
+
+void ebh_gap_command(uint8_t cmd);  // Called by the protocol layer for every command sent
+void ebh_gap_response(void);  // ... and for every complete core response
+void ebh_gap_wait(void);
+
+#endif /* EMBEDDED_BOOTLOADER_GAP_H_ */
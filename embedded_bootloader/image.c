@@ -0,0 +1,350 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Max Groening
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <stdint.h>
+#include <string.h>
+#include "config.h"
+#include "image.h"
+#include "embedded_bootloader.h"
+#include "embedded_bootloader/bootloader_protocol.h"
+
+#define EBH_IMAGE_START     0  // Nothing but white space so far
+#define EBH_IMAGE_HEX_IDLE  1
+#define EBH_IMAGE_HEX_DATA  2
+#define EBH_IMAGE_TXT_IDLE  3
+#define EBH_IMAGE_TXT_ADDR  4
+#define EBH_IMAGE_TXT_BYTE  5
+#define EBH_IMAGE_TXT_SEP   6  // A byte has to be followed by white space
+#define EBH_IMAGE_DONE      7
+
+static uint8_t ebh_image_digit(uint8_t character) {
+    if((uint8_t)(character - '0') <= 9) {
+        return character - '0';
+    }
+    character |= 0x20;
+    if((uint8_t)(character - 'a') <= 5) {
+        return character - 'a' + 10;
+    }
+    return 0xFF;
+}
+
+static uint8_t ebh_image_space(ebh_image_parser *parser, uint8_t character) {
+    if(character == '\n') {
+        parser->line++;
+        return 1;
+    }
+    return (character == ' ') || (character == '\r') || (character == '\t');
+}
+
+static uint8_t ebh_image_pass(ebh_image_parser *parser, uint32_t addr, const uint8_t *data, uint16_t length) {
+    uint8_t status = parser->sink(parser->context, addr, data, length);
+    return status ? status : EBH_PARSER_IN_PROGRESS;
+}
+
+/* HEX: checks and executes a complete record */
+static uint8_t ebh_image_hex_record(ebh_image_parser *parser) {
+    const uint8_t *record = parser->record;
+    uint16_t offset = ((uint16_t)record[1] << 8) | record[2];
+    uint16_t value = ((uint16_t)record[4] << 8) | record[5];
+
+    if(parser->checksum != 0) {
+        return EBH_UART_ERROR_IMAGE_CHECKSUM;
+    }
+    parser->state = EBH_IMAGE_HEX_IDLE;
+
+    switch(record[3]) {
+    case 0x00:
+        return record[0] ? ebh_image_pass(parser, parser->base + offset, &record[4], record[0]) : EBH_PARSER_IN_PROGRESS;
+    case 0x01:
+        parser->state = EBH_IMAGE_DONE;
+        return (record[0] == 0) ? EBH_UART_ERROR_ACK : EBH_UART_ERROR_IMAGE_RECORD;
+    case 0x02:
+        parser->base = (uint32_t)value << 4;
+        return (record[0] == 2) ? EBH_PARSER_IN_PROGRESS : EBH_UART_ERROR_IMAGE_RECORD;
+    case 0x04:
+        parser->base = (uint32_t)value << 16;
+        return (record[0] == 2) ? EBH_PARSER_IN_PROGRESS : EBH_UART_ERROR_IMAGE_RECORD;
+    case 0x03:
+    case 0x05:
+        return EBH_PARSER_IN_PROGRESS;  // Start address, the BSL is started with LOAD_PC
+    default:
+        return EBH_UART_ERROR_IMAGE_RECORD;
+    }
+}
+
+/* TI-TXT: passes on the bytes collected since the last address */
+static uint8_t ebh_image_txt_flush(ebh_image_parser *parser) {
+    uint16_t length = parser->index;
+
+    if(length == 0) {
+        return EBH_PARSER_IN_PROGRESS;
+    }
+    parser->index = 0;
+    parser->base += length;
+    return ebh_image_pass(parser, parser->base - length, parser->record, length);
+}
+
+static uint8_t ebh_image_char(ebh_image_parser *parser, uint8_t character) {
+    uint8_t digit = ebh_image_digit(character);
+
+    switch(parser->state) {
+    case EBH_IMAGE_HEX_DATA:
+        if(digit > 0x0F) {
+            return EBH_UART_ERROR_IMAGE_SYNTAX;  // Includes a line ending inside the record
+        }
+        if(parser->digits == 0) {
+            parser->high = digit;
+            parser->digits = 1;
+            return EBH_PARSER_IN_PROGRESS;
+        }
+        parser->digits = 0;
+        digit |= parser->high << 4;
+        parser->record[parser->index++] = digit;
+        parser->checksum += digit;
+        // Length, address (2), type, data, checksum
+        if((parser->index > 4) && (parser->index == parser->record[0] + 5u)) {
+            return ebh_image_hex_record(parser);
+        }
+        return EBH_PARSER_IN_PROGRESS;
+
+    case EBH_IMAGE_TXT_BYTE:
+        if(digit > 0x0F) {
+            return EBH_UART_ERROR_IMAGE_SYNTAX;
+        }
+        parser->record[parser->index++] = (parser->high << 4) | digit;
+        parser->state = EBH_IMAGE_TXT_SEP;
+        return (parser->index == sizeof(parser->record)) ? ebh_image_txt_flush(parser) : EBH_PARSER_IN_PROGRESS;
+
+    case EBH_IMAGE_TXT_SEP:
+        if(!ebh_image_space(parser, character)) {
+            return EBH_UART_ERROR_IMAGE_SYNTAX;
+        }
+        parser->state = EBH_IMAGE_TXT_IDLE;
+        return EBH_PARSER_IN_PROGRESS;
+
+    case EBH_IMAGE_TXT_IDLE:
+        if(digit <= 0x0F) {
+            parser->high = digit;
+            parser->state = EBH_IMAGE_TXT_BYTE;
+            return EBH_PARSER_IN_PROGRESS;
+        }
+        if(ebh_image_space(parser, character)) {
+            return EBH_PARSER_IN_PROGRESS;
+        }
+        if(character == '@') {
+            parser->state = EBH_IMAGE_TXT_ADDR;
+            parser->digits = 0;
+            return ebh_image_txt_flush(parser);
+        }
+        if((character == 'q') || (character == 'Q')) {
+            parser->state = EBH_IMAGE_DONE;
+            digit = ebh_image_txt_flush(parser);
+            return (digit == EBH_PARSER_IN_PROGRESS) ? EBH_UART_ERROR_ACK : digit;
+        }
+        return EBH_UART_ERROR_IMAGE_SYNTAX;
+
+    case EBH_IMAGE_TXT_ADDR:
+        if(digit <= 0x0F) {
+            if(parser->digits == 0) {
+                parser->base = 0;
+            }
+            if(++parser->digits > 8) {
+                return EBH_UART_ERROR_IMAGE_SYNTAX;
+            }
+            parser->base = (parser->base << 4) | digit;
+            return EBH_PARSER_IN_PROGRESS;
+        }
+        if((parser->digits == 0) || !ebh_image_space(parser, character)) {
+            return EBH_UART_ERROR_IMAGE_SYNTAX;
+        }
+        parser->state = EBH_IMAGE_TXT_IDLE;
+        return EBH_PARSER_IN_PROGRESS;
+
+    case EBH_IMAGE_START:
+    case EBH_IMAGE_HEX_IDLE:
+        if(ebh_image_space(parser, character)) {
+            return EBH_PARSER_IN_PROGRESS;
+        }
+        if((character == ':') && (parser->format != ebh_image_ti_txt)) {
+            parser->format = ebh_image_intel_hex;
+            parser->state = EBH_IMAGE_HEX_DATA;
+            parser->index = 0;
+            parser->digits = 0;
+            parser->checksum = 0;
+            return EBH_PARSER_IN_PROGRESS;
+        }
+        if((character == '@') && (parser->state == EBH_IMAGE_START) && (parser->format != ebh_image_intel_hex)) {
+            parser->format = ebh_image_ti_txt;
+            parser->state = EBH_IMAGE_TXT_ADDR;
+            parser->digits = 0;
+            return EBH_PARSER_IN_PROGRESS;
+        }
+        return EBH_UART_ERROR_IMAGE_SYNTAX;
+
+    default:
+        return EBH_UART_ERROR_ACK;  // Anything after the end of the image is ignored
+    }
+}
+
+void ebh_image_init(ebh_image_parser *parser, ebh_image_format format, ebh_sink sink, void *context) {
+    parser->sink = sink;
+    parser->context = context;
+    parser->format = format;
+    parser->state = EBH_IMAGE_START;
+    parser->status = EBH_PARSER_IN_PROGRESS;
+    parser->high = 0;
+    parser->digits = 0;
+    parser->index = 0;
+    parser->checksum = 0;
+    parser->base = 0;
+    parser->line = 1;
+}
+
+uint8_t ebh_image_feed(ebh_image_parser *parser, const uint8_t *data, uint16_t length) {
+    uint8_t status = parser->status;
+
+    while((length > 0) && (status == EBH_PARSER_IN_PROGRESS)) {
+        status = ebh_image_char(parser, *data++);
+        length--;
+    }
+    parser->status = status;
+    return status;
+}
+
+uint8_t ebh_image_finish(ebh_image_parser *parser) {
+    if(parser->status != EBH_PARSER_IN_PROGRESS) {
+        return parser->status;
+    }
+
+    // TI-TXT may end without "q", a HEX file needs its end of file record
+    if((parser->state == EBH_IMAGE_TXT_IDLE) || (parser->state == EBH_IMAGE_TXT_SEP)) {
+        parser->status = ebh_image_txt_flush(parser);
+        if(parser->status == EBH_PARSER_IN_PROGRESS) {
+            parser->status = EBH_UART_ERROR_ACK;
+        }
+    } else {
+        parser->status = EBH_UART_ERROR_SOURCE_ENDED;
+    }
+    parser->state = EBH_IMAGE_DONE;
+    return parser->status;
+}
+
+uint8_t ebh_image_load(ebh_image_parser *parser, ebh_source source, void *context) {
+    uint8_t buffer[EBH_IMAGE_READ_SIZE];
+    uint8_t status = parser->status;
+    uint16_t length = 0;
+
+    while(status == EBH_PARSER_IN_PROGRESS) {
+        length = source(context, buffer, sizeof(buffer));
+        if(length == 0) {
+            return ebh_image_finish(parser);
+        }
+        status = ebh_image_feed(parser, buffer, length);
+    }
+    return status;
+}
+
+void ebh_image_writer_init(ebh_image_writer *writer, uint16_t block, ebh_sink write, void *context) {
+    writer->write = write;
+    writer->context = context;
+    writer->block = (block > sizeof(writer->data)) ? sizeof(writer->data) : block;
+    writer->size = 0;
+    writer->length = 0;
+    writer->addr = 0;
+    writer->blocks = 0;
+    writer->bytes = 0;
+}
+
+uint8_t ebh_image_writer_flush(ebh_image_writer *writer) {
+    uint8_t status = 0;
+
+    if(writer->length == 0) {
+        return 0;
+    }
+    if(writer->write) {
+        status = writer->write(writer->context, writer->addr, writer->data, writer->length);
+    } else {
+        status = ebh_write_region(writer->addr, writer->data, writer->length);
+    }
+    writer->blocks++;
+    writer->bytes += writer->length;
+    writer->addr += writer->length;
+    writer->length = 0;
+    return status;
+}
+
+uint8_t ebh_image_writer_sink(void *context, uint32_t addr, const uint8_t *data, uint16_t length) {
+    ebh_image_writer *writer = (ebh_image_writer *)context;
+    uint16_t chunk = 0;
+    uint8_t status = 0;
+
+    while(length > 0) {
+        if((writer->length > 0) && (addr != writer->addr + writer->length)) {
+            status = ebh_image_writer_flush(writer);
+            if(status) {
+                return status;
+            }
+        }
+        if(writer->length == 0) {
+            writer->addr = addr;
+            writer->size = writer->block ? writer->block : ebh_write_block_size(addr);
+            if(writer->size > sizeof(writer->data)) {
+                writer->size = sizeof(writer->data);
+            }
+        }
+
+        chunk = writer->size - writer->length;
+        if(chunk > length) {
+            chunk = length;
+        }
+        memcpy(&writer->data[writer->length], data, chunk);
+        writer->length += chunk;
+        addr += chunk;
+        data += chunk;
+        length -= chunk;
+
+        if(writer->length == writer->size) {
+            status = ebh_image_writer_flush(writer);
+            if(status) {
+                return status;
+            }
+        }
+    }
+    return 0;
+}
+
+uint8_t ebh_image_write(ebh_image_format format, ebh_source source, void *context) {
+    static ebh_image_parser parser;
+    static ebh_image_writer writer;
+    uint8_t status = 0;
+
+    ebh_image_writer_init(&writer, 0, 0, 0);
+    ebh_image_init(&parser, format, ebh_image_writer_sink, &writer);
+    status = ebh_image_load(&parser, source, context);
+    if(status == EBH_UART_ERROR_ACK) {
+        status = ebh_image_writer_flush(&writer);
+    }
+    return status;
+}
@@ -0,0 +1,96 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Max Groening
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef EMBEDDED_BOOTLOADER_IMAGE_H_
+#define EMBEDDED_BOOTLOADER_IMAGE_H_
+
+#include <stdint.h>
+#include "config.h"
+#include "embedded_bootloader.h"
+
+/*
+ * Image file parsers (Intel HEX and TI-TXT)
+ *
+ * Incremental state machines with a fixed size state, fed with pieces of any size (e.g.
+ * straight from a UART or a file). The decoded data goes to an ebh_sink in address order
+ * of the file, a sink return value other than 0 aborts parsing and is returned.
+ * Return values are EBH_PARSER_IN_PROGRESS until the end of the image (HEX end of file
+ * record, TI-TXT "q"), then EBH_UART_ERROR_ACK or an EBH_UART_ERROR_IMAGE_* code.
+ *
+ * Intel HEX: data, end of file, extended segment and extended linear address records,
+ * the start address records are skipped. Every record is checked before its data is passed on.
+ * TI-TXT: "@ADDR" lines followed by bytes separated by white space, "q" ends the file.
+ */
+
+typedef enum {ebh_image_auto, ebh_image_intel_hex, ebh_image_ti_txt} ebh_image_format;  // Auto: ':' or '@' at the start
+
+typedef struct {
+    ebh_sink sink;
+    void *context;
+    ebh_image_format format;
+    uint8_t state;
+    uint8_t status;
+    uint8_t high;         // First hex digit of the current byte
+    uint8_t digits;       // Hex digits of the current field
+    uint16_t index;       // Bytes in record
+    uint8_t checksum;
+    uint32_t base;        // HEX: extended address, TI-TXT: address of record[0]
+    uint32_t line;        // Current line, for error messages
+    uint8_t record[260];  // HEX: the record being decoded, TI-TXT: bytes not passed on yet
+} ebh_image_parser;
+
+void ebh_image_init(ebh_image_parser *parser, ebh_image_format format, ebh_sink sink, void *context);
+uint8_t ebh_image_feed(ebh_image_parser *parser, const uint8_t *data, uint16_t length);
+uint8_t ebh_image_finish(ebh_image_parser *parser);  // End of input: passes on the rest, EBH_UART_ERROR_SOURCE_ENDED inside a record
+uint8_t ebh_image_load(ebh_image_parser *parser, ebh_source source, void *context);  // Feeds and finishes from a pull source
+
+/*
+ * Image writer
+ *
+ * An ebh_sink that merges contiguous pieces (e.g. the 16 byte records of a HEX file) into
+ * full data blocks before they are written. A block size of 0 uses the buffer size of the
+ * target (ebh_write_block_size()), a write function of 0 writes with ebh_write_region().
+ */
+
+typedef struct {
+    ebh_sink write;
+    void *context;
+    uint16_t block;
+    uint16_t size;        // Of the current run
+    uint16_t length;
+    uint32_t addr;
+    uint32_t blocks;      // Handed to write
+    uint32_t bytes;
+    uint8_t data[EBH_MAX_BUFFER_SIZE];
+} ebh_image_writer;
+
+void ebh_image_writer_init(ebh_image_writer *writer, uint16_t block, ebh_sink write, void *context);
+uint8_t ebh_image_writer_sink(void *context, uint32_t addr, const uint8_t *data, uint16_t length);  // Context: the writer
+uint8_t ebh_image_writer_flush(ebh_image_writer *writer);
+
+/* ebh_image_write() parses a whole image from `source` and writes it to the target. */
+uint8_t ebh_image_write(ebh_image_format format, ebh_source source, void *context);
+
+#endif /* EMBEDDED_BOOTLOADER_IMAGE_H_ */
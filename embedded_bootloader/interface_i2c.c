@@ -0,0 +1,139 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Max Groening
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <stdint.h>
+#include "config.h"
+#include "transport.h"
+#include "timing.h"
+#include "devices/devices.h"
+#include "embedded_bootloader/bootloader_protocol.h"
+
+
+/*
+ * I2C transport
+ *
+ * A frame is written in one I2C write transaction, built from the same segments as for
+ * UART. The answer is fetched with read transactions: while the target is busy it does
+ * not acknowledge its address (or stretches the clock), so the host polls every
+ * EBH_I2C_POLL_INTERVAL us within the caller's timeout. The first byte read is the ACK,
+ * a core response is read as header and length first, then core data and checksum.
+ */
+
+static uint8_t ebh_i2c_rx[EBH_MAX_RESPONSE_FRAME_SIZE];
+static uint16_t ebh_i2c_rx_length = 0;
+static uint16_t ebh_i2c_rx_index = 0;
+static uint8_t ebh_i2c_expect_ack = 0;
+
+/* Tries to read the next answer, returns EBH_I2C_NACK while the target is busy */
+static uint8_t ebh_i2c_poll(void) {
+    uint8_t status = EBH_I2C_OK;
+    uint16_t length = 0;
+
+    if(ebh_i2c_expect_ack) {
+        status = ebh_i2c_read(EBH_I2C_ADDRESS, ebh_i2c_rx, 1);
+        if(status == EBH_I2C_OK) {
+            ebh_i2c_expect_ack = 0;
+            ebh_i2c_rx_length = 1;
+            ebh_i2c_rx_index = 0;
+        }
+        return status;
+    }
+
+    status = ebh_i2c_read(EBH_I2C_ADDRESS, ebh_i2c_rx, 3);
+    if(status != EBH_I2C_OK) {
+        return status;
+    }
+    ebh_i2c_rx_length = 3;
+    ebh_i2c_rx_index = 0;
+
+    // Anything else than a valid header is left to the response parser
+    length = ebh_i2c_rx[1] | (ebh_i2c_rx[2] << 8);
+    if((ebh_i2c_rx[0] == EBH_HEADER) && (length > 0) && (length <= EBH_MAX_RESPONSE_SIZE)) {
+        if(ebh_i2c_read(EBH_I2C_ADDRESS, &ebh_i2c_rx[3], length + 2) == EBH_I2C_OK) {
+            ebh_i2c_rx_length += length + 2;
+        }
+    }
+    return EBH_I2C_OK;
+}
+
+static void ebh_i2c_send(void *context, const ebh_iovec *iov, uint8_t count) {
+    ebh_i2c_rx_length = 0;
+    ebh_i2c_rx_index = 0;
+    ebh_i2c_expect_ack = 1;
+
+    // A frame that is not acknowledged is not answered either, the receive side times out
+    ebh_i2c_write(EBH_I2C_ADDRESS, iov, count);
+}
+
+static uint8_t ebh_i2c_wait_readable(void *context, uint32_t timeout_us) {
+    ebh_deadline deadline = ebh_deadline_in(timeout_us);
+    uint8_t status = EBH_I2C_OK;
+
+    while(ebh_i2c_rx_index == ebh_i2c_rx_length) {
+        status = ebh_i2c_poll();
+        if(status == EBH_I2C_OK) {
+            break;
+        }
+        if((timeout_us != EBH_TIMEOUT_INFINITE) && ebh_deadline_expired(deadline)) {
+            return 0;
+        }
+        ebh_delay_us(EBH_I2C_POLL_INTERVAL);
+    }
+    return 1;
+}
+
+static uint16_t ebh_i2c_receive(void *context, uint8_t *data, uint16_t length, uint32_t timeout_us) {
+    uint16_t received = 0;
+
+    while(received < length) {
+        if((ebh_i2c_rx_index == ebh_i2c_rx_length) && !ebh_i2c_wait_readable(context, timeout_us)) {
+            break;
+        }
+        while((received < length) && (ebh_i2c_rx_index < ebh_i2c_rx_length)) {
+            data[received++] = ebh_i2c_rx[ebh_i2c_rx_index++];
+        }
+    }
+    return received;
+}
+
+static void ebh_i2c_flush(void *context) {
+    ebh_i2c_rx_length = 0;
+    ebh_i2c_rx_index = 0;
+}
+
+static uint8_t ebh_i2c_set_baud(void *context, uint32_t baud) {
+    ebh_i2c_configure(baud);
+    return 0;
+}
+
+const ebh_transport ebh_transport_i2c = {
+    ebh_i2c_send,
+    ebh_i2c_receive,
+    ebh_i2c_wait_readable,
+    ebh_i2c_flush,
+    ebh_i2c_set_baud,
+    0,
+    0
+};
@@ -0,0 +1,141 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Max Groening
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <stdint.h>
+#include "config.h"
+#include "transport.h"
+#include "timing.h"
+#include "devices/devices.h"
+#include "embedded_bootloader/bootloader_protocol.h"
+
+
+/*
+ * SPI transport
+ *
+ * The host is the SPI master, so the target can only answer while the host clocks.
+ * Frames are sent as for UART. Afterwards the host polls with dummy bytes: the target
+ * returns 0xFF until its answer is ready (turnaround). The first other byte is the ACK,
+ * a core response is read as a whole once its header and length arrived, so 0xFF inside
+ * a response is data and not fill.
+ */
+
+#define EBH_SPI_FILL  0xFF  // MISO level while the target has nothing to send
+
+static uint8_t ebh_spi_rx[EBH_MAX_RESPONSE_FRAME_SIZE];
+static uint16_t ebh_spi_rx_length = 0;
+static uint16_t ebh_spi_rx_index = 0;
+static uint8_t ebh_spi_expect_ack = 0;
+
+/* Clocks one dummy byte, reads the complete answer if the target started one */
+static uint8_t ebh_spi_poll(void) {
+    uint8_t character = EBH_SPI_FILL;
+    uint16_t length = 0;
+
+    ebh_spi_select(1);
+    ebh_spi_transfer(0, &character, 1);
+    if(character != EBH_SPI_FILL) {
+        ebh_spi_rx[0] = character;
+        ebh_spi_rx_length = 1;
+        ebh_spi_rx_index = 0;
+
+        if(ebh_spi_expect_ack) {
+            ebh_spi_expect_ack = 0;
+        } else if(character == EBH_HEADER) {
+            ebh_spi_transfer(0, &ebh_spi_rx[1], 2);
+            length = ebh_spi_rx[1] | (ebh_spi_rx[2] << 8);
+            ebh_spi_rx_length = 3;
+
+            // An invalid length is left to the response parser
+            if((length > 0) && (length <= EBH_MAX_RESPONSE_SIZE)) {
+                ebh_spi_transfer(0, &ebh_spi_rx[3], length + 2);
+                ebh_spi_rx_length += length + 2;
+            }
+        }
+    }
+    ebh_spi_select(0);
+    return (character != EBH_SPI_FILL) ? 1 : 0;
+}
+
+static void ebh_spi_send(void *context, const ebh_iovec *iov, uint8_t count) {
+    ebh_spi_rx_length = 0;
+    ebh_spi_rx_index = 0;
+    ebh_spi_expect_ack = 1;
+
+    ebh_spi_select(1);
+    while(count--) {
+        ebh_spi_transfer(iov->data, 0, iov->length);
+        iov++;
+    }
+    ebh_spi_select(0);
+}
+
+static uint8_t ebh_spi_wait_readable(void *context, uint32_t timeout_us) {
+    ebh_deadline deadline = ebh_deadline_in(timeout_us);
+
+    while(ebh_spi_rx_index == ebh_spi_rx_length) {
+        if(ebh_spi_poll()) {
+            break;
+        }
+        if((timeout_us != EBH_TIMEOUT_INFINITE) && ebh_deadline_expired(deadline)) {
+            return 0;
+        }
+        ebh_delay_us(EBH_SPI_POLL_INTERVAL);
+    }
+    return 1;
+}
+
+static uint16_t ebh_spi_receive(void *context, uint8_t *data, uint16_t length, uint32_t timeout_us) {
+    uint16_t received = 0;
+
+    while(received < length) {
+        if((ebh_spi_rx_index == ebh_spi_rx_length) && !ebh_spi_wait_readable(context, timeout_us)) {
+            break;
+        }
+        while((received < length) && (ebh_spi_rx_index < ebh_spi_rx_length)) {
+            data[received++] = ebh_spi_rx[ebh_spi_rx_index++];
+        }
+    }
+    return received;
+}
+
+static void ebh_spi_flush(void *context) {
+    ebh_spi_rx_length = 0;
+    ebh_spi_rx_index = 0;
+}
+
+static uint8_t ebh_spi_set_baud(void *context, uint32_t baud) {
+    ebh_spi_configure(baud);
+    return 0;
+}
+
+const ebh_transport ebh_transport_spi = {
+    ebh_spi_send,
+    ebh_spi_receive,
+    ebh_spi_wait_readable,
+    ebh_spi_flush,
+    ebh_spi_set_baud,
+    0,
+    0
+};
@@ -0,0 +1,223 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Max Groening
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <stdint.h>
+#include <string.h>
+#include "config.h"
+#include "transport.h"
+#include "timing.h"
+#include "devices/devices.h"
+#include "embedded_bootloader/bootloader_protocol.h"
+
+
+/*
+ * UART (DMA) transport
+ *
+ * TX: send() gathers the frame into one of two staging buffers and hands it to the DMA.
+ * While the DMA transmits one buffer, the next frame is built in the other one, send()
+ * only waits if the previous frame is still in flight.
+ * RX: the DMA runs continuously into a circular buffer, the completion callback restarts
+ * it. The write position is derived from the number of completed passes and the bytes
+ * the running transfer still waits for.
+ */
+
+static uint8_t ebh_uart_dma_tx_buffer[2][EBH_MAX_FRAME_SIZE];
+static uint8_t ebh_uart_dma_tx_index = 0;
+static volatile uint8_t ebh_uart_dma_tx_active = 0;
+static void (*volatile ebh_uart_dma_tx_hook)(void) = 0;
+
+static uint8_t ebh_uart_dma_rx_buffer[EBH_UART_DMA_RX_SIZE];
+static volatile uint32_t ebh_uart_dma_rx_passes = 0;
+static uint32_t ebh_uart_dma_rx_read = 0;
+static uint16_t ebh_uart_dma_overruns = 0;
+
+static void ebh_uart_dma_tx_done(void) {
+    void (*hook)(void) = ebh_uart_dma_tx_hook;
+
+    ebh_uart_dma_tx_active = 0;
+    if(hook) {
+        hook();
+    }
+}
+
+static void ebh_uart_dma_rx_done(void) {
+    ebh_uart_dma_rx_passes++;
+    ebh_uart_dma_rx_start(ebh_uart_dma_rx_buffer, sizeof(ebh_uart_dma_rx_buffer));
+}
+
+void ebh_uart_dma_start(void) {
+    ebh_uart_dma_tx_index = 0;
+    ebh_uart_dma_tx_active = 0;
+    ebh_uart_dma_rx_passes = 0;
+    ebh_uart_dma_rx_read = 0;
+    ebh_uart_dma_overruns = 0;
+    ebh_uart_dma_init(ebh_uart_dma_tx_done, ebh_uart_dma_rx_done);
+    ebh_uart_dma_rx_start(ebh_uart_dma_rx_buffer, sizeof(ebh_uart_dma_rx_buffer));
+}
+
+void ebh_uart_dma_set_tx_hook(void (*hook)(void)) {
+    ebh_uart_dma_tx_hook = hook;
+}
+
+uint16_t ebh_uart_dma_rx_overruns(void) {
+    return ebh_uart_dma_overruns;
+}
+
+uint8_t ebh_uart_dma_tx_idle(void) {
+    return !ebh_uart_dma_tx_active && !ebh_uart_dma_tx_busy();
+}
+
+/* Total number of bytes written by the RX DMA since ebh_uart_dma_start() */
+static uint32_t ebh_uart_dma_rx_written(void) {
+    uint32_t passes = 0;
+    uint16_t remaining = 0;
+
+    // The callback may restart the transfer in between, read again until both values belong together
+    do {
+        passes = ebh_uart_dma_rx_passes;
+        remaining = ebh_uart_dma_rx_remaining();
+    } while(passes != ebh_uart_dma_rx_passes);
+
+    return passes * EBH_UART_DMA_RX_SIZE + (EBH_UART_DMA_RX_SIZE - remaining);
+}
+
+static uint16_t ebh_uart_dma_rx_count(void) {
+    uint32_t count = ebh_uart_dma_rx_written() - ebh_uart_dma_rx_read;
+
+    if(count > EBH_UART_DMA_RX_SIZE) {
+        // The DMA lapped the reader, everything unread is lost
+        ebh_uart_dma_overruns++;
+        ebh_uart_dma_rx_read += count;
+        return 0;
+    }
+    return (uint16_t)count;
+}
+
+static void ebh_uart_dma_tx_kick(uint16_t length) {
+    while(ebh_uart_dma_tx_active) {
+        ebh_delay_us(1);
+    }
+
+    ebh_uart_dma_tx_active = 1;
+    ebh_uart_dma_tx_start(ebh_uart_dma_tx_buffer[ebh_uart_dma_tx_index], length);
+    ebh_uart_dma_tx_index ^= 1;
+}
+
+static void ebh_uart_dma_send(void *context, const ebh_iovec *iov, uint8_t count) {
+    uint16_t used = 0;
+    uint16_t offset = 0;
+    uint16_t chunk = 0;
+
+    while(count--) {
+        offset = 0;
+        while(offset < iov->length) {
+            chunk = iov->length - offset;
+            if(chunk > EBH_MAX_FRAME_SIZE - used) {
+                chunk = EBH_MAX_FRAME_SIZE - used;
+            }
+            memcpy(&ebh_uart_dma_tx_buffer[ebh_uart_dma_tx_index][used], &iov->data[offset], chunk);
+            used += chunk;
+            offset += chunk;
+            if(used == EBH_MAX_FRAME_SIZE) {
+                ebh_uart_dma_tx_kick(used);
+                used = 0;
+            }
+        }
+        iov++;
+    }
+    if(used) {
+        ebh_uart_dma_tx_kick(used);
+    }
+}
+
+static uint8_t ebh_uart_dma_wait_readable(void *context, uint32_t timeout_us) {
+    ebh_deadline deadline = ebh_deadline_in(timeout_us);
+
+    while(ebh_uart_dma_rx_count() == 0) {
+        if((timeout_us != EBH_TIMEOUT_INFINITE) && ebh_deadline_expired(deadline)) {
+            return 0;
+        }
+        ebh_delay_us(1);
+    }
+    return 1;
+}
+
+static uint16_t ebh_uart_dma_receive(void *context, uint8_t *data, uint16_t length, uint32_t timeout_us) {
+    uint16_t received = 0;
+    uint16_t available = 0;
+    uint16_t position = 0;
+    uint16_t chunk = 0;
+
+    while(received < length) {
+        available = ebh_uart_dma_rx_count();
+        if(available == 0) {
+            if(!ebh_uart_dma_wait_readable(context, timeout_us)) {
+                break;
+            }
+            continue;
+        }
+        if(available > length - received) {
+            available = length - received;
+        }
+        while(available) {
+            position = ebh_uart_dma_rx_read % EBH_UART_DMA_RX_SIZE;
+            chunk = EBH_UART_DMA_RX_SIZE - position;
+            if(chunk > available) {
+                chunk = available;
+            }
+            memcpy(&data[received], &ebh_uart_dma_rx_buffer[position], chunk);
+            ebh_uart_dma_rx_read += chunk;
+            received += chunk;
+            available -= chunk;
+        }
+    }
+    return received;
+}
+
+static void ebh_uart_dma_flush(void *context) {
+    ebh_uart_dma_rx_read = ebh_uart_dma_rx_written();
+}
+
+static void ebh_uart_dma_wait_tx_idle(void *context) {
+    while(!ebh_uart_dma_tx_idle());
+}
+
+static uint8_t ebh_uart_dma_set_baud(void *context, uint32_t baud) {
+    // Frames still in flight have to leave with the old baud rate
+    ebh_uart_dma_wait_tx_idle(context);
+
+    // Same UART as the polling interface
+    return ebh_uart_poll_configure_baud(baud);
+}
+
+const ebh_transport ebh_transport_uart_dma = {
+    ebh_uart_dma_send,
+    ebh_uart_dma_receive,
+    ebh_uart_dma_wait_readable,
+    ebh_uart_dma_flush,
+    ebh_uart_dma_set_baud,
+    ebh_uart_dma_wait_tx_idle,
+    0
+};
@@ -0,0 +1,146 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Max Groening
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <stdint.h>
+#include "config.h"
+#include "transport.h"
+#include "timing.h"
+#include "ring_buffer.h"
+#include "devices/devices.h"
+#include "embedded_bootloader/bootloader_protocol.h"
+
+
+/*
+ * UART (interrupt) transport
+ *
+ * send() only copies the frame into the TX ring and returns, the ISR streams it into the
+ * UART FIFO. Received bytes are collected into the RX ring by the ISR as they arrive.
+ * The BSP calls ebh_uart_irq_isr() from its UART interrupt handler.
+ */
+
+static uint8_t ebh_uart_irq_tx_buffer[EBH_UART_IRQ_TX_SIZE];
+static uint8_t ebh_uart_irq_rx_buffer[EBH_UART_IRQ_RX_SIZE];
+static ebh_ring_buffer ebh_uart_irq_tx;
+static ebh_ring_buffer ebh_uart_irq_rx;
+static volatile uint16_t ebh_uart_irq_overruns = 0;
+
+void ebh_uart_irq_start(void) {
+    ebh_ring_init(&ebh_uart_irq_tx, ebh_uart_irq_tx_buffer, sizeof(ebh_uart_irq_tx_buffer));
+    ebh_ring_init(&ebh_uart_irq_rx, ebh_uart_irq_rx_buffer, sizeof(ebh_uart_irq_rx_buffer));
+    ebh_uart_irq_overruns = 0;
+    ebh_uart_irq_init();
+}
+
+void ebh_uart_irq_isr(void) {
+    uint8_t character = 0;
+
+    // Receive: consumer of the hardware FIFO, producer of the RX ring
+    while(ebh_uart_irq_hw_rx_ready()) {
+        character = ebh_uart_irq_hw_read();
+        if(!ebh_ring_put_char(&ebh_uart_irq_rx, character)) {
+            ebh_uart_irq_overruns++;
+        }
+    }
+
+    // Transmit: consumer of the TX ring
+    while(ebh_uart_irq_hw_tx_ready()) {
+        if(!ebh_ring_get_char(&ebh_uart_irq_tx, &character)) {
+            ebh_uart_irq_hw_tx_enable(0);  // Nothing left, send() enables the interrupt again
+            break;
+        }
+        ebh_uart_irq_hw_write(character);
+    }
+}
+
+uint16_t ebh_uart_irq_rx_overruns(void) {
+    return ebh_uart_irq_overruns;
+}
+
+uint8_t ebh_uart_irq_tx_idle(void) {
+    return (ebh_ring_count(&ebh_uart_irq_tx) == 0) && ebh_uart_irq_hw_tx_done();
+}
+
+static void ebh_uart_irq_send(void *context, const ebh_iovec *iov, uint8_t count) {
+    uint16_t sent = 0;
+
+    while(count--) {
+        sent = 0;
+        while(sent < iov->length) {
+            sent += ebh_ring_put(&ebh_uart_irq_tx, &iov->data[sent], iov->length - sent);
+            ebh_uart_irq_hw_tx_enable(1);  // Pends the interrupt, so the ISR also starts an idle UART
+        }
+        iov++;
+    }
+}
+
+static uint8_t ebh_uart_irq_wait_readable(void *context, uint32_t timeout_us) {
+    ebh_deadline deadline = ebh_deadline_in(timeout_us);
+
+    while(ebh_ring_count(&ebh_uart_irq_rx) == 0) {
+        if((timeout_us != EBH_TIMEOUT_INFINITE) && ebh_deadline_expired(deadline)) {
+            return 0;
+        }
+        ebh_delay_us(1);
+    }
+    return 1;
+}
+
+static uint16_t ebh_uart_irq_receive(void *context, uint8_t *data, uint16_t length, uint32_t timeout_us) {
+    uint16_t received = 0;
+
+    while(received < length) {
+        received += ebh_ring_get(&ebh_uart_irq_rx, &data[received], length - received);
+        if((received < length) && !ebh_uart_irq_wait_readable(context, timeout_us)) {
+            break;
+        }
+    }
+    return received;
+}
+
+static void ebh_uart_irq_flush(void *context) {
+    ebh_ring_clear(&ebh_uart_irq_rx);
+}
+
+static void ebh_uart_irq_wait_tx_idle(void *context) {
+    while(!ebh_uart_irq_tx_idle());
+}
+
+static uint8_t ebh_uart_irq_set_baud(void *context, uint32_t baud) {
+    // Frames still queued have to leave with the old baud rate
+    ebh_uart_irq_wait_tx_idle(context);
+
+    // Same UART as the polling interface
+    return ebh_uart_poll_configure_baud(baud);
+}
+
+const ebh_transport ebh_transport_uart_irq = {
+    ebh_uart_irq_send,
+    ebh_uart_irq_receive,
+    ebh_uart_irq_wait_readable,
+    ebh_uart_irq_flush,
+    ebh_uart_irq_set_baud,
+    ebh_uart_irq_wait_tx_idle,
+    0
+};
@@ -24,16 +24,72 @@
 
 
 #include <stdint.h>
+#include "config.h"
+#include "transport.h"
+#include "timing.h"
 #include "devices/devices.h"
+#include "embedded_bootloader/bootloader_protocol.h"
 
-void ebh_send_char(uint8_t character) {
-    ebh_uart_poll_send_char(character);
+
+/*
+ * UART (polling) transport on top of the ebh_uart_poll_* BSP functions
+ */
+
+static void ebh_uart_poll_send(void *context, const ebh_iovec *iov, uint8_t count) {
+    while(count--) {
+#if EBH_UART_POLL_SEND_BUF
+        ebh_uart_poll_send_buf(iov->data, iov->length);
+#else
+        // Per byte fallback for BSPs that only implement ebh_uart_poll_send_char()
+        uint16_t i = 0;
+        for(i = 0; i < iov->length; i++) {
+            ebh_uart_poll_send_char(iov->data[i]);
+        }
+#endif
+        iov++;
+    }
 }
 
-uint8_t ebh_receive_char() {
-    return ebh_uart_poll_receive_char();
+static uint8_t ebh_uart_poll_wait_readable(void *context, uint32_t timeout_us) {
+    ebh_deadline deadline = ebh_deadline_in(timeout_us);
+
+    while(!ebh_uart_poll_receive_char_available()) {
+        if((timeout_us != EBH_TIMEOUT_INFINITE) && ebh_deadline_expired(deadline)) {
+            return 0;
+        }
+        ebh_delay_us(EBH_UART_POLL_INTERVAL);
+    }
+    return 1;
 }
 
-uint16_t ebh_receive_char_available() {
-    return ebh_uart_poll_receive_char_available();
+static uint16_t ebh_uart_poll_receive(void *context, uint8_t *data, uint16_t length, uint32_t timeout_us) {
+    uint16_t received = 0;
+
+    while(received < length) {
+        if(!ebh_uart_poll_wait_readable(context, timeout_us)) {
+            break;
+        }
+        data[received++] = ebh_uart_poll_receive_char();
+    }
+    return received;
 }
+
+static void ebh_uart_poll_flush(void *context) {
+    while(ebh_uart_poll_receive_char_available()) {
+        ebh_uart_poll_receive_char();
+    }
+}
+
+static uint8_t ebh_uart_poll_set_baud(void *context, uint32_t baud) {
+    return ebh_uart_poll_configure_baud(baud);
+}
+
+const ebh_transport ebh_transport_uart_poll = {
+    ebh_uart_poll_send,
+    ebh_uart_poll_receive,
+    ebh_uart_poll_wait_readable,
+    ebh_uart_poll_flush,
+    ebh_uart_poll_set_baud,
+    0,
+    0
+};
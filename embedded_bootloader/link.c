@@ -0,0 +1,261 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Max Groening
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <stdint.h>
+#include "config.h"
+#include "link.h"
+#include "gap.h"
+#include "embedded_bootloader.h"
+#include "embedded_bootloader/bootloader_protocol.h"
+
+#define EBH_LINK_RATES  (EBH_UART_BAUD_RATE_115200 - EBH_UART_BAUD_RATE_9600 + 1)
+
+static const uint32_t ebh_link_rates[EBH_LINK_RATES] = {9600, 19200, 38400, 57600, 115200};
+
+static uint8_t ebh_link_index = 0;  // Current baud rate in ebh_link_rates
+static uint8_t ebh_link_monitoring = 0;
+static uint8_t ebh_link_busy = 0;   // Frames of the link management itself are not monitored
+static uint8_t ebh_link_pending = 0;  // Downshift before the next frame
+static uint16_t ebh_link_window_frames = 0;
+static uint16_t ebh_link_window_errors = 0;
+static ebh_link_stats ebh_link_statistics = {9600, 0, 0, 0};
+
+uint32_t ebh_baud_rate(uint8_t code) {
+    if((code < EBH_UART_BAUD_RATE_9600) || (code > EBH_UART_BAUD_RATE_115200)) {
+        return 0;
+    }
+    return ebh_link_rates[code - EBH_UART_BAUD_RATE_9600];
+}
+
+static uint8_t ebh_link_change(uint8_t index) {
+    uint8_t status = EBH_UART_ERROR_TIME_OUT;
+    uint8_t attempt = 0;
+
+    // A disturbed link may still carry the short CHANGE_BAUD_RATE frame after a few attempts
+    for(attempt = 0; attempt < EBH_LINK_RETRIES; attempt++) {
+        if(attempt > 0) {
+            ebh_resync();
+        }
+        ebh_flush();
+        status = ebh_change_baud_rate(EBH_UART_BAUD_RATE_9600 + index);
+        ebh_delay_between_commands();
+        if(status == EBH_UART_ERROR_ACK) {
+            status = ebh_set_baud(ebh_link_rates[index]);
+            if(status == EBH_UART_ERROR_ACK) {
+                ebh_link_index = index;
+                ebh_link_statistics.baud = ebh_link_rates[index];
+            }
+            return status;
+        }
+        if(status == EBH_UART_ERROR_UNKNOWN_BAUD_RATE) {
+            return status;
+        }
+    }
+    return status;
+}
+
+static uint8_t ebh_link_probe(ebh_device device, uint8_t count) {
+    uint8_t version[10];
+    uint8_t status = EBH_UART_ERROR_ACK;
+    uint8_t i = 0;
+
+    ebh_flush();
+    for(i = 0; (i < count) && (status == EBH_UART_ERROR_ACK); i++) {
+        status = ebh_tx_bsl_version(device, version);
+    }
+    return status;
+}
+
+uint8_t ebh_link_set_baud(uint32_t baud) {
+    uint8_t index = 0;
+    uint8_t status = 0;
+
+    for(index = 0; index < EBH_LINK_RATES; index++) {
+        if(ebh_link_rates[index] == baud) {
+            break;
+        }
+    }
+    if(index == EBH_LINK_RATES) {
+        return EBH_UART_ERROR_UNKNOWN_BAUD_RATE;
+    }
+
+    ebh_link_busy = 1;
+    status = ebh_link_change(index);
+    ebh_link_busy = 0;
+    return status;
+}
+
+static uint8_t ebh_link_sync_at(uint8_t index) {
+    uint8_t status = ebh_set_baud(ebh_link_rates[index]);
+
+    if(status == EBH_UART_ERROR_ACK) {
+        ebh_flush();
+        ebh_send_char(EBH_SYNC_CHARACTER);
+        status = ebh_receive_ack();
+        ebh_gap_command(EBH_SYNC_CHARACTER);
+    }
+    if(status == EBH_UART_ERROR_ACK) {
+        ebh_link_index = index;
+        ebh_link_statistics.baud = ebh_link_rates[index];
+    }
+    return status;
+}
+
+uint8_t ebh_link_sync(uint32_t baud) {
+    uint8_t index = EBH_LINK_RATES;
+    uint8_t status = 0;
+
+    while((index > 1) && (ebh_link_rates[index - 1] > baud)) {
+        index--;
+    }
+    index--;
+
+    ebh_session_reset();
+    ebh_link_busy = 1;
+
+    // The BSL measures the baud rate on the sync character, one command verifies the link
+    status = ebh_link_sync_at(index);
+    if(status == EBH_UART_ERROR_ACK) {
+        status = ebh_link_probe(ebh_device_msp432, 1);
+        if(status != EBH_UART_ERROR_ACK) {
+            ebh_resync();  // The probe may have left a partial frame in the BSL
+        }
+    }
+
+    // Rate not detected: the usual way, sync at 9600 baud and change the rate
+    if((status != EBH_UART_ERROR_ACK) && (index > 0)) {
+        ebh_delay_between_commands();
+        status = ebh_link_sync_at(0);
+        if(status == EBH_UART_ERROR_ACK) {
+            ebh_delay_between_commands();
+            status = ebh_link_change(index);
+        }
+        if(status == EBH_UART_ERROR_ACK) {
+            status = ebh_link_probe(ebh_device_msp432, 1);
+        }
+    }
+
+    ebh_link_busy = 0;
+    return status;
+}
+
+uint8_t ebh_link_negotiate(ebh_device device, uint32_t max_baud) {
+    uint8_t index = EBH_LINK_RATES;
+    uint8_t status = EBH_UART_ERROR_UNKNOWN_BAUD_RATE;
+
+    ebh_link_busy = 1;
+
+    // Highest baud rate first, a rate failing the probes hands over to the next lower one
+    while(index-- > 0) {
+        if(ebh_link_rates[index] > max_baud) {
+            continue;
+        }
+        if(index != ebh_link_index) {
+            status = ebh_link_change(index);
+            if(status != EBH_UART_ERROR_ACK) {
+                continue;
+            }
+        }
+        status = ebh_link_probe(device, EBH_LINK_PROBES);
+        if(status == EBH_UART_ERROR_ACK) {
+            break;
+        }
+        ebh_resync();
+    }
+
+    ebh_link_window_frames = 0;
+    ebh_link_window_errors = 0;
+    ebh_link_busy = 0;
+    return status;
+}
+
+uint8_t ebh_link_downshift(void) {
+    uint8_t status = EBH_UART_ERROR_UNKNOWN_BAUD_RATE;
+
+    if(ebh_link_index > 0) {
+        ebh_link_busy = 1;
+        ebh_resync();
+        status = ebh_link_change(ebh_link_index - 1);
+        ebh_link_busy = 0;
+        if(status == EBH_UART_ERROR_ACK) {
+            ebh_link_statistics.downshifts++;
+        }
+    }
+    ebh_link_pending = 0;
+    ebh_link_window_frames = 0;
+    ebh_link_window_errors = 0;
+    return status;
+}
+
+void ebh_link_monitor(uint8_t enable) {
+    ebh_link_monitoring = enable;
+    ebh_link_pending = 0;
+    ebh_link_window_frames = 0;
+    ebh_link_window_errors = 0;
+}
+
+void ebh_link_reset(void) {
+    ebh_link_index = 0;
+    ebh_link_pending = 0;
+    ebh_link_window_frames = 0;
+    ebh_link_window_errors = 0;
+    ebh_link_statistics.baud = ebh_link_rates[0];
+    ebh_link_statistics.frames = 0;
+    ebh_link_statistics.errors = 0;
+    ebh_link_statistics.downshifts = 0;
+}
+
+void ebh_link_get_stats(ebh_link_stats *stats) {
+    *stats = ebh_link_statistics;
+}
+
+void ebh_link_record(uint8_t status, uint8_t frame) {
+    if(ebh_link_busy) {
+        return;
+    }
+
+    ebh_link_statistics.frames += frame;
+    ebh_link_window_frames += frame;
+
+    // Answers of the BSL that are not caused by the line do not count
+    if((status != EBH_UART_ERROR_ACK) && (status != EBH_UART_ERROR_UNKNOWN_BAUD_RATE) && (status != EBH_UART_ERROR_PACKET_SIZE_EXCEEDS_BUFFER)) {
+        ebh_link_statistics.errors++;
+        ebh_link_window_errors++;
+    }
+
+    // The command is still running, the baud rate changes before the next frame
+    if(ebh_link_monitoring && (ebh_link_window_errors >= EBH_LINK_MAX_ERRORS)) {
+        ebh_link_pending = 1;
+    } else if(ebh_link_window_frames >= EBH_LINK_WINDOW) {
+        ebh_link_window_frames = 0;
+        ebh_link_window_errors = 0;
+    }
+}
+
+void ebh_link_next_frame(void) {
+    if(ebh_link_pending && !ebh_link_busy) {
+        ebh_link_downshift();
+    }
+}
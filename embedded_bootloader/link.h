@@ -0,0 +1,68 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Max Groening
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef EMBEDDED_BOOTLOADER_LINK_H_
+#define EMBEDDED_BOOTLOADER_LINK_H_
+
+#include <stdint.h>
+#include "config.h"
+#include "embedded_bootloader.h"
+
+/*
+ * Link (baud rate) management for the UART BSL
+ *
+ * ebh_link_negotiate() switches to the fastest baud rate that passes EBH_LINK_PROBES
+ * TX_BSL_VERSION probes. The monitor counts line errors (wrong or missing ACK, corrupted
+ * or missing core responses) of every EBH_LINK_WINDOW frames and steps the baud rate down
+ * once EBH_LINK_MAX_ERRORS are reached, before the next frame is sent. The failing command still
+ * returns its error.
+ *
+ * ebh_link_sync() starts an MSP432 session without the 9600 baud detour: the BSL measures
+ * the baud rate on the sync character, so it is sent at the target rate right away and a
+ * single TX_BSL_VERSION verifies the link. If either fails, the session starts at 9600 baud
+ * and CHANGE_BAUD_RATE switches to the target rate.
+ */
+
+typedef struct {
+    uint32_t baud;         // Current baud rate of host and target
+    uint32_t frames;
+    uint32_t errors;
+    uint16_t downshifts;
+} ebh_link_stats;
+
+uint32_t ebh_baud_rate(uint8_t code);  // Baud rate of an EBH_UART_BAUD_RATE_* code, 0 if unknown
+
+uint8_t ebh_link_sync(uint32_t baud);  // MSP432: sync at baud and probe, falls back to sync at 9600 + CHANGE_BAUD_RATE
+uint8_t ebh_link_set_baud(uint32_t baud);  // CHANGE_BAUD_RATE on the target, then the host follows
+uint8_t ebh_link_negotiate(ebh_device device, uint32_t max_baud);
+uint8_t ebh_link_downshift(void);  // One baud rate lower, EBH_UART_ERROR_UNKNOWN_BAUD_RATE at 9600
+void ebh_link_monitor(uint8_t enable);
+void ebh_link_reset(void);  // The target runs at 9600 baud again (new session)
+void ebh_link_get_stats(ebh_link_stats *stats);
+
+void ebh_link_record(uint8_t status, uint8_t frame);  // Called by the protocol layer for every ACK (frame = 1) and core response
+void ebh_link_next_frame(void);  // Called by the protocol layer before a frame is sent
+
+#endif /* EMBEDDED_BOOTLOADER_LINK_H_ */
@@ -0,0 +1,162 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Max Groening
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <stdint.h>
+#include <string.h>
+#include "config.h"
+#include "part.h"
+
+#define EBH_PART_COUNT(memory)  (uint8_t)(sizeof(memory) / sizeof(memory[0]))
+
+#define EBH_FLASH  (EBH_MEMORY_WRITE | EBH_MEMORY_ERASE | EBH_MEMORY_MASS)
+#define EBH_FRAM   (EBH_MEMORY_WRITE | EBH_MEMORY_MASS)  // Written without erase
+
+static const ebh_memory ebh_memory_msp430_flash[] = {
+    {0x00000, 0x100000, 512, ebh_memory_main, EBH_FLASH}
+};
+
+static const ebh_memory ebh_memory_msp430_fram[] = {
+    {0x00000, 0x100000, 0, ebh_memory_main, EBH_FRAM}
+};
+
+static const ebh_memory ebh_memory_msp432[] = {
+    {0x00000000, 0x00400000, 4096, ebh_memory_main, EBH_FLASH},
+    {0x20000000, 0x20100000, 0, ebh_memory_ram, EBH_MEMORY_WRITE}
+};
+
+static const ebh_memory ebh_memory_msp430f5529[] = {
+    {0x01000, 0x01800, 512, ebh_memory_bsl, 0},
+    {0x01800, 0x01A00, 128, ebh_memory_info, EBH_MEMORY_WRITE | EBH_MEMORY_ERASE},
+    {0x01A00, 0x01B00, 0, ebh_memory_tlv, 0},
+    {0x01C00, 0x04400, 0, ebh_memory_ram, EBH_MEMORY_WRITE},  // USB RAM and RAM
+    {0x04400, 0x24400, 512, ebh_memory_main, EBH_FLASH}
+};
+
+static const ebh_memory ebh_memory_msp430f5438a[] = {
+    {0x01000, 0x01800, 512, ebh_memory_bsl, 0},
+    {0x01800, 0x01A00, 128, ebh_memory_info, EBH_MEMORY_WRITE | EBH_MEMORY_ERASE},
+    {0x01A00, 0x01A80, 0, ebh_memory_tlv, 0},
+    {0x01C00, 0x05C00, 0, ebh_memory_ram, EBH_MEMORY_WRITE},
+    {0x05C00, 0x45C00, 512, ebh_memory_main, EBH_FLASH}
+};
+
+static const ebh_memory ebh_memory_msp430fr5969[] = {
+    {0x01000, 0x01800, 0, ebh_memory_bsl, 0},
+    {0x01800, 0x01A00, 0, ebh_memory_info, EBH_MEMORY_WRITE},
+    {0x01A00, 0x01A80, 0, ebh_memory_tlv, 0},
+    {0x01C00, 0x02400, 0, ebh_memory_ram, EBH_MEMORY_WRITE},
+    {0x04400, 0x14000, 0, ebh_memory_main, EBH_FRAM}
+};
+
+static const ebh_memory ebh_memory_msp432p401r[] = {
+    {0x00000000, 0x00040000, 4096, ebh_memory_main, EBH_FLASH},
+    {0x00200000, 0x00201000, 4096, ebh_memory_info, EBH_MEMORY_WRITE | EBH_MEMORY_ERASE},  // Boot override mailbox
+    {0x00201000, 0x00202000, 4096, ebh_memory_tlv, 0},
+    {0x00202000, 0x00204000, 4096, ebh_memory_bsl, 0},
+    {0x20000000, 0x20010000, 0, ebh_memory_ram, EBH_MEMORY_WRITE}
+};
+
+// MSP432: 256 data bytes with a 32 bit address, see EBH_DEFAULT_DATA_BLOCK
+const ebh_part ebh_part_msp430_flash = {"msp430_flash", ebh_device_msp430_flash, ebh_memory_msp430_flash, EBH_PART_COUNT(ebh_memory_msp430_flash), 1, 260};
+const ebh_part ebh_part_msp430_fram = {"msp430_fram", ebh_device_msp430_fram, ebh_memory_msp430_fram, EBH_PART_COUNT(ebh_memory_msp430_fram), 1, 260};
+const ebh_part ebh_part_msp432 = {"msp432", ebh_device_msp432, ebh_memory_msp432, EBH_PART_COUNT(ebh_memory_msp432), 16, 261};
+const ebh_part ebh_part_msp430f5529 = {"msp430f5529", ebh_device_msp430_flash, ebh_memory_msp430f5529, EBH_PART_COUNT(ebh_memory_msp430f5529), 1, 260};
+const ebh_part ebh_part_msp430f5438a = {"msp430f5438a", ebh_device_msp430_flash, ebh_memory_msp430f5438a, EBH_PART_COUNT(ebh_memory_msp430f5438a), 1, 260};
+const ebh_part ebh_part_msp430fr5969 = {"msp430fr5969", ebh_device_msp430_fram, ebh_memory_msp430fr5969, EBH_PART_COUNT(ebh_memory_msp430fr5969), 1, 260};
+const ebh_part ebh_part_msp432p401r = {"msp432p401r", ebh_device_msp432, ebh_memory_msp432p401r, EBH_PART_COUNT(ebh_memory_msp432p401r), 16, 261};
+
+const ebh_part *const ebh_parts[] = {
+    &ebh_part_msp430_flash, &ebh_part_msp430_fram, &ebh_part_msp432,
+    &ebh_part_msp430f5529, &ebh_part_msp430f5438a, &ebh_part_msp430fr5969, &ebh_part_msp432p401r
+};
+
+const uint8_t ebh_part_count = sizeof(ebh_parts) / sizeof(ebh_parts[0]);
+
+const ebh_part *ebh_part_find(const char *name) {
+    uint8_t i = 0;
+
+    for(i = 0; i < ebh_part_count; i++) {
+        if(strcmp(ebh_parts[i]->name, name) == 0) {
+            return ebh_parts[i];
+        }
+    }
+    return 0;
+}
+
+const ebh_part *ebh_part_of(ebh_device device) {
+#ifdef EBH_PART
+    if(EBH_PART.device == device) {
+        return &EBH_PART;
+    }
+#endif
+    switch(device) {
+    case ebh_device_msp430_fram: return &ebh_part_msp430_fram;
+    case ebh_device_msp432:      return &ebh_part_msp432;
+    default:                     return &ebh_part_msp430_flash;
+    }
+}
+
+const ebh_memory *ebh_part_memory(const ebh_part *part, uint32_t addr) {
+    uint8_t lo = 0;
+    uint8_t hi = part->memory_count;
+    uint8_t mid = 0;
+
+    while(lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if(addr < part->memory[mid].start) {
+            hi = mid;
+        } else if(addr >= part->memory[mid].end) {
+            lo = mid + 1;
+        } else {
+            return &part->memory[mid];
+        }
+    }
+    return 0;
+}
+
+uint8_t ebh_part_allows(const ebh_part *part, uint32_t addr, uint32_t length, uint8_t flags) {
+    const ebh_memory *memory = ebh_part_memory(part, addr);
+    const ebh_memory *last = &part->memory[part->memory_count - 1];
+    uint32_t end = addr + length;
+
+    if(length == 0) {
+        return 1;
+    }
+    if(end < addr) {
+        return 0;
+    }
+
+    // Adjacent regions may share a range
+    while(memory && ((memory->flags & flags) == flags)) {
+        if(end <= memory->end) {
+            return 1;
+        }
+        if((memory == last) || (memory[1].start != memory->end)) {
+            return 0;
+        }
+        memory++;
+    }
+    return 0;
+}
@@ -0,0 +1,88 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Max Groening
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef EMBEDDED_BOOTLOADER_PART_H_
+#define EMBEDDED_BOOTLOADER_PART_H_
+
+#include <stdint.h>
+#include "config.h"
+#include "embedded_bootloader.h"
+
+/*
+ * Device geometry
+ *
+ * A part describes the memory map the BSL sees: its regions in address order, not
+ * overlapping, with the segment size ERASE_SEGMENT clears and what the BSL may do there,
+ * the BSL buffer size and the write granularity. The planners (plan.h, erase.h) and
+ * ebh_elf_open() check image addresses against it before any command is sent.
+ *
+ * With EBH_PART (config.h) the part is fixed at compile time: ebh_write_region(),
+ * ebh_write_stream() and ebh_erase_segment(_32) refuse addresses outside its writable or
+ * erasable memory, and the data block size is taken from it instead of TX_BUFFER_SIZE.
+ *
+ * The generic parts cover the whole address space of a device family, for when the exact
+ * part is not known.
+ */
+
+#define EBH_MEMORY_WRITE  0x01  // RX_DATA_BLOCK
+#define EBH_MEMORY_ERASE  0x02  // ERASE_SEGMENT clears `segment` bytes
+#define EBH_MEMORY_MASS   0x04  // Cleared by MASS_ERASE
+
+typedef enum {ebh_memory_main, ebh_memory_info, ebh_memory_tlv, ebh_memory_bsl, ebh_memory_ram} ebh_memory_type;
+
+typedef struct {
+    uint32_t start;       // [start, end)
+    uint32_t end;
+    uint16_t segment;     // Power of two, 0: no segment erase
+    uint8_t type;         // ebh_memory_type
+    uint8_t flags;
+} ebh_memory;
+
+typedef struct {
+    const char *name;
+    ebh_device device;
+    const ebh_memory *memory;
+    uint8_t memory_count;
+    uint8_t align;        // Write granularity in bytes
+    uint16_t buffer_size; // BSL core buffer: command, address and data
+} ebh_part;
+
+extern const ebh_part ebh_part_msp430_flash;  // Generic, 20 bit address space
+extern const ebh_part ebh_part_msp430_fram;
+extern const ebh_part ebh_part_msp432;
+extern const ebh_part ebh_part_msp430f5529;
+extern const ebh_part ebh_part_msp430f5438a;
+extern const ebh_part ebh_part_msp430fr5969;
+extern const ebh_part ebh_part_msp432p401r;
+
+extern const ebh_part *const ebh_parts[];
+extern const uint8_t ebh_part_count;
+
+const ebh_part *ebh_part_find(const char *name);  // 0 if unknown
+const ebh_part *ebh_part_of(ebh_device device);  // EBH_PART if it is of the device, else the generic part
+const ebh_memory *ebh_part_memory(const ebh_part *part, uint32_t addr);  // Binary search, 0 outside the memory map
+uint8_t ebh_part_allows(const ebh_part *part, uint32_t addr, uint32_t length, uint8_t flags);  // 1 if all bytes lie in memory with the flags
+
+#endif /* EMBEDDED_BOOTLOADER_PART_H_ */
@@ -0,0 +1,281 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Max Groening
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <stdint.h>
+#include <string.h>
+#include "config.h"
+#include "plan.h"
+#include "timing.h"
+#include "embedded_bootloader.h"
+#include "embedded_bootloader/bootloader_protocol.h"
+
+#define EBH_PLAN_NONE       0xFFFFFFFFu
+#define EBH_PLAN_ADDR_24    0x1000000u   // RX_DATA_BLOCK below, RX_DATA_BLOCK_32 above
+#define EBH_PLAN_RESPONSE   8            // ACK and core response frame
+
+typedef struct {
+    ebh_plan *plan;
+    const ebh_plan_options *options;
+    uint16_t block[2];    // Data bytes per packet with a 3 and a 4 byte address
+    uint32_t start;       // Span collected so far
+    uint32_t end;
+    uint8_t status;
+} ebh_plan_state;
+
+static uint8_t ebh_plan_a_len(uint32_t addr) {
+    return (addr < EBH_PLAN_ADDR_24) ? 3 : 4;
+}
+
+uint32_t ebh_plan_packet_time(uint32_t addr, uint16_t length) {
+    uint32_t line = EBH_FRAME_OVERHEAD + 1 + ebh_plan_a_len(addr) + length + EBH_PLAN_RESPONSE;
+    return ebh_line_time_us(line) + EBH_PLAN_COMMAND_TIME + (uint32_t)length * EBH_PLAN_BYTE_TIME;
+}
+
+/* Data bytes per packet before alignment */
+static uint16_t ebh_plan_block(const ebh_plan_options *options, uint8_t a_len) {
+    uint16_t block = 0;
+
+    if(options->block) {
+        block = options->block;
+    } else if(options->part) {
+        block = options->part->buffer_size - 1 - a_len;
+    } else {
+        block = ebh_write_block_size((a_len == 3) ? 0 : EBH_PLAN_ADDR_24);
+    }
+    if(block > EBH_MAX_BUFFER_SIZE - 1 - a_len) {
+        block = EBH_MAX_BUFFER_SIZE - 1 - a_len;
+    }
+    return block;
+}
+
+void ebh_plan_defaults(ebh_plan_options *options, const ebh_part *part) {
+    uint32_t packet = ebh_plan_packet_time(0, 0);
+    uint32_t byte = ebh_line_time_us(1) + EBH_PLAN_BYTE_TIME;
+
+    options->part = part;
+    options->block = 0;
+    options->align = part ? part->align : EBH_PLAN_ALIGN;
+    options->blank = EBH_PLAN_BLANK;
+    options->bridge = packet / byte;  // A gap costs less than the packet it saves
+}
+
+/* Splits the collected span into packets */
+static void ebh_plan_flush(ebh_plan_state *state) {
+    ebh_plan *plan = state->plan;
+    uint32_t addr = state->start;
+    uint32_t length = 0;
+    uint16_t block = 0;
+
+    while((addr < state->end) && (state->status == EBH_UART_ERROR_ACK)) {
+        length = state->end - addr;
+        block = state->block[ebh_plan_a_len(addr) - 3];  // As ebh_write() sizes its frames
+        if(length > block) {
+            length = block;
+        }
+        if((addr < EBH_PLAN_ADDR_24) && (length > EBH_PLAN_ADDR_24 - addr)) {
+            length = EBH_PLAN_ADDR_24 - addr;
+        }
+        if(plan->count == plan->max_packets) {
+            state->status = EBH_UART_ERROR_PLAN_FULL;
+            return;
+        }
+        plan->packets[plan->count].addr = addr;
+        plan->packets[plan->count].length = length;
+        plan->count++;
+        plan->bytes += length;
+        plan->time_us += ebh_plan_packet_time(addr, length);
+        addr += length;
+    }
+    state->end = state->start;
+}
+
+/* Adds the image data [start, end) */
+static void ebh_plan_span(ebh_plan_state *state, uint32_t start, uint32_t end) {
+    uint32_t mask = state->options->align - 1;
+
+    start &= ~mask;
+    end = (end + mask) & ~mask;
+    if((state->end > state->start) && (start <= state->end + state->options->bridge)) {
+        if(end > state->end) {
+            state->end = end;
+        }
+        return;
+    }
+    ebh_plan_flush(state);
+    state->start = start;
+    state->end = end;
+}
+
+/* Adds a range without its 0xFF runs of at least `blank` bytes */
+static void ebh_plan_range(ebh_plan_state *state, const ebh_range *range) {
+    const uint8_t *data = range->data;
+    const ebh_part *part = state->options->part;
+    uint32_t blank = state->options->blank;
+    uint32_t start = EBH_PLAN_NONE;
+    uint32_t run = EBH_PLAN_NONE;
+    uint32_t i = 0;
+
+    if(part && !ebh_part_allows(part, range->addr, range->length, EBH_MEMORY_ERASE)) {
+        blank = 0;  // Not erased before writing
+    }
+    if(blank == 0) {
+        ebh_plan_span(state, range->addr, range->addr + range->length);
+        return;
+    }
+
+    for(i = 0; i < range->length; i++) {
+        if(data[i] == 0xFF) {
+            if(run == EBH_PLAN_NONE) {
+                run = i;
+            }
+            continue;
+        }
+        if(run != EBH_PLAN_NONE) {
+            if(i - run >= blank) {
+                if(start != EBH_PLAN_NONE) {
+                    ebh_plan_span(state, range->addr + start, range->addr + run);
+                }
+                state->plan->skipped += i - run;
+                start = i;
+            } else if(start == EBH_PLAN_NONE) {
+                start = run;
+            }
+            run = EBH_PLAN_NONE;
+        }
+        if(start == EBH_PLAN_NONE) {
+            start = i;
+        }
+    }
+
+    if((run != EBH_PLAN_NONE) && (range->length - run >= blank)) {
+        state->plan->skipped += range->length - run;
+        if(start != EBH_PLAN_NONE) {
+            ebh_plan_span(state, range->addr + start, range->addr + run);
+        }
+    } else {
+        if(start == EBH_PLAN_NONE) {
+            start = run;
+        }
+        if(start != EBH_PLAN_NONE) {
+            ebh_plan_span(state, range->addr + start, range->addr + range->length);
+        }
+    }
+}
+
+uint8_t ebh_plan_make(ebh_plan *plan, const ebh_range *ranges, uint16_t range_count, const ebh_plan_options *options,
+                      ebh_plan_packet *packets, uint16_t max_packets) {
+    ebh_plan_state state;
+    uint32_t image = 0;
+    uint16_t block = 0;
+    uint16_t i = 0;
+    uint8_t a_len = 0;
+
+    plan->ranges = ranges;
+    plan->range_count = range_count;
+    plan->packets = packets;
+    plan->max_packets = max_packets;
+    plan->count = 0;
+    plan->bytes = 0;
+    plan->skipped = 0;
+    plan->filled = 0;
+    plan->time_us = 0;
+    plan->naive_us = 0;
+
+    if((options->align == 0) || (options->align & (options->align - 1))) {
+        return EBH_UART_ERROR_PLAN_RANGES;
+    }
+    for(i = 1; i < range_count; i++) {
+        if(ranges[i].addr < ranges[i - 1].addr + ranges[i - 1].length) {
+            return EBH_UART_ERROR_PLAN_RANGES;
+        }
+    }
+    for(i = 0; options->part && (i < range_count); i++) {
+        if(!ebh_part_allows(options->part, ranges[i].addr, ranges[i].length, EBH_MEMORY_WRITE)) {
+            return EBH_UART_ERROR_PART_ADDRESS;
+        }
+    }
+
+    state.plan = plan;
+    state.options = options;
+    for(a_len = 3; a_len <= 4; a_len++) {
+        block = ebh_plan_block(options, a_len);
+        state.block[a_len - 3] = (block >= options->align) ? block & ~(options->align - 1) : options->align;
+    }
+    state.start = 0;
+    state.end = 0;
+    state.status = EBH_UART_ERROR_ACK;
+
+    for(i = 0; i < range_count; i++) {
+        ebh_plan_range(&state, &ranges[i]);
+        image += ranges[i].length;
+
+        // What ebh_write_region() would send for the range
+        block = ebh_plan_block(options, ebh_plan_a_len(ranges[i].addr));
+        plan->naive_us += (ranges[i].length / block) * ebh_plan_packet_time(ranges[i].addr, block);
+        if(ranges[i].length % block) {
+            plan->naive_us += ebh_plan_packet_time(ranges[i].addr, ranges[i].length % block);
+        }
+    }
+    ebh_plan_flush(&state);
+
+    plan->filled = plan->bytes - (image - plan->skipped);
+    return state.status;
+}
+
+uint8_t ebh_plan_write(const ebh_plan *plan) {
+    static uint8_t buffer[EBH_MAX_BUFFER_SIZE];
+    const ebh_range *ranges = plan->ranges;
+    const ebh_plan_packet *packet = plan->packets;
+    const uint8_t *data = 0;
+    uint32_t end = 0;
+    uint32_t from = 0;
+    uint32_t to = 0;
+    uint16_t range = 0;
+    uint16_t i = 0;
+    uint16_t k = 0;
+    uint8_t status = EBH_UART_ERROR_ACK;
+
+    for(i = 0; (i < plan->count) && (status == EBH_UART_ERROR_ACK); i++, packet++) {
+        end = packet->addr + packet->length;
+        while((range < plan->range_count) && (ranges[range].addr + ranges[range].length <= packet->addr)) {
+            range++;
+        }
+
+        if((range < plan->range_count) && (ranges[range].addr <= packet->addr) && (end <= ranges[range].addr + ranges[range].length)) {
+            data = &ranges[range].data[packet->addr - ranges[range].addr];  // Sent from the image
+        } else {
+            // Gaps and alignment are filled with the erased state
+            memset(buffer, 0xFF, packet->length);
+            for(k = range; (k < plan->range_count) && (ranges[k].addr < end); k++) {
+                from = (ranges[k].addr > packet->addr) ? ranges[k].addr : packet->addr;
+                to = (ranges[k].addr + ranges[k].length < end) ? ranges[k].addr + ranges[k].length : end;
+                memcpy(&buffer[from - packet->addr], &ranges[k].data[from - ranges[k].addr], to - from);
+            }
+            data = buffer;
+        }
+        status = ebh_write_region(packet->addr, data, packet->length);
+    }
+    return status;
+}
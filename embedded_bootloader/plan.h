@@ -0,0 +1,89 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Max Groening
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef EMBEDDED_BOOTLOADER_PLAN_H_
+#define EMBEDDED_BOOTLOADER_PLAN_H_
+
+#include <stdint.h>
+#include "config.h"
+#include "embedded_bootloader.h"
+#include "part.h"
+
+/*
+ * Write planner
+ *
+ * Turns an image given as address ranges (in address order, not overlapping) into a
+ * schedule of data block packets:
+ *  - 0xFF runs of at least `blank` bytes are not sent, the target memory has to be erased
+ *    (with a part only in ranges that lie in memory with segment erase)
+ *  - gaps of up to `bridge` bytes are sent as 0xFF inside a packet instead of starting a new one
+ *  - packets start and end on multiples of `align` (write granularity of the target memory),
+ *    bytes outside the image are sent as 0xFF
+ *
+ * The cost model counts the frame, ACK and core response bytes on the line plus
+ * EBH_PLAN_COMMAND_TIME per packet and EBH_PLAN_BYTE_TIME per byte programmed.
+ * Gaps are bridged where sending them is cheaper than an extra packet.
+ */
+
+typedef struct {
+    uint32_t addr;
+    const uint8_t *data;
+    uint32_t length;
+} ebh_range;
+
+typedef struct {
+    uint32_t addr;
+    uint16_t length;
+} ebh_plan_packet;
+
+typedef struct {
+    uint16_t block;   // Data bytes per packet, 0: from the part's buffer or ebh_write_block_size() (asks the target), per address length
+    uint16_t align;   // Power of two, 1: packets start anywhere
+    uint16_t blank;   // 0: send 0xFF runs as well
+    uint16_t bridge;
+    const ebh_part *part; // 0: ranges are not checked
+} ebh_plan_options;
+
+typedef struct {
+    const ebh_range *ranges;
+    uint16_t range_count;
+    ebh_plan_packet *packets;
+    uint16_t max_packets;
+    uint16_t count;       // Packets planned
+    uint32_t bytes;       // Sent, including 0xFF fill
+    uint32_t skipped;     // Bytes of the 0xFF runs left out
+    uint32_t filled;      // Gap and alignment bytes sent as 0xFF
+    uint32_t time_us;     // Predicted time of the plan
+    uint32_t naive_us;    // Predicted time of writing every range as it is (ebh_write_region())
+} ebh_plan;
+
+void ebh_plan_defaults(ebh_plan_options *options, const ebh_part *part);  // Alignment of the part (EBH_PLAN_ALIGN if 0), EBH_PLAN_BLANK and the break even gap at the current baud rate
+uint32_t ebh_plan_packet_time(uint32_t addr, uint16_t length);  // Predicted us of one packet
+
+uint8_t ebh_plan_make(ebh_plan *plan, const ebh_range *ranges, uint16_t range_count, const ebh_plan_options *options,
+                      ebh_plan_packet *packets, uint16_t max_packets);
+uint8_t ebh_plan_write(const ebh_plan *plan);
+
+#endif /* EMBEDDED_BOOTLOADER_PLAN_H_ */
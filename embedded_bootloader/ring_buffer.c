@@ -0,0 +1,110 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Max Groening
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <stdint.h>
+#include "ring_buffer.h"
+
+
+/*
+ * head and tail run freely and are masked on access, so a full ring is
+ * (head - tail) == size and no slot is wasted.
+ */
+
+void ebh_ring_init(ebh_ring_buffer *ring, uint8_t *buffer, uint16_t size) {
+    ring->buffer = buffer;
+    ring->mask = size - 1;
+    ring->head = 0;
+    ring->tail = 0;
+}
+
+uint16_t ebh_ring_count(const ebh_ring_buffer *ring) {
+    return (uint16_t)(ring->head - ring->tail);
+}
+
+uint16_t ebh_ring_free(const ebh_ring_buffer *ring) {
+    return (uint16_t)(ring->mask + 1 - ebh_ring_count(ring));
+}
+
+uint8_t ebh_ring_put_char(ebh_ring_buffer *ring, uint8_t character) {
+    uint16_t head = ring->head;
+
+    if((uint16_t)(head - ring->tail) > ring->mask) {
+        return 0;
+    }
+    ring->buffer[head & ring->mask] = character;
+    EBH_MEMORY_BARRIER();  // Data has to be visible before the new head
+    ring->head = head + 1;
+    return 1;
+}
+
+uint16_t ebh_ring_put(ebh_ring_buffer *ring, const uint8_t *data, uint16_t length) {
+    uint16_t head = ring->head;
+    uint16_t space = ring->mask + 1 - (uint16_t)(head - ring->tail);
+    uint16_t i = 0;
+
+    if(length > space) {
+        length = space;
+    }
+    for(i = 0; i < length; i++) {
+        ring->buffer[(head + i) & ring->mask] = data[i];
+    }
+    EBH_MEMORY_BARRIER();
+    ring->head = head + length;
+    return length;
+}
+
+uint8_t ebh_ring_get_char(ebh_ring_buffer *ring, uint8_t *character) {
+    uint16_t tail = ring->tail;
+
+    if(ring->head == tail) {
+        return 0;
+    }
+    EBH_MEMORY_BARRIER();  // Read the data only after seeing the head that published it
+    *character = ring->buffer[tail & ring->mask];
+    EBH_MEMORY_BARRIER();  // The slot may be reused once tail moves on
+    ring->tail = tail + 1;
+    return 1;
+}
+
+uint16_t ebh_ring_get(ebh_ring_buffer *ring, uint8_t *data, uint16_t length) {
+    uint16_t tail = ring->tail;
+    uint16_t count = (uint16_t)(ring->head - tail);
+    uint16_t i = 0;
+
+    if(length > count) {
+        length = count;
+    }
+    EBH_MEMORY_BARRIER();
+    for(i = 0; i < length; i++) {
+        data[i] = ring->buffer[(tail + i) & ring->mask];
+    }
+    EBH_MEMORY_BARRIER();
+    ring->tail = tail + length;
+    return length;
+}
+
+void ebh_ring_clear(ebh_ring_buffer *ring) {
+    ring->tail = ring->head;
+}
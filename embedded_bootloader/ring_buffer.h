@@ -0,0 +1,60 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Max Groening
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef EMBEDDED_BOOTLOADER_RING_BUFFER_H_
+#define EMBEDDED_BOOTLOADER_RING_BUFFER_H_
+
+#include <stdint.h>
+#include "config.h"
+
+/*
+ * Lock-free single-producer/single-consumer ring buffer
+ *
+ * One context (e.g. the application) only calls the put functions, the other one
+ * (e.g. an ISR) only the get functions. head is written by the producer only, tail by
+ * the consumer only; the size has to be a power of two (up to 32768).
+ */
+
+typedef struct {
+    volatile uint8_t *buffer;
+    uint16_t mask;
+    volatile uint16_t head;
+    volatile uint16_t tail;
+} ebh_ring_buffer;
+
+void ebh_ring_init(ebh_ring_buffer *ring, uint8_t *buffer, uint16_t size);
+uint16_t ebh_ring_count(const ebh_ring_buffer *ring);
+uint16_t ebh_ring_free(const ebh_ring_buffer *ring);
+
+/* Producer side */
+uint8_t ebh_ring_put_char(ebh_ring_buffer *ring, uint8_t character);  // Returns 0 if the ring is full
+uint16_t ebh_ring_put(ebh_ring_buffer *ring, const uint8_t *data, uint16_t length);  // Returns the number of bytes stored
+
+/* Consumer side */
+uint8_t ebh_ring_get_char(ebh_ring_buffer *ring, uint8_t *character);  // Returns 0 if the ring is empty
+uint16_t ebh_ring_get(ebh_ring_buffer *ring, uint8_t *data, uint16_t length);  // Returns the number of bytes read
+void ebh_ring_clear(ebh_ring_buffer *ring);
+
+#endif /* EMBEDDED_BOOTLOADER_RING_BUFFER_H_ */
@@ -0,0 +1,105 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Max Groening
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+/*
+ * Host side CRC benchmark (Linux / POSIX)
+ *
+ * Checks that all CRC CCITT backends agree and prints the cost per byte of each.
+ * Build with -DEBH_CRC_IMPLEMENTATION=EBH_CRC_SLICE_BY_8 so all tables are linked.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "embedded_bootloader/crc_ccitt.h"
+#include "embedded_bootloader/tests/test_support.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_UNIT  "cycles"
+static uint64_t bench_now(void) {
+    return __rdtsc();
+}
+#else
+#define BENCH_UNIT  "ns"
+static uint64_t bench_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+#endif
+
+#define BENCH_ROUNDS  20000
+
+typedef uint16_t (*crc_backend)(uint16_t crc, const uint8_t *data, size_t length);
+
+uint16_t test_pass = 0;
+uint16_t test_fail = 0;
+uint16_t test_total = 0;
+
+static void bench(const char *name, crc_backend backend) {
+    volatile uint16_t sink = 0;
+    uint_fast32_t i = 0;
+    uint64_t start = bench_now();
+    for(i = 0; i < BENCH_ROUNDS; i++) {
+        sink = backend(0xFFFF, payload2, sizeof(payload2));
+    }
+    uint64_t stop = bench_now();
+    (void)sink;
+    printf("%-12s %6.2f %s/byte\n", name, (double)(stop - start) / ((double)BENCH_ROUNDS * sizeof(payload2)), BENCH_UNIT);
+}
+
+int main(void) {
+    const uint8_t check_string[] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+    uint16_t reference = ebh_crc_update_bitwise(0xFFFF, payload3, sizeof(payload3));
+    size_t length = 0;
+
+    /* Known answer for CRC-16/CCITT-FALSE */
+    check("known answer", ebh_crc_update_bitwise(0xFFFF, check_string, sizeof(check_string)), 0x29B1);
+
+    /* All backends agree for every length (covers the slice tails) */
+    for(length = 0; length <= 64; length++) {
+        uint16_t expected = ebh_crc_update_bitwise(0xFFFF, payload3, length);
+        check("table", ebh_crc_update_table(0xFFFF, payload3, length), expected);
+        check("slice-by-4", ebh_crc_update_slice_by_4(0xFFFF, payload3, length), expected);
+        check("slice-by-8", ebh_crc_update_slice_by_8(0xFFFF, payload3, length), expected);
+    }
+
+    /* Stateful API split over several blocks */
+    ebh_crc_init();
+    ebh_crc(payload3[0]);
+    ebh_crc_block(&payload3[1], 200);
+    ebh_crc_block(&payload3[201], sizeof(payload3) - 201);
+    check("stateful", ebh_crc_result(), reference);
+
+    bench("bitwise", ebh_crc_update_bitwise);
+    bench("table", ebh_crc_update_table);
+    bench("slice-by-4", ebh_crc_update_slice_by_4);
+    bench("slice-by-8", ebh_crc_update_slice_by_8);
+
+    printf("%u/%u tests passed\n", test_pass, test_total);
+    return test_fail ? 1 : 0;
+}
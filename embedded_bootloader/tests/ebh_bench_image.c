@@ -0,0 +1,140 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Max Groening
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+/*
+ * Host side image parser benchmark (Linux / POSIX)
+ *
+ * Parses a 512 kB image as Intel HEX and TI-TXT file, from memory in 4 kB pieces and from
+ * a file with ebh_posix_read_source(), and prints the parsing throughput and how many data
+ * blocks the image writer makes of the 16 byte records.
+ *
+ * Link devices/bsp_posix.c instead of sim_bsp.c.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "embedded_bootloader/embedded_bootloader.h"
+#include "embedded_bootloader/bootloader_protocol.h"
+#include "embedded_bootloader/image.h"
+#include "embedded_bootloader/devices/bsp_posix.h"
+#include "embedded_bootloader/tests/test_support.h"
+
+#define IMAGE_SIZE    0x80000u
+#define TEXT_SIZE     0x200000u
+#define BENCH_PIECE   4096u
+#define BENCH_ROUNDS  10
+
+uint16_t test_pass = 0;
+uint16_t test_fail = 0;
+uint16_t test_total = 0;
+
+static uint8_t image[IMAGE_SIZE];
+static uint8_t decoded[IMAGE_SIZE];
+static char text[TEXT_SIZE];
+static ebh_image_writer writer;
+
+static uint64_t bench_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static uint8_t memory_sink(void *context, uint32_t addr, const uint8_t *data, uint16_t length) {
+    if(addr + length > IMAGE_SIZE) {
+        return EBH_UART_ERROR_UNKNOWN_ERROR;
+    }
+    memcpy(&decoded[addr], data, length);
+    return 0;
+}
+
+static void bench(const char *name, uint32_t length) {
+    ebh_image_parser parser;
+    char path[] = "/tmp/ebh_bench_imageXXXXXX";
+    uint64_t start = 0;
+    uint64_t memory_ns = 0;
+    uint64_t file_ns = 0;
+    uint32_t offset = 0;
+    uint8_t round = 0;
+    uint8_t status = 0;
+    int fd = -1;
+
+    // From memory
+    start = bench_now();
+    for(round = 0; round < BENCH_ROUNDS; round++) {
+        ebh_image_init(&parser, ebh_image_auto, memory_sink, 0);
+        for(offset = 0; offset < length; offset += BENCH_PIECE) {
+            ebh_image_feed(&parser, (const uint8_t *)&text[offset], (length - offset < BENCH_PIECE) ? length - offset : BENCH_PIECE);
+        }
+        status = ebh_image_finish(&parser);
+    }
+    memory_ns = (bench_now() - start) / BENCH_ROUNDS;
+    check(name, status, EBH_UART_ERROR_ACK);
+    check("memory data", memcmp(decoded, image, IMAGE_SIZE), 0);
+
+    // From a file, merged into 256 byte blocks
+    fd = mkstemp(path);
+    check("file", (fd >= 0) && (write(fd, text, length) == (ssize_t)length), 1);
+    memset(decoded, 0, sizeof(decoded));
+    lseek(fd, 0, SEEK_SET);
+    start = bench_now();
+    ebh_image_writer_init(&writer, 256, memory_sink, 0);
+    ebh_image_init(&parser, ebh_image_auto, ebh_image_writer_sink, &writer);
+    status = ebh_image_load(&parser, ebh_posix_read_source, &fd);
+    if(status == EBH_UART_ERROR_ACK) {
+        status = ebh_image_writer_flush(&writer);
+    }
+    file_ns = bench_now() - start;
+    check("file status", status, EBH_UART_ERROR_ACK);
+    check("file data", memcmp(decoded, image, IMAGE_SIZE), 0);
+    check("file blocks", writer.blocks, IMAGE_SIZE / 256);
+    close(fd);
+    unlink(path);
+
+    printf("%-9s %7u byte: memory %6.1f MB/s, file (%u byte reads) %6.1f MB/s, %u records -> %u blocks\n",
+           name, length, length * 1e3 / memory_ns, EBH_IMAGE_READ_SIZE, length * 1e3 / file_ns,
+           IMAGE_SIZE / 16, writer.blocks);
+}
+
+int main(void) {
+    uint32_t length = 0;
+    uint32_t i = 0;
+
+    for(i = 0; i < IMAGE_SIZE; i++) {
+        image[i] = (uint8_t)(i * 13 + (i >> 9));
+    }
+
+    length = test_image_hex(text, 0, image, IMAGE_SIZE, 16, 1);
+    bench("Intel HEX", length);
+    length = test_image_txt(text, 0, image, IMAGE_SIZE, 16, 1);
+    bench("TI-TXT", length);
+
+    printf("%u/%u tests passed\n", test_pass, test_total);
+    return test_fail ? 1 : 0;
+}
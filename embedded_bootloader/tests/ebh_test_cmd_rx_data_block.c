@@ -28,6 +28,7 @@
 
 #include "embedded_bootloader/embedded_bootloader.h"
 #include "embedded_bootloader/bootloader_protocol.h"
+#include "embedded_bootloader/link.h"
 #include "embedded_bootloader/tests/test_support.h"
 
 
@@ -47,16 +48,16 @@ void main(void) {
 #endif
 
     ebh_uart_poll_init();
-    ebh_uart_poll_configure_9600_baud();
-
-#ifdef TEST_MSP432
-    ebh_sync_character();
-#endif
 
+#ifdef TEST_MSP430
+    ebh_uart_poll_configure_9600_baud();
     ebh_change_baud_rate(0x06);
     ebh_delay_between_commands();
-
     ebh_uart_poll_configure_115200_baud();
+#endif
+#ifdef TEST_MSP432
+    ebh_link_sync(115200);
+#endif
 
     /* Locked BSL shall respond with BSL LOCKED  */
     status = ebh_rx_data_block(0x1000, payload0, sizeof(payload0));
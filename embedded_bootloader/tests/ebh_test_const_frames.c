@@ -0,0 +1,72 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Max Groening
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+/*
+ * Host side test (Linux / POSIX)
+ *
+ * Every precomputed frame in bsl_frame.c has to match the output of the runtime framer.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "embedded_bootloader/bsl_frame.h"
+#include "embedded_bootloader/bootloader_protocol.h"
+
+uint16_t test_pass = 0;
+uint16_t test_fail = 0;
+uint16_t test_total = 0;
+
+static void check_frame(const char *name, const uint8_t *table, uint16_t size, uint8_t cmd, uint8_t a_len, uint8_t a0) {
+    uint8_t frame[EBH_MAX_FRAME_SIZE];
+    uint16_t length = ebh_build_frame(frame, sizeof(frame), cmd, a_len, a0, 0, 0, 0, 0, 0);
+
+    if((length != size) || memcmp(frame, table, size)) {
+        printf("FAIL %s\n", name);
+        test_fail++;
+    } else {
+        test_pass++;
+    }
+    test_total++;
+}
+
+int main(void) {
+    uint8_t baud_rate = 0;
+
+    check_frame("tx_bsl_version", ebh_frame_tx_bsl_version, sizeof(ebh_frame_tx_bsl_version), EBH_CMD_TX_BSL_VERSION, 0, 0);
+    check_frame("tx_buffer_size", ebh_frame_tx_buffer_size, sizeof(ebh_frame_tx_buffer_size), EBH_CMD_TX_BUFFER_SIZE, 0, 0);
+    check_frame("mass_erase", ebh_frame_mass_erase, sizeof(ebh_frame_mass_erase), EBH_CMD_MASS_ERASE, 0, 0);
+    check_frame("reboot_reset", ebh_frame_reboot_reset, sizeof(ebh_frame_reboot_reset), EBH_CMD_REBOOT_RESET, 0, 0);
+    check_frame("unlock_and_lock_info", ebh_frame_unlock_and_lock_info, sizeof(ebh_frame_unlock_and_lock_info), EBH_CMD_UNLOCK_AND_LOCK_INFO, 0, 0);
+
+    for(baud_rate = EBH_UART_BAUD_RATE_9600; baud_rate <= EBH_UART_BAUD_RATE_115200; baud_rate++) {
+        check_frame("change_baud_rate", ebh_frame_change_baud_rate[baud_rate - EBH_UART_BAUD_RATE_9600], EBH_CONST_FRAME_2_SIZE,
+                    EBH_CMD_CHANGE_BAUD_RATE, 1, baud_rate);
+    }
+
+    printf("%u/%u tests passed\n", test_pass, test_total);
+    return test_fail ? 1 : 0;
+}
@@ -0,0 +1,185 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Max Groening
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+/*
+ * Host side test (Linux / POSIX)
+ *
+ * ELF32 loader (elf.h) on the simulated target: segments placed at their physical address,
+ * .bss and empty segments skipped, data sent straight from the file, the command variant per
+ * address for MSP432 and MSP430 (20 bit), and malformed or foreign files.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "embedded_bootloader/embedded_bootloader.h"
+#include "embedded_bootloader/bootloader_protocol.h"
+#include "embedded_bootloader/elf.h"
+#include "embedded_bootloader/tests/test_support.h"
+#include "embedded_bootloader/tests/sim_bsp.h"
+
+#define EM_ARM     40
+#define EM_MSP430  105
+#define PT_LOAD    1
+#define PT_NOTE    4
+#define FILE_SIZE  0x20000u
+
+uint16_t test_pass = 0;
+uint16_t test_fail = 0;
+uint16_t test_total = 0;
+
+static sim_target target;
+static uint8_t text[0x9000];
+static uint8_t data[0x300];
+static uint8_t ram[0x200];
+static uint8_t file[FILE_SIZE];
+
+static void start(ebh_device device) {
+    sim_target_init(&target, device);
+    sim_bsp_attach(&target);
+    ebh_set_transport(&ebh_transport_uart_poll);
+    ebh_set_baud(115200);
+    target.baud = 115200;
+    target.locked = 0;
+}
+
+static void msp432(void) {
+    // .text, .data (runs at 0x20000000, loaded behind .text), .bss, an empty segment, a note and code copied to SRAM
+    const test_elf_segment segments[] = {
+        {PT_LOAD, 0x00000000, 0x00000000, text, sizeof(text), sizeof(text)},
+        {PT_LOAD, 0x20000000, sizeof(text), data, sizeof(data), sizeof(data)},
+        {PT_LOAD, 0x20000300, 0x20000300, 0, 0, 0x1000},
+        {PT_LOAD, 0x00010000, 0x00010000, 0, 0, 0},
+        {PT_NOTE, 0, 0, data, 16, 16},
+        {PT_LOAD, 0x20001000, 0x20001000, ram, sizeof(ram), sizeof(ram)},
+    };
+    uint32_t size = test_elf(file, EM_ARM, segments, sizeof(segments) / sizeof(segments[0]));
+    ebh_elf elf;
+    ebh_elf_segment segment;
+    uint32_t blocks = 0;
+
+    check("open", ebh_elf_open(&elf, file, size, ebh_device_msp432), EBH_UART_ERROR_ACK);
+    check("text", ebh_elf_next(&elf, &segment), 1);
+    check("text addr", segment.addr, 0);
+    check("text length", segment.length, sizeof(text));
+    check("text in place", segment.data == &file[52 + 6 * 32], 1);
+    check("data", ebh_elf_next(&elf, &segment), 1);
+    check("data load address", segment.addr, sizeof(text));
+    check("ram", ebh_elf_next(&elf, &segment), 1);
+    check("ram addr", segment.addr, 0x20001000);
+    check("end", ebh_elf_next(&elf, &segment), 0);
+
+    start(ebh_device_msp432);
+    blocks = (sizeof(text) + EBH_DEFAULT_DATA_BLOCK - 1) / EBH_DEFAULT_DATA_BLOCK + (sizeof(data) + EBH_DEFAULT_DATA_BLOCK - 1) / EBH_DEFAULT_DATA_BLOCK;
+    check("write", ebh_elf_write(file, size, ebh_device_msp432), EBH_UART_ERROR_ACK);
+    check("write text", memcmp(sim_target_memory(&target, 0), text, sizeof(text)), 0);
+    check("write data", memcmp(sim_target_memory(&target, sizeof(text)), data, sizeof(data)), 0);
+    check("write ram", memcmp(sim_target_memory(&target, 0x20001000), ram, sizeof(ram)), 0);
+    check("bss untouched", *sim_target_memory(&target, 0x20000300), 0xFF);
+    check("24 bit frames", target.commands[EBH_CMD_RX_DATA_BLOCK], blocks);
+    check("32 bit frames", target.commands[EBH_CMD_RX_DATA_BLOCK_32], (sizeof(ram) + EBH_DEFAULT_DATA_BLOCK - 1) / EBH_DEFAULT_DATA_BLOCK);
+
+    check("wrong machine", ebh_elf_write(file, size, ebh_device_msp430_fram), EBH_UART_ERROR_IMAGE_FORMAT);
+    check("truncated data", ebh_elf_write(file, size - 0x100, ebh_device_msp432), EBH_UART_ERROR_IMAGE_FORMAT);
+    check("truncated headers", ebh_elf_write(file, 52 + 5 * 32, ebh_device_msp432), EBH_UART_ERROR_IMAGE_FORMAT);
+    check("truncated header", ebh_elf_write(file, 40, ebh_device_msp432), EBH_UART_ERROR_IMAGE_FORMAT);
+}
+
+static void msp430(void) {
+    // Large memory model: code below and above 64 kB
+    const test_elf_segment segments[] = {
+        {PT_LOAD, 0x4400, 0x4400, text, 0x8000, 0x8000},
+        {PT_LOAD, 0x1C00, 0x4400 + 0x8000, data, sizeof(data), sizeof(data)},
+        {PT_LOAD, 0x10000, 0x10000, ram, sizeof(ram), sizeof(ram)},
+    };
+    const test_elf_segment beyond[] = {
+        {PT_LOAD, 0xFFF00, 0xFFF00, ram, sizeof(ram), sizeof(ram)},
+    };
+    uint32_t size = test_elf(file, EM_MSP430, segments, sizeof(segments) / sizeof(segments[0]));
+
+    start(ebh_device_msp430_flash);
+    check("msp430 write", ebh_elf_write(file, size, ebh_device_msp430_flash), EBH_UART_ERROR_ACK);
+    check("msp430 text", memcmp(sim_target_memory(&target, 0x4400), text, 0x8000), 0);
+    check("msp430 data", memcmp(sim_target_memory(&target, 0xC400), data, sizeof(data)), 0);
+    check("msp430 above 64 kB", memcmp(sim_target_memory(&target, 0x10000), ram, sizeof(ram)), 0);
+    check("msp430 32 bit frames", target.commands[EBH_CMD_RX_DATA_BLOCK_32], 0);
+    check("msp430 on msp432", ebh_elf_write(file, size, ebh_device_msp432), EBH_UART_ERROR_IMAGE_FORMAT);
+
+    size = test_elf(file, EM_MSP430, beyond, 1);
+    start(ebh_device_msp430_flash);
+    check("beyond 20 bit", ebh_elf_write(file, size, ebh_device_msp430_flash), EBH_UART_ERROR_IMAGE_ADDRESS);
+    check("beyond 20 bit nothing sent", target.commands[EBH_CMD_RX_DATA_BLOCK], 0);
+}
+
+static void malformed(void) {
+    const test_elf_segment segments[] = {
+        {PT_LOAD, 0x4400, 0x4400, text, 0x100, 0x100},
+    };
+    uint32_t size = test_elf(file, EM_MSP430, segments, 1);
+
+    check("valid", ebh_elf_write(file, size, ebh_device_msp430_fram), EBH_UART_ERROR_ACK);
+    file[4] = 2;
+    check("64 bit", ebh_elf_write(file, size, ebh_device_msp430_fram), EBH_UART_ERROR_IMAGE_FORMAT);
+    file[4] = 1;
+    file[5] = 2;
+    check("big endian", ebh_elf_write(file, size, ebh_device_msp430_fram), EBH_UART_ERROR_IMAGE_FORMAT);
+    file[5] = 1;
+    file[16] = 1;
+    check("relocatable", ebh_elf_write(file, size, ebh_device_msp430_fram), EBH_UART_ERROR_IMAGE_FORMAT);
+    file[16] = 2;
+    file[0] = 0;
+    check("magic", ebh_elf_write(file, size, ebh_device_msp430_fram), EBH_UART_ERROR_IMAGE_FORMAT);
+    file[0] = 0x7F;
+    file[52 + 4 + 3] = 0x80;  // p_offset far beyond the file
+    check("offset", ebh_elf_write(file, size, ebh_device_msp430_fram), EBH_UART_ERROR_IMAGE_FORMAT);
+    file[52 + 4 + 3] = 0;
+    file[28 + 3] = 0xFF;  // e_phoff far beyond the file
+    check("phoff", ebh_elf_write(file, size, ebh_device_msp430_fram), EBH_UART_ERROR_IMAGE_FORMAT);
+    file[28 + 3] = 0;
+    check("valid again", ebh_elf_write(file, size, ebh_device_msp430_fram), EBH_UART_ERROR_ACK);
+}
+
+int main(void) {
+    uint32_t i = 0;
+
+    for(i = 0; i < sizeof(text); i++) {
+        text[i] = (uint8_t)(i * 7 + (i >> 8));
+    }
+    for(i = 0; i < sizeof(data); i++) {
+        data[i] = (uint8_t)(i ^ 0xA5);
+    }
+    for(i = 0; i < sizeof(ram); i++) {
+        ram[i] = (uint8_t)(i * 3 + 1);
+    }
+
+    msp432();
+    msp430();
+    start(ebh_device_msp430_fram);
+    malformed();
+
+    printf("%u/%u tests passed\n", test_pass, test_total);
+    return test_fail ? 1 : 0;
+}
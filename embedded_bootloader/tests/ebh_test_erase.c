@@ -0,0 +1,253 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Max Groening
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+/*
+ * Host side test (Linux / POSIX)
+ *
+ * Erase planner (erase.h) on the MSP430F5529 memory map: segment selection, blank segments,
+ * the choice between segment and mass erase, protected memory and the schedule limits, and a small update, a full image and a mostly
+ * erased target on the simulated target, comparing the predicted with the simulated time.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "embedded_bootloader/embedded_bootloader.h"
+#include "embedded_bootloader/bootloader_protocol.h"
+#include "embedded_bootloader/erase.h"
+#include "embedded_bootloader/tests/test_support.h"
+#include "embedded_bootloader/tests/sim_bsp.h"
+
+#define MAIN_START     0x4400u
+#define MAIN_END       0x24400u
+#define INFO_START     0x1800u
+#define MAX_SEGMENTS   256
+
+uint16_t test_pass = 0;
+uint16_t test_fail = 0;
+uint16_t test_total = 0;
+
+static sim_target target;
+static uint8_t image[0xC000];
+static uint32_t segments[MAX_SEGMENTS];
+static const ebh_part *const part = &ebh_part_msp430f5529;
+
+static const ebh_memory odd_memory[] = {
+    {MAIN_START, MAIN_END, 384, ebh_memory_main, EBH_MEMORY_WRITE | EBH_MEMORY_ERASE}
+};
+static const ebh_part odd = {"odd", ebh_device_msp430_flash, odd_memory, 1, 1, 260};
+
+static void start(void) {
+    sim_target_init(&target, ebh_device_msp430_flash);
+    sim_bsp_attach(&target);
+    ebh_set_transport(&ebh_transport_uart_poll);
+    ebh_set_baud(115200);
+    target.baud = 115200;
+    target.locked = 0;
+}
+
+static void range(ebh_range *r, uint32_t addr, uint32_t length) {
+    r->addr = addr;
+    r->data = image;
+    r->length = length;
+}
+
+static uint8_t blank_4600(void *context, uint32_t addr, uint16_t length) {
+    (*(uint16_t *)context)++;
+    return (addr == 0x4600) && (length == 512);
+}
+
+static uint8_t close_to(uint64_t predicted_us, uint64_t simulated_ns) {
+    return (predicted_us * 1000 > simulated_ns * 9 / 10) && (predicted_us * 1000 < simulated_ns * 11 / 10);
+}
+
+static void rules(void) {
+    ebh_erase_options o = {0, 0, 0};
+    ebh_erase_plan plan;
+    ebh_range ranges[3];
+    uint32_t segment_us = 0;
+    uint16_t calls = 0;
+    uint16_t n = 0;
+
+    start();
+    segment_us = ebh_erase_segment_time(MAIN_START);
+
+    // Only the segments the image touches, a segment shared by two ranges once
+    range(&ranges[0], 0x4400, 0x300);
+    range(&ranges[1], 0x4700, 0x10);
+    range(&ranges[2], 0x5000, 0x10);
+    check("small", ebh_erase_make(&plan, ranges, 3, part, &o, segments, MAX_SEGMENTS), EBH_UART_ERROR_ACK);
+    check("small strategy", plan.strategy, ebh_erase_segments);
+    check("small count", plan.count, 3);
+    check("small segments", (segments[0] == 0x4400) && (segments[1] == 0x4600) && (segments[2] == 0x5000), 1);
+    check("small time", plan.time_us, 3 * segment_us);
+    check("small naive", plan.naive_us, 7 * segment_us);
+
+    // Known blank segments are left out
+    o.blank = blank_4600;
+    o.context = &calls;
+    check("blank", ebh_erase_make(&plan, ranges, 3, part, &o, segments, MAX_SEGMENTS), EBH_UART_ERROR_ACK);
+    check("blank count", plan.count, 2);
+    check("blank skipped", plan.blank, 1);
+    check("blank calls", calls, 3);
+    o.blank = 0;
+
+    // Break even between segment and mass erase
+    n = ebh_erase_mass_time() / segment_us;
+    range(&ranges[0], MAIN_START, n * 512u);
+    check("break even", ebh_erase_make(&plan, ranges, 1, part, &o, segments, MAX_SEGMENTS), EBH_UART_ERROR_ACK);
+    check("break even segments", plan.strategy, ebh_erase_segments);
+    range(&ranges[0], MAIN_START, (n + 1) * 512u);
+    check("above", ebh_erase_make(&plan, ranges, 1, part, &o, segments, MAX_SEGMENTS), EBH_UART_ERROR_ACK);
+    check("above mass", plan.strategy, ebh_erase_mass);
+    check("above count", plan.count, 0);
+    check("above time", plan.time_us, ebh_erase_mass_time());
+
+    // Info memory is not cleared by MASS_ERASE, RAM needs no erase
+    range(&ranges[0], INFO_START + 0x80, 0x10);
+    range(&ranges[1], 0x2400, 0x100);
+    range(&ranges[2], MAIN_START, 0x8000);
+    check("info", ebh_erase_make(&plan, ranges, 3, part, &o, segments, MAX_SEGMENTS), EBH_UART_ERROR_ACK);
+    check("info mass", plan.strategy, ebh_erase_mass);
+    check("info count", plan.count, 1);
+    check("info segment", segments[0], INFO_START + 0x80);
+    check("info time", plan.time_us, ebh_erase_mass_time() + ebh_erase_segment_time(INFO_START));
+    o.keep = 1;
+    check("keep", ebh_erase_make(&plan, ranges, 3, part, &o, segments, MAX_SEGMENTS), EBH_UART_ERROR_ACK);
+    check("keep segments", plan.strategy, ebh_erase_segments);
+    check("keep count", plan.count, 1 + 0x8000 / 512);
+    o.keep = 0;
+    check("ram", ebh_erase_make(&plan, &ranges[1], 1, part, &o, segments, MAX_SEGMENTS), EBH_UART_ERROR_ACK);
+    check("ram none", plan.strategy, ebh_erase_none);
+    check("ram naive", plan.naive_us, 0);
+
+    // Invalid input
+    range(&ranges[0], 0x4400, 0x300);
+    range(&ranges[1], 0x4400, 0x10);
+    check("overlap", ebh_erase_make(&plan, ranges, 2, part, &o, segments, MAX_SEGMENTS), EBH_UART_ERROR_PLAN_RANGES);
+    range(&ranges[0], 0x1000, 0x10);
+    check("bsl", ebh_erase_make(&plan, ranges, 1, part, &o, segments, MAX_SEGMENTS), EBH_UART_ERROR_PART_ADDRESS);
+    range(&ranges[0], 0x24400 - 0x10, 0x20);
+    check("beyond main", ebh_erase_make(&plan, ranges, 1, part, &o, segments, MAX_SEGMENTS), EBH_UART_ERROR_PART_ADDRESS);
+    range(&ranges[0], 0x4400, 0x300);
+    check("segment power of two", ebh_erase_make(&plan, ranges, 1, &odd, &o, segments, MAX_SEGMENTS), EBH_UART_ERROR_PLAN_RANGES);
+    o.keep = 1;
+    check("full", ebh_erase_make(&plan, ranges, 1, part, &o, segments, 1), EBH_UART_ERROR_PLAN_FULL);
+    check("full count", plan.count, 1);
+}
+
+/* Runs the plan for the ranges on a target programmed with 0x00 and checks the erased memory */
+static void session(const char *name, const ebh_range *ranges, uint16_t count, ebh_erase_strategy strategy) {
+    ebh_erase_options o = {0, 0, 0};
+    ebh_erase_plan plan;
+    uint64_t start_ns = 0;
+    uint64_t plan_ns = 0;
+    uint64_t naive_ns = 0;
+    uint32_t addr = 0;
+    uint32_t dirty = 0;
+    int32_t saved = 0;
+    uint16_t i = 0;
+
+    start();
+    memset(sim_target_memory(&target, 0), 0x00, MAIN_END);
+    check(name, ebh_erase_make(&plan, ranges, count, part, &o, segments, MAX_SEGMENTS), EBH_UART_ERROR_ACK);
+    check("strategy", plan.strategy, strategy);
+    start_ns = sim_bsp_time_ns;
+    check("run", ebh_erase_run(&plan, ebh_device_msp430_flash, &saved), EBH_UART_ERROR_ACK);
+    plan_ns = sim_bsp_time_ns - start_ns;
+    for(i = 0; i < count; i++) {
+        for(addr = ranges[i].addr; addr < ranges[i].addr + ranges[i].length; addr++) {
+            dirty += *sim_target_memory(&target, addr) != 0xFF;
+        }
+    }
+    check("erased", dirty, 0);
+    if(strategy == ebh_erase_segments) {
+        check("outside kept", *sim_target_memory(&target, ranges[count - 1].addr + ranges[count - 1].length + 512), 0x00);
+    }
+    check("saved", (saved > (int32_t)(plan.naive_us - plan_ns / 1000) - 10) && (saved < (int32_t)(plan.naive_us - plan_ns / 1000) + 10), 1);
+    check("prediction", close_to(plan.time_us, plan_ns), 1);
+
+    // Every segment from the lowest to the highest image address
+    start();
+    start_ns = sim_bsp_time_ns;
+    for(addr = ranges[0].addr & ~511u; addr < ranges[count - 1].addr + ranges[count - 1].length; addr += 512) {
+        ebh_erase_segment(addr);
+    }
+    naive_ns = sim_bsp_time_ns - start_ns;
+    check("naive prediction", close_to(plan.naive_us, naive_ns), 1);
+
+    printf("%-8s %3u segments %6.0f ms (predicted %6.0f ms) naive, %s %2u segments %5.0f ms (predicted %5.0f ms), saved %5.0f ms\n",
+           name, target.commands[EBH_CMD_ERASE_SEGMENT], naive_ns / 1e6, plan.naive_us / 1e3,
+           (plan.strategy == ebh_erase_mass) ? "mass +" : "      ", plan.count, plan_ns / 1e6, plan.time_us / 1e3, saved / 1e3);
+}
+
+static void sessions(void) {
+    ebh_range ranges[3];
+
+    // Patch of a few functions and a table far behind them
+    range(&ranges[0], 0x4400, 0x1C0);
+    range(&ranges[1], 0x5200, 0x100);
+    range(&ranges[2], 0x9000, 0x40);
+    session("update", ranges, 3, ebh_erase_segments);
+
+    // Full image with the vectors
+    range(&ranges[0], 0x4400, 0xB000);
+    range(&ranges[1], 0xFF80, 0x80);
+    session("full", ranges, 2, ebh_erase_mass);
+}
+
+/* The target is erased except for one segment, CRC_CHECK finds it */
+static void mostly_erased(void) {
+    ebh_erase_options o = {0, ebh_erase_blank_crc, 0};
+    ebh_erase_plan plan;
+    ebh_range ranges[1];
+    int32_t saved = 0;
+
+    start();
+    memset(sim_target_memory(&target, 0x5000), 0x00, 512);
+    range(&ranges[0], 0x4400, 0x2000);
+    check("crc", ebh_erase_make(&plan, ranges, 1, part, &o, segments, MAX_SEGMENTS), EBH_UART_ERROR_ACK);
+    check("crc checks", target.commands[EBH_CMD_CRC_CHECK], 16);
+    check("crc strategy", plan.strategy, ebh_erase_segments);
+    check("crc count", plan.count, 1);
+    check("crc segment", segments[0], 0x5000);
+    check("crc blank", plan.blank, 15);
+    check("crc run", ebh_erase_run(&plan, ebh_device_msp430_flash, &saved), EBH_UART_ERROR_ACK);
+    check("crc erased", *sim_target_memory(&target, 0x51FF), 0xFF);
+
+    // Nothing left to erase
+    check("crc again", ebh_erase_make(&plan, ranges, 1, part, &o, segments, MAX_SEGMENTS), EBH_UART_ERROR_ACK);
+    check("crc none", plan.strategy, ebh_erase_none);
+}
+
+int main(void) {
+    rules();
+    sessions();
+    mostly_erased();
+
+    printf("%u/%u tests passed\n", test_pass, test_total);
+    return test_fail ? 1 : 0;
+}
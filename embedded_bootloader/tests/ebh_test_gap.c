@@ -0,0 +1,168 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Max Groening
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+/*
+ * Host side test (Linux / POSIX)
+ *
+ * Gap between BSL commands on the simulated target: the fixed gap applied by the protocol
+ * layer, no gap after responses, calibration against a target that needs a minimum gap
+ * (per device family, locked BSL), and the throughput of a 64 kB write per policy.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "embedded_bootloader/embedded_bootloader.h"
+#include "embedded_bootloader/bootloader_protocol.h"
+#include "embedded_bootloader/gap.h"
+#include "embedded_bootloader/tests/test_support.h"
+#include "embedded_bootloader/tests/sim_bsp.h"
+
+#define IMAGE_SIZE  0x10000u
+
+uint16_t test_pass = 0;
+uint16_t test_fail = 0;
+uint16_t test_total = 0;
+
+static sim_target target;
+static uint8_t image[IMAGE_SIZE];
+
+static void start(ebh_device device, uint64_t gap_ns) {
+    ebh_retry_policy none = {0, 0, 0, 0, 0};
+
+    sim_target_init(&target, device);
+    sim_bsp_attach(&target);
+    ebh_set_transport(&ebh_transport_uart_poll);
+    ebh_set_retry_policy(&none);  // Lost frames shall show up
+    ebh_set_baud(115200);
+    target.baud = 115200;
+    target.gap_ns = gap_ns;
+}
+
+static void fixed(void) {
+    uint8_t version[4];
+    uint64_t start_ns = 0;
+
+    // Applied by the protocol layer before the next frame, once
+    start(ebh_device_msp430_flash, 0);
+    ebh_gap_set_policy(ebh_gap_fixed, ebh_device_msp430_flash);
+    check("fixed first", ebh_tx_bsl_version(ebh_device_msp430_flash, version), EBH_UART_ERROR_ACK);
+    start_ns = sim_bsp_time_ns;
+    check("fixed second", ebh_tx_bsl_version(ebh_device_msp430_flash, version), EBH_UART_ERROR_ACK);
+    check("fixed gap", sim_bsp_time_ns - start_ns >= EBH_DELAY_BETWEEN_COMMANDS * 1000ull, 1);
+    start_ns = sim_bsp_time_ns;
+    ebh_delay_between_commands();
+    ebh_delay_between_commands();
+    check("fixed explicit", sim_bsp_time_ns - start_ns, EBH_DELAY_BETWEEN_COMMANDS * 1000ull);
+
+    // No gap after a response, fixed after CHANGE_BAUD_RATE
+    ebh_gap_set_policy(ebh_gap_after_response, ebh_device_msp430_flash);
+    check("version", ebh_tx_bsl_version(ebh_device_msp430_flash, version), EBH_UART_ERROR_ACK);
+    start_ns = sim_bsp_time_ns;
+    ebh_delay_between_commands();
+    check("after response", sim_bsp_time_ns - start_ns, 0);
+    check("change baud rate", ebh_change_baud_rate(EBH_UART_BAUD_RATE_115200), EBH_UART_ERROR_ACK);
+    start_ns = sim_bsp_time_ns;
+    ebh_delay_between_commands();
+    check("after change", sim_bsp_time_ns - start_ns, EBH_DELAY_BETWEEN_COMMANDS * 1000ull);
+
+    // Fixed after a command without its core response
+    target.rx_count = 3;
+    target.rx_length = 200;  // Still collecting a frame with a corrupted length
+    check("timeout", ebh_tx_bsl_version(ebh_device_msp430_flash, version), EBH_UART_ERROR_TIME_OUT);
+    start_ns = sim_bsp_time_ns;
+    ebh_delay_between_commands();
+    check("after timeout", sim_bsp_time_ns - start_ns, EBH_DELAY_BETWEEN_COMMANDS * 1000ull);
+}
+
+static void calibrate(void) {
+    uint8_t version[11];
+    uint16_t gap = 0;
+
+    // The target needs 300 us after each answer, no gap loses the next frame
+    start(ebh_device_msp430_flash, 300000);
+    ebh_gap_set_policy(ebh_gap_after_response, ebh_device_msp430_flash);
+    check("too short first", ebh_tx_bsl_version(ebh_device_msp430_flash, version), EBH_UART_ERROR_ACK);
+    check("too short", ebh_tx_bsl_version(ebh_device_msp430_flash, version) != EBH_UART_ERROR_ACK, 1);
+    check("too short dropped", target.dropped > 0, 1);
+    ebh_resync();
+
+    check("calibrate", ebh_gap_calibrate(ebh_device_msp430_flash, 0x4400), EBH_UART_ERROR_ACK);
+    gap = ebh_gap_get(ebh_device_msp430_flash, EBH_CMD_TX_BSL_VERSION);
+    printf("MSP430 needs 300 us: learned %u us (TX_BSL_VERSION), %u us (CRC_CHECK), %u us (TX_BUFFER_SIZE), %u us (RX_DATA_BLOCK)\n",
+           gap, ebh_gap_get(ebh_device_msp430_flash, EBH_CMD_CRC_CHECK), ebh_gap_get(ebh_device_msp430_flash, EBH_CMD_TX_BUFFER_SIZE),
+           ebh_gap_get(ebh_device_msp430_flash, EBH_CMD_RX_DATA_BLOCK));
+    check("learned range", (gap >= 100) && (gap <= 300 + EBH_GAP_MARGIN), 1);
+    check("learned crc", ebh_gap_get(ebh_device_msp430_flash, EBH_CMD_CRC_CHECK) < EBH_DELAY_BETWEEN_COMMANDS, 1);
+    check("learned derived", ebh_gap_get(ebh_device_msp430_flash, EBH_CMD_RX_DATA_BLOCK) >= gap, 1);
+    check("change baud rate stays fixed", ebh_gap_get(ebh_device_msp430_flash, EBH_CMD_CHANGE_BAUD_RATE), EBH_DELAY_BETWEEN_COMMANDS);
+
+    ebh_gap_set_policy(ebh_gap_learned, ebh_device_msp430_flash);
+    target.dropped = 0;
+    check("learned version", ebh_tx_bsl_version(ebh_device_msp430_flash, version), EBH_UART_ERROR_ACK);
+    check("learned version again", ebh_tx_bsl_version(ebh_device_msp430_flash, version), EBH_UART_ERROR_ACK);
+    check("learned dropped", target.dropped, 0);
+
+    // Other family, locked BSL: its own table
+    start(ebh_device_msp432, 800000);
+    check("msp432 locked", target.locked, 1);
+    check("calibrate msp432", ebh_gap_calibrate(ebh_device_msp432, 0x20000000), EBH_UART_ERROR_ACK);
+    printf("MSP432 needs 800 us: learned %u us\n", ebh_gap_get(ebh_device_msp432, EBH_CMD_TX_BSL_VERSION));
+    check("msp432 learned", ebh_gap_get(ebh_device_msp432, EBH_CMD_TX_BSL_VERSION) > gap, 1);
+    check("msp430 kept", ebh_gap_get(ebh_device_msp430_flash, EBH_CMD_TX_BSL_VERSION), gap);
+    check("fram unknown", ebh_gap_get(ebh_device_msp430_fram, EBH_CMD_TX_BSL_VERSION), EBH_DELAY_BETWEEN_COMMANDS);
+}
+
+static void throughput(const char *name, ebh_gap_mode mode, uint64_t gap_ns) {
+    uint64_t start_ns = 0;
+
+    start(ebh_device_msp430_flash, gap_ns);
+    target.locked = 0;
+    ebh_gap_set_policy(mode, ebh_device_msp430_flash);
+    start_ns = sim_bsp_time_ns;
+    check(name, ebh_write_region(0x4400, image, IMAGE_SIZE), EBH_UART_ERROR_ACK);
+    check("memory", memcmp(sim_target_memory(&target, 0x4400), image, IMAGE_SIZE), 0);
+    printf("%-40s 64 kB in %.3f s, %5.0f byte/s\n", name, (sim_bsp_time_ns - start_ns) / 1e9, IMAGE_SIZE * 1e9 / (sim_bsp_time_ns - start_ns));
+}
+
+int main(void) {
+    uint32_t i = 0;
+
+    for(i = 0; i < IMAGE_SIZE; i++) {
+        image[i] = (uint8_t)(i * 5 + (i >> 8));
+    }
+
+    fixed();
+    calibrate();
+
+    throughput("fixed gap", ebh_gap_fixed, 0);
+    throughput("no gap after response", ebh_gap_after_response, 0);
+    throughput("fixed gap, target needs 300 us", ebh_gap_fixed, 300000);
+    throughput("learned gap, target needs 300 us", ebh_gap_learned, 300000);
+
+    printf("%u/%u tests passed\n", test_pass, test_total);
+    return test_fail ? 1 : 0;
+}
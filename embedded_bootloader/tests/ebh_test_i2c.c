@@ -0,0 +1,142 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Max Groening
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+/*
+ * Host side test (Linux / POSIX)
+ *
+ * Runs the I2C transport against the mock I2C bus of the simulated BSP with the simulated
+ * target behind it: a BSL session with a target that does not acknowledge while busy,
+ * one that stretches the clock instead (within and beyond the stretch limit), a bounded
+ * wait for a target that does not answer, and write throughput per bus speed compared
+ * with UART at 115200 baud.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "embedded_bootloader/embedded_bootloader.h"
+#include "embedded_bootloader/bootloader_protocol.h"
+#include "embedded_bootloader/tests/test_support.h"
+#include "embedded_bootloader/tests/sim_bsp.h"
+
+#define BULK_SIZE  8192u
+
+uint16_t test_pass = 0;
+uint16_t test_fail = 0;
+uint16_t test_total = 0;
+
+static sim_target target;
+static uint8_t bulk[BULK_SIZE];
+
+static void start(const ebh_transport *transport, uint32_t rate) {
+    sim_target_init(&target, ebh_device_msp432);
+    sim_bsp_attach(&target);
+    ebh_set_transport(transport);
+    ebh_set_baud(rate);
+    target.baud = rate;
+}
+
+static void session(uint8_t stretch) {
+    uint8_t version[10];
+    uint16_t crc = 0;
+
+    start(&ebh_transport_i2c, 400000);
+    sim_bsp_i2c_stretch = stretch;
+
+    check("locked", ebh_rx_data_block_32(0x20001080, payload0, sizeof(payload0)), EBH_CORE_MSG_BSL_LOCKED);
+    check("password", ebh_rx_password_32(password_empty_msp432), EBH_CORE_MSG_OPERATION_SUCCESSFUL);
+    check("bsl version", ebh_tx_bsl_version(ebh_device_msp432, version), EBH_UART_ERROR_ACK);
+    check("rx data block 513", ebh_rx_data_block_32(0x20001080, payload3, sizeof(payload3)), EBH_CORE_MSG_OPERATION_SUCCESSFUL);
+    check("memory", memcmp(sim_target_memory(&target, 0x20001080), payload3, sizeof(payload3)), 0);
+    check("crc check", ebh_crc_check_32(0x20001080, sizeof(payload3), &crc), EBH_UART_ERROR_ACK);
+    check("crc value", crc, ebh_crc_update(0xFFFF, payload3, sizeof(payload3)));
+    check("erase segment", ebh_erase_segment_32(0x00001000), EBH_CORE_MSG_OPERATION_SUCCESSFUL);
+    check("frame errors", target.frame_errors, 0);
+    check("discarded", ebh_receive_discarded(), 0);
+
+    sim_bsp_i2c_stretch = 0;
+}
+
+static void stretch_limit(void) {
+    uint8_t rx_buf[2];
+    uint64_t begin = 0;
+
+    start(&ebh_transport_i2c, 400000);
+    sim_bsp_i2c_stretch = 1;
+    check("password", ebh_rx_password_32(password_empty_msp432), EBH_CORE_MSG_OPERATION_SUCCESSFUL);
+
+    // Mass erase takes 100 ms: stretched reads are aborted after 1 ms and polled again
+    sim_bsp_i2c_stretch_limit_ns = 1000000;
+    check("stretch beyond limit", ebh_mass_erase(ebh_device_msp432), EBH_CORE_MSG_OPERATION_SUCCESSFUL);
+    sim_bsp_i2c_stretch_limit_ns = 200000000;
+    check("stretch within limit", ebh_mass_erase(ebh_device_msp432), EBH_CORE_MSG_OPERATION_SUCCESSFUL);
+
+    // No answer at all: bounded by the response timeout (plus the bus time of the polls)
+    begin = sim_bsp_time_ns;
+    check("no answer", ebh_receive_core_response(rx_buf, 2, 0), EBH_UART_ERROR_TIME_OUT);
+    check("no answer bounded", (sim_bsp_time_ns - begin) < 5000000000ull, 1);
+
+    sim_bsp_i2c_stretch_limit_ns = EBH_I2C_STRETCH_TIMEOUT * 1000ull;
+    sim_bsp_i2c_stretch = 0;
+}
+
+static void throughput(const char *name, const ebh_transport *transport, uint32_t rate) {
+    uint64_t begin = 0;
+    uint64_t time_ns = 0;
+    uint16_t crc = 0;
+
+    start(transport, rate);
+    check("password", ebh_rx_password_32(password_empty_msp432), EBH_CORE_MSG_OPERATION_SUCCESSFUL);
+
+    begin = sim_bsp_time_ns;
+    check("bulk write", ebh_rx_data_block_32(0x20000000, bulk, sizeof(bulk)), EBH_CORE_MSG_OPERATION_SUCCESSFUL);
+    check("bulk crc", ebh_crc_check_32(0x20000000, sizeof(bulk), &crc), EBH_UART_ERROR_ACK);
+    time_ns = sim_bsp_time_ns - begin;
+    check("bulk crc value", crc, ebh_crc_update(0xFFFF, bulk, sizeof(bulk)));
+
+    printf("%-5s %8lu: %u byte write + verify %7.2f ms (%6.0f byte/s, simulated)\n",
+           name, (unsigned long)rate, BULK_SIZE, time_ns / 1e6, BULK_SIZE * 1e9 / time_ns);
+}
+
+int main(void) {
+    uint16_t i = 0;
+
+    for(i = 0; i < sizeof(bulk); i++) {
+        bulk[i] = (uint8_t)(i * 7 + (i >> 8));
+    }
+
+    session(0);
+    session(1);
+    stretch_limit();
+
+    throughput("uart", &ebh_transport_uart_poll, 115200);
+    throughput("i2c", &ebh_transport_i2c, 100000);
+    throughput("i2c", &ebh_transport_i2c, 400000);
+    throughput("i2c", &ebh_transport_i2c, 1000000);
+
+    printf("%u/%u tests passed\n", test_pass, test_total);
+    return test_fail ? 1 : 0;
+}
@@ -0,0 +1,295 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Max Groening
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+/*
+ * Host side test (Linux / POSIX)
+ *
+ * Intel HEX and TI-TXT parsers (image.h): both formats and the format detection fed in
+ * pieces of every size, errors, and the image writer merging 16 byte records into full
+ * data blocks, written to the simulated target in one call and record by record.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "embedded_bootloader/embedded_bootloader.h"
+#include "embedded_bootloader/bootloader_protocol.h"
+#include "embedded_bootloader/image.h"
+#include "embedded_bootloader/tests/test_support.h"
+#include "embedded_bootloader/tests/sim_bsp.h"
+
+#define REGION_A       0xC000u   // Crosses 64 kB
+#define REGION_A_SIZE  0x4400u
+#define REGION_B       0x12000u
+#define REGION_B_SIZE  0x800u
+#define MEMORY_SIZE    0x20000u
+#define TEXT_SIZE      0x40000u
+
+typedef struct {
+    const char *text;
+    uint32_t length;
+    uint32_t offset;
+} text_source;
+
+uint16_t test_pass = 0;
+uint16_t test_fail = 0;
+uint16_t test_total = 0;
+
+static sim_target target;
+static uint8_t image[MEMORY_SIZE];
+static uint8_t decoded[MEMORY_SIZE];
+static char hex[TEXT_SIZE];
+static char txt[TEXT_SIZE];
+static uint32_t hex_length = 0;
+static uint32_t txt_length = 0;
+static uint32_t sink_calls = 0;
+static uint32_t block_sizes = 0;  // ORed sizes of the blocks handed to count_write()
+
+static uint8_t memory_sink(void *context, uint32_t addr, const uint8_t *data, uint16_t length) {
+    if(addr + length > MEMORY_SIZE) {
+        return EBH_UART_ERROR_UNKNOWN_ERROR;
+    }
+    memcpy(&decoded[addr], data, length);
+    sink_calls++;
+    return 0;
+}
+
+static uint8_t failing_sink(void *context, uint32_t addr, const uint8_t *data, uint16_t length) {
+    return EBH_CORE_MSG_BSL_LOCKED;
+}
+
+static uint8_t count_write(void *context, uint32_t addr, const uint8_t *data, uint16_t length) {
+    block_sizes |= length;
+    return memory_sink(context, addr, data, length);
+}
+
+static uint8_t record_write(void *context, uint32_t addr, const uint8_t *data, uint16_t length) {
+    return ebh_write_region(addr, data, length);
+}
+
+static uint16_t read_text(void *context, uint8_t *data, uint16_t length) {
+    text_source *source = (text_source *)context;
+
+    if(length > source->length - source->offset) {
+        length = source->length - source->offset;
+    }
+    memcpy(data, &source->text[source->offset], length);
+    source->offset += length;
+    return length;
+}
+
+static uint8_t regions_equal(const uint8_t *memory) {
+    return (memcmp(&memory[REGION_A], &image[REGION_A], REGION_A_SIZE) == 0) &&
+           (memcmp(&memory[REGION_B], &image[REGION_B], REGION_B_SIZE) == 0);
+}
+
+/* Parses text in pieces of `piece` bytes (0: growing 1, 2, 3 ...) into decoded */
+static uint8_t parse(ebh_image_format format, const char *text, uint32_t length, uint16_t piece) {
+    ebh_image_parser parser;
+    uint32_t offset = 0;
+    uint16_t chunk = 0;
+    uint8_t status = EBH_PARSER_IN_PROGRESS;
+
+    memset(decoded, 0, sizeof(decoded));
+    sink_calls = 0;
+    ebh_image_init(&parser, format, memory_sink, 0);
+    while((offset < length) && (status == EBH_PARSER_IN_PROGRESS)) {
+        chunk = piece ? piece : (offset % 61) + 1;
+        if(chunk > length - offset) {
+            chunk = length - offset;
+        }
+        status = ebh_image_feed(&parser, (const uint8_t *)&text[offset], chunk);
+        offset += chunk;
+    }
+    return ebh_image_finish(&parser);
+}
+
+static uint8_t parse_string(ebh_image_format format, const char *text, uint32_t *line) {
+    ebh_image_parser parser;
+    uint8_t status = 0;
+
+    ebh_image_init(&parser, format, memory_sink, 0);
+    ebh_image_feed(&parser, (const uint8_t *)text, strlen(text));
+    status = ebh_image_finish(&parser);
+    if(line) {
+        *line = parser.line;
+    }
+    return status;
+}
+
+static void formats(void) {
+    static const uint16_t pieces[] = {1, 2, 3, 7, 16, 43, 256, 0, 0xFFFF};
+    uint8_t i = 0;
+
+    for(i = 0; i < sizeof(pieces) / sizeof(pieces[0]); i++) {
+        check("hex", parse(ebh_image_intel_hex, hex, hex_length, pieces[i]), EBH_UART_ERROR_ACK);
+        check("hex data", regions_equal(decoded), 1);
+        check("txt", parse(ebh_image_ti_txt, txt, txt_length, pieces[i]), EBH_UART_ERROR_ACK);
+        check("txt data", regions_equal(decoded), 1);
+    }
+
+    check("auto hex", parse(ebh_image_auto, hex, hex_length, 100), EBH_UART_ERROR_ACK);
+    check("auto hex data", regions_equal(decoded), 1);
+    check("auto hex records", sink_calls, (REGION_A_SIZE + REGION_B_SIZE) / 16);
+    check("auto txt", parse(ebh_image_auto, txt, txt_length, 100), EBH_UART_ERROR_ACK);
+    check("auto txt data", regions_equal(decoded), 1);
+    check("wrong format", parse(ebh_image_ti_txt, hex, hex_length, 100), EBH_UART_ERROR_IMAGE_SYNTAX);
+    check("wrong format txt", parse(ebh_image_intel_hex, txt, txt_length, 100), EBH_UART_ERROR_IMAGE_SYNTAX);
+}
+
+static void records(void) {
+    uint32_t line = 0;
+
+    // Extended segment address (0x1000 << 4), start address records are skipped
+    memset(decoded, 0, sizeof(decoded));
+    check("segment", parse_string(ebh_image_auto, ":020000021000EC\n:03001000010203E7\n:0400000500004400B3\n:00000001FF\n", 0), EBH_UART_ERROR_ACK);
+    check("segment data", (decoded[0x10010] << 16) | (decoded[0x10011] << 8) | decoded[0x10012], 0x010203);
+    check("lower case", parse_string(ebh_image_auto, ":0300100001020Ae0\n:00000001ff\n", 0), EBH_UART_ERROR_ACK);
+    check("txt lower case", parse_string(ebh_image_auto, "@1a00\nab cd\nq", 0), EBH_UART_ERROR_ACK);
+    check("txt lower case data", (decoded[0x1A00] << 8) | decoded[0x1A01], 0xABCD);
+    check("txt without q", parse_string(ebh_image_auto, "@1A02\n01 02\n", 0), EBH_UART_ERROR_ACK);
+    check("txt without q data", decoded[0x1A03], 0x02);
+    check("after end", parse_string(ebh_image_auto, "@1A02\n01\nq\nanything", 0), EBH_UART_ERROR_ACK);
+
+    check("checksum", parse_string(ebh_image_auto, ":00000001FE\n", &line), EBH_UART_ERROR_IMAGE_CHECKSUM);
+    check("checksum line", line, 1);
+    check("record type", parse_string(ebh_image_auto, ":0100000600F9\n:00000001FF\n", 0), EBH_UART_ERROR_IMAGE_RECORD);
+    check("record length", parse_string(ebh_image_auto, ":03000004000000F9\n:00000001FF\n", 0), EBH_UART_ERROR_IMAGE_RECORD);
+    check("short record", parse_string(ebh_image_auto, ":0300100001020\n", &line), EBH_UART_ERROR_IMAGE_SYNTAX);
+    check("short record line", line, 1);
+    check("garbage", parse_string(ebh_image_auto, ":00000001FF", 0), EBH_UART_ERROR_ACK);
+    check("garbage start", parse_string(ebh_image_auto, "x:00000001FF\n", 0), EBH_UART_ERROR_IMAGE_SYNTAX);
+    check("no end record", parse_string(ebh_image_auto, ":0300100001020AE0\n", 0), EBH_UART_ERROR_SOURCE_ENDED);
+    check("ends in record", parse_string(ebh_image_auto, ":0300", 0), EBH_UART_ERROR_SOURCE_ENDED);
+    check("empty", parse_string(ebh_image_auto, " \r\n", 0), EBH_UART_ERROR_SOURCE_ENDED);
+    check("txt long byte", parse_string(ebh_image_auto, "@1A00\nABC\nq", 0), EBH_UART_ERROR_IMAGE_SYNTAX);
+    check("txt long address", parse_string(ebh_image_auto, "@123456789\nAB\nq", 0), EBH_UART_ERROR_IMAGE_SYNTAX);
+    check("txt empty address", parse_string(ebh_image_auto, "@\nAB\nq", 0), EBH_UART_ERROR_IMAGE_SYNTAX);
+    check("txt ends in byte", parse_string(ebh_image_auto, "@1A00\nA", 0), EBH_UART_ERROR_SOURCE_ENDED);
+    check("txt bad character", parse_string(ebh_image_auto, "@1A00\nAB\n\nXY\nq", &line), EBH_UART_ERROR_IMAGE_SYNTAX);
+    check("txt bad character line", line, 4);
+    check("txt colon", parse_string(ebh_image_ti_txt, ":00000001FF\n", 0), EBH_UART_ERROR_IMAGE_SYNTAX);
+}
+
+static void writer(void) {
+    ebh_image_parser parser;
+    ebh_image_writer writer;
+    text_source source = {hex, 0, 0};
+
+    // 16 byte records merged into 256 byte blocks, a block ends where the data is not contiguous
+    memset(decoded, 0, sizeof(decoded));
+    block_sizes = 0;
+    ebh_image_writer_init(&writer, 256, count_write, 0);
+    ebh_image_init(&parser, ebh_image_auto, ebh_image_writer_sink, &writer);
+    source.length = hex_length;
+    check("writer parse", ebh_image_load(&parser, read_text, &source), EBH_UART_ERROR_ACK);
+    check("writer flush", ebh_image_writer_flush(&writer), 0);
+    check("writer blocks", writer.blocks, (REGION_A_SIZE + REGION_B_SIZE) / 256);
+    check("writer block sizes", block_sizes, 256);
+    check("writer bytes", writer.bytes, REGION_A_SIZE + REGION_B_SIZE);
+    check("writer data", regions_equal(decoded), 1);
+
+    // Errors of the write function end the parsing
+    ebh_image_writer_init(&writer, 16, failing_sink, 0);
+    ebh_image_init(&parser, ebh_image_auto, ebh_image_writer_sink, &writer);
+    check("writer error", ebh_image_feed(&parser, (const uint8_t *)hex, 200), EBH_CORE_MSG_BSL_LOCKED);
+    check("writer error kept", ebh_image_finish(&parser), EBH_CORE_MSG_BSL_LOCKED);
+}
+
+static void start(void) {
+    sim_target_init(&target, ebh_device_msp430_flash);
+    sim_bsp_attach(&target);
+    ebh_set_transport(&ebh_transport_uart_poll);
+    ebh_set_baud(115200);
+    target.baud = 115200;
+    target.locked = 0;
+}
+
+static void session(void) {
+    ebh_image_parser parser;
+    text_source source = {0, 0, 0};
+    uint64_t start_ns = 0;
+    uint64_t merged_ns = 0;
+    uint64_t record_ns = 0;
+    uint32_t merged_frames = 0;
+    uint32_t blocks = 0;
+
+    blocks = (REGION_A_SIZE + 255) / 256 + (REGION_B_SIZE + 255) / 256;
+
+    start();
+    source.text = hex;
+    source.length = hex_length;
+    start_ns = sim_bsp_time_ns;
+    check("image write", ebh_image_write(ebh_image_auto, read_text, &source), EBH_UART_ERROR_ACK);
+    merged_ns = sim_bsp_time_ns - start_ns;
+    merged_frames = target.commands[EBH_CMD_RX_DATA_BLOCK];
+    check("image write frames", merged_frames, blocks);
+    check("image write memory", regions_equal(sim_target_memory(&target, 0)), 1);
+
+    start();
+    source.text = txt;
+    source.length = txt_length;
+    source.offset = 0;
+    check("txt write", ebh_image_write(ebh_image_auto, read_text, &source), EBH_UART_ERROR_ACK);
+    check("txt write frames", target.commands[EBH_CMD_RX_DATA_BLOCK], blocks);
+    check("txt write memory", regions_equal(sim_target_memory(&target, 0)), 1);
+
+    // One frame per record
+    start();
+    source.text = hex;
+    source.length = hex_length;
+    source.offset = 0;
+    start_ns = sim_bsp_time_ns;
+    ebh_image_init(&parser, ebh_image_auto, record_write, 0);
+    check("record write", ebh_image_load(&parser, read_text, &source), EBH_UART_ERROR_ACK);
+    record_ns = sim_bsp_time_ns - start_ns;
+    check("record write frames", target.commands[EBH_CMD_RX_DATA_BLOCK], (REGION_A_SIZE + REGION_B_SIZE) / 16);
+    check("record write memory", regions_equal(sim_target_memory(&target, 0)), 1);
+
+    printf("%u byte HEX image at 115200 baud: %u frames %.1f ms merged, %u frames %.1f ms one per record\n",
+           REGION_A_SIZE + REGION_B_SIZE, merged_frames, merged_ns / 1e6,
+           target.commands[EBH_CMD_RX_DATA_BLOCK], record_ns / 1e6);
+}
+
+int main(void) {
+    uint32_t i = 0;
+
+    for(i = 0; i < MEMORY_SIZE; i++) {
+        image[i] = (uint8_t)(i * 13 + (i >> 9));
+    }
+    hex_length = test_image_hex(hex, REGION_A, &image[REGION_A], REGION_A_SIZE, 16, 0);
+    hex_length += test_image_hex(&hex[hex_length], REGION_B, &image[REGION_B], REGION_B_SIZE, 16, 1);
+    txt_length = test_image_txt(txt, REGION_A, &image[REGION_A], REGION_A_SIZE, 16, 0);
+    txt_length += test_image_txt(&txt[txt_length], REGION_B, &image[REGION_B], REGION_B_SIZE, 16, 1);
+
+    formats();
+    records();
+    writer();
+    session();
+
+    printf("%u/%u tests passed\n", test_pass, test_total);
+    return test_fail ? 1 : 0;
+}
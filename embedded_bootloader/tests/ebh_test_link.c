@@ -0,0 +1,246 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Max Groening
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+/*
+ * Host side test (Linux / POSIX)
+ *
+ * Baud rate management on the simulated target: every rate of the BSL table, negotiation
+ * of the fastest rate passing the probes on a line that gets noisy above a given rate,
+ * and the link monitor stepping down while a bulk write runs over such a line. Direct MSP432
+ * session start at the target rate is compared with the sync at 9600 baud it falls back to.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "embedded_bootloader/embedded_bootloader.h"
+#include "embedded_bootloader/bootloader_protocol.h"
+#include "embedded_bootloader/link.h"
+#include "embedded_bootloader/tests/test_support.h"
+#include "embedded_bootloader/tests/sim_bsp.h"
+
+#define BULK_SIZE      16384u
+#define BULK_ATTEMPTS  20
+
+uint16_t test_pass = 0;
+uint16_t test_fail = 0;
+uint16_t test_total = 0;
+
+static sim_target target;
+static uint8_t bulk[BULK_SIZE];
+
+static void start(uint32_t error_ppm, uint32_t error_min_baud) {
+    sim_target_init(&target, ebh_device_msp430_flash);
+    sim_bsp_attach(&target);
+    ebh_set_transport(&ebh_transport_uart_poll);
+    ebh_set_baud(9600);
+    sim_bsp_error_ppm = error_ppm;
+    sim_bsp_error_min_baud = error_min_baud;
+}
+
+static uint32_t link_baud(void) {
+    ebh_link_stats stats;
+    ebh_link_get_stats(&stats);
+    return stats.baud;
+}
+
+static void baud_table(void) {
+    static const uint32_t rates[] = {19200, 38400, 57600, 115200, 9600};
+    uint8_t version[4];
+    uint8_t i = 0;
+
+    check("code 9600", ebh_baud_rate(EBH_UART_BAUD_RATE_9600), 9600);
+    check("code 57600", ebh_baud_rate(EBH_UART_BAUD_RATE_56700), 57600);
+    check("code unknown", ebh_baud_rate(0x07), 0);
+
+    start(0, 0);
+    for(i = 0; i < sizeof(rates) / sizeof(rates[0]); i++) {
+        check("set baud", ebh_link_set_baud(rates[i]), EBH_UART_ERROR_ACK);
+        check("target baud", target.baud, rates[i]);
+        check("host baud", sim_bsp_baud, rates[i]);
+        check("version", ebh_tx_bsl_version(ebh_device_msp430_flash, version), EBH_UART_ERROR_ACK);
+    }
+    check("not in table", ebh_link_set_baud(230400), EBH_UART_ERROR_UNKNOWN_BAUD_RATE);
+    check("frame errors", target.frame_errors, 0);
+}
+
+static void negotiate(void) {
+    start(0, 0);
+    check("clean", ebh_link_negotiate(ebh_device_msp430_flash, 115200), EBH_UART_ERROR_ACK);
+    check("clean baud", link_baud(), 115200);
+    check("clean target", target.baud, 115200);
+
+    start(0, 0);
+    check("limited", ebh_link_negotiate(ebh_device_msp430_flash, 20000), EBH_UART_ERROR_ACK);
+    check("limited baud", link_baud(), 19200);
+
+    // Every 20th byte is corrupted from 57600 baud on
+    start(50000, 57600);
+    check("noisy", ebh_link_negotiate(ebh_device_msp430_flash, 115200), EBH_UART_ERROR_ACK);
+    check("noisy baud", link_baud(), 38400);
+    check("noisy target", target.baud, 38400);
+    check("noisy host", sim_bsp_baud, 38400);
+    check("noisy errors", sim_bsp_errors > 0, 1);
+    printf("negotiation on a noisy line: %lu bit errors, %.1f ms, settled at %lu baud\n",
+           (unsigned long)sim_bsp_errors, sim_bsp_time_ns / 1e6, (unsigned long)link_baud());
+}
+
+static void monitor(void) {
+    ebh_link_stats stats;
+    uint16_t offset = 0;
+    uint16_t crc = 0;
+    uint8_t attempts = 0;
+    uint8_t status = 0;
+
+    start(0, 0);
+    check("monitor negotiate", ebh_link_negotiate(ebh_device_msp430_flash, 115200), EBH_UART_ERROR_ACK);
+    check("monitor password", ebh_rx_password(password_empty_msp430), EBH_CORE_MSG_OPERATION_SUCCESSFUL);
+
+    // The cable gets flaky: one byte in 200 is corrupted at 57600 baud and above
+    sim_bsp_error_ppm = 5000;
+    sim_bsp_error_min_baud = 57600;
+    ebh_link_monitor(1);
+
+    // The caller repeats failed blocks, the monitor lowers the baud rate underneath
+    for(offset = 0; offset < BULK_SIZE; offset += 256) {
+        for(attempts = 0; attempts < BULK_ATTEMPTS; attempts++) {
+            status = ebh_rx_data_block(0x4400 + offset, &bulk[offset], 256);
+            if(status == EBH_CORE_MSG_OPERATION_SUCCESSFUL) {
+                break;
+            }
+            ebh_delay_between_commands();
+            ebh_flush();
+        }
+        if(status != EBH_CORE_MSG_OPERATION_SUCCESSFUL) {
+            break;
+        }
+    }
+    ebh_link_monitor(0);
+    check("monitor write", status, EBH_CORE_MSG_OPERATION_SUCCESSFUL);
+    check("monitor memory", memcmp(sim_target_memory(&target, 0x4400), bulk, sizeof(bulk)), 0);
+
+    ebh_link_get_stats(&stats);
+    check("monitor downshifted", stats.downshifts > 0, 1);
+    check("monitor baud", stats.baud, 38400);
+    check("monitor host", sim_bsp_baud, 38400);
+    check("monitor crc", ebh_crc_check(0x4400, sizeof(bulk), &crc), EBH_UART_ERROR_ACK);
+    check("monitor crc value", crc, ebh_crc_update(0xFFFF, bulk, sizeof(bulk)));
+    printf("flaky line: %lu frames, %lu line errors, %u downshifts to %lu baud, %.2f s\n",
+           (unsigned long)stats.frames, (unsigned long)stats.errors, stats.downshifts,
+           (unsigned long)stats.baud, sim_bsp_time_ns / 1e9);
+
+    // No monitoring: the baud rate stays where it is
+    start(0, 0);
+    check("unmonitored negotiate", ebh_link_negotiate(ebh_device_msp430_flash, 115200), EBH_UART_ERROR_ACK);
+    sim_bsp_error_ppm = 200000;
+    check("unmonitored version", ebh_tx_bsl_version(ebh_device_msp430_flash, bulk) != EBH_UART_ERROR_ACK, 1);
+    check("unmonitored baud", link_baud(), 115200);
+
+    // The failing command ends at its baud rate, the next frame goes out one step lower
+    start(0, 0);
+    check("pending negotiate", ebh_link_negotiate(ebh_device_msp430_flash, 115200), EBH_UART_ERROR_ACK);
+    ebh_link_monitor(1);
+    sim_bsp_error_ppm = 1000000;
+    for(attempts = 0; attempts < EBH_LINK_MAX_ERRORS; attempts++) {
+        ebh_tx_bsl_version(ebh_device_msp430_flash, bulk);
+    }
+    check("pending baud", link_baud(), 115200);
+    sim_bsp_error_ppm = 0;
+    check("pending version", ebh_tx_bsl_version(ebh_device_msp430_flash, bulk), EBH_UART_ERROR_ACK);
+    check("pending downshift", link_baud(), 57600);
+    check("pending host", sim_bsp_baud, 57600);
+    ebh_link_monitor(0);
+}
+
+static uint64_t sync_session(uint32_t autobaud_max, uint32_t baud, uint8_t expected_changes) {
+    uint64_t start_ns = 0;
+
+    sim_target_init(&target, ebh_device_msp432);
+    target.autobaud_max = autobaud_max;
+    sim_bsp_attach(&target);
+    ebh_set_transport(&ebh_transport_uart_poll);
+    sim_bsp_error_ppm = 0;
+
+    check("sync", ebh_link_sync(baud), EBH_UART_ERROR_ACK);
+    check("sync baud", link_baud(), sim_bsp_baud);
+    check("sync target baud", target.baud, sim_bsp_baud);
+    check("sync changes", target.commands[EBH_CMD_CHANGE_BAUD_RATE], expected_changes);
+    check("sync probe", target.commands[EBH_CMD_TX_BSL_VERSION], 1);
+    start_ns = sim_bsp_time_ns;
+    check("sync password", ebh_rx_password_32(password_empty_msp432), EBH_CORE_MSG_OPERATION_SUCCESSFUL);
+    return start_ns;
+}
+
+static void direct_sync(void) {
+    uint8_t version[10];
+    uint64_t direct_ns = 0;
+    uint64_t fallback_ns = 0;
+    uint64_t detour_ns = 0;
+
+    direct_ns = sync_session(115200, 115200, 0);
+    check("direct baud", link_baud(), 115200);
+
+    sync_session(115200, 100000, 0);
+    check("direct below", link_baud(), 57600);
+
+    // The BSL does not detect the rate, the sync at 9600 baud takes over
+    fallback_ns = sync_session(9600, 115200, 1);
+    check("fallback baud", link_baud(), 115200);
+    check("fallback frame errors", target.frame_errors, 1);  // The garbled sync character
+
+    sync_session(0, 38400, 1);
+    check("no autobaud", link_baud(), 38400);
+
+    // Session start as done before: sync at 9600 baud, CHANGE_BAUD_RATE, same probe
+    sim_target_init(&target, ebh_device_msp432);
+    sim_bsp_attach(&target);
+    ebh_set_baud(9600);
+    ebh_sync_character();
+    check("detour change", ebh_change_baud_rate(EBH_UART_BAUD_RATE_115200), EBH_UART_ERROR_ACK);
+    ebh_delay_between_commands();
+    ebh_set_baud(115200);
+    check("detour probe", ebh_tx_bsl_version(ebh_device_msp432, version), EBH_UART_ERROR_ACK);
+    detour_ns = sim_bsp_time_ns;
+    check("detour password", ebh_rx_password_32(password_empty_msp432), EBH_CORE_MSG_OPERATION_SUCCESSFUL);
+
+    check("direct faster", direct_ns < detour_ns, 1);
+    printf("session start: direct %.2f ms, 9600 detour %.2f ms, fallback %.2f ms\n",
+           direct_ns / 1e6, detour_ns / 1e6, fallback_ns / 1e6);
+}
+
+int main(void) {
+    uint16_t i = 0;
+
+    for(i = 0; i < sizeof(bulk); i++) {
+        bulk[i] = (uint8_t)(i * 13 + (i >> 8));
+    }
+
+    baud_table();
+    negotiate();
+    monitor();
+    direct_sync();
+
+    printf("%u/%u tests passed\n", test_pass, test_total);
+    return test_fail ? 1 : 0;
+}
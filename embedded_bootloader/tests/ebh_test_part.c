@@ -0,0 +1,175 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Max Groening
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+/*
+ * Host side test (Linux / POSIX)
+ *
+ * Device geometry (part.h): consistency of the part table, the address lookup against a
+ * linear search, range checks across adjacent memory, and the checks EBH_PART compiles into
+ * the protocol layer on the simulated target.
+ *
+ * Build with -DEBH_PART=ebh_part_msp430f5529.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "embedded_bootloader/embedded_bootloader.h"
+#include "embedded_bootloader/bootloader_protocol.h"
+#include "embedded_bootloader/part.h"
+#include "embedded_bootloader/elf.h"
+#include "embedded_bootloader/tests/test_support.h"
+#include "embedded_bootloader/tests/sim_bsp.h"
+
+#ifndef EBH_PART
+#error "Build with -DEBH_PART=ebh_part_msp430f5529"
+#endif
+
+#define EM_MSP430  105
+#define PT_LOAD    1
+
+uint16_t test_pass = 0;
+uint16_t test_fail = 0;
+uint16_t test_total = 0;
+
+static sim_target target;
+
+static void start(void) {
+    sim_target_init(&target, ebh_device_msp430_flash);
+    sim_bsp_attach(&target);
+    ebh_set_transport(&ebh_transport_uart_poll);
+    ebh_set_baud(115200);
+    target.baud = 115200;
+    target.locked = 0;
+}
+
+static const ebh_memory *linear(const ebh_part *part, uint32_t addr) {
+    uint8_t i = 0;
+
+    for(i = 0; i < part->memory_count; i++) {
+        if((addr >= part->memory[i].start) && (addr < part->memory[i].end)) {
+            return &part->memory[i];
+        }
+    }
+    return 0;
+}
+
+static void table(void) {
+    const ebh_part *part = 0;
+    const ebh_memory *memory = 0;
+    uint32_t errors = 0;
+    uint32_t mismatches = 0;
+    uint32_t addr = 0;
+    uint8_t i = 0;
+    uint8_t k = 0;
+
+    for(i = 0; i < ebh_part_count; i++) {
+        part = ebh_parts[i];
+        errors += ebh_part_find(part->name) != part;
+        errors += (part->buffer_size > EBH_MAX_BUFFER_SIZE) || (part->align == 0) || (part->align & (part->align - 1));
+        for(k = 0; k < part->memory_count; k++) {
+            memory = &part->memory[k];
+            errors += memory->start >= memory->end;
+            errors += (k > 0) && (memory->start < memory[-1].end);  // In address order
+            if(memory->flags & EBH_MEMORY_ERASE) {
+                errors += (memory->segment == 0) || (memory->segment & (memory->segment - 1));
+                errors += ((memory->start | memory->end) & (memory->segment - 1)) != 0;
+            }
+        }
+
+        // Every boundary and a sweep through the memory map
+        for(k = 0; k < part->memory_count; k++) {
+            mismatches += ebh_part_memory(part, part->memory[k].start) != &part->memory[k];
+            mismatches += ebh_part_memory(part, part->memory[k].end - 1) != &part->memory[k];
+            mismatches += ebh_part_memory(part, part->memory[k].end) != linear(part, part->memory[k].end);
+            mismatches += ebh_part_memory(part, part->memory[k].start - 1) != linear(part, part->memory[k].start - 1);
+        }
+        for(addr = 0; addr < 0x00500000; addr += 0x100) {
+            mismatches += ebh_part_memory(part, addr) != linear(part, addr);
+        }
+    }
+    check("table", errors, 0);
+    check("lookup", mismatches, 0);
+    check("parts", ebh_part_count, 7);
+    check("find unknown", ebh_part_find("msp430f1611") == 0, 1);
+    check("ram", ebh_part_memory(&ebh_part_msp432p401r, 0x20001000)->type, ebh_memory_ram);
+    check("hole", ebh_part_memory(&ebh_part_msp430f5529, 0x1B00) == 0, 1);
+
+    // EBH_PART replaces the generic part of its device only
+    check("of flash", ebh_part_of(ebh_device_msp430_flash) == &ebh_part_msp430f5529, 1);
+    check("of fram", ebh_part_of(ebh_device_msp430_fram) == &ebh_part_msp430_fram, 1);
+    check("of msp432", ebh_part_of(ebh_device_msp432) == &ebh_part_msp432, 1);
+}
+
+static void ranges(void) {
+    const ebh_part *part = &ebh_part_msp430f5529;
+
+    check("main", ebh_part_allows(part, 0x4400, 0x20000, EBH_MEMORY_WRITE | EBH_MEMORY_ERASE), 1);
+    check("main end", ebh_part_allows(part, 0x4400, 0x20001, EBH_MEMORY_WRITE), 0);
+    check("ram to main", ebh_part_allows(part, 0x43F0, 0x20, EBH_MEMORY_WRITE), 1);
+    check("ram erase", ebh_part_allows(part, 0x43F0, 0x20, EBH_MEMORY_ERASE), 0);
+    check("info to tlv", ebh_part_allows(part, 0x19F0, 0x20, EBH_MEMORY_WRITE), 0);
+    check("bsl", ebh_part_allows(part, 0x1000, 1, EBH_MEMORY_WRITE), 0);
+    check("over hole", ebh_part_allows(part, 0x1AF0, 0x200, EBH_MEMORY_WRITE), 0);
+    check("empty", ebh_part_allows(part, 0x1000, 0, EBH_MEMORY_WRITE), 1);
+    check("wrap", ebh_part_allows(&ebh_part_msp432, 0x20000000, 0xF0000000, EBH_MEMORY_WRITE), 0);
+    check("fram", ebh_part_allows(&ebh_part_msp430fr5969, 0x4400, 0x100, EBH_MEMORY_ERASE), 0);
+    check("msp432 info", ebh_part_allows(&ebh_part_msp432p401r, 0x200000, 0x2000, EBH_MEMORY_WRITE), 0);
+}
+
+/* EBH_PART: invalid addresses fail before a command is sent, no TX_BUFFER_SIZE query */
+static void protocol(void) {
+    static uint8_t data[1024];
+    static uint8_t file[512];
+    const test_elf_segment bsl[] = {{PT_LOAD, 0x1000, 0x1000, data, 0x10, 0x10}};
+    uint32_t size = 0;
+
+    memset(data, 0x5A, sizeof(data));
+    start();
+    check("write bsl", ebh_write_region(0x1000, data, 16), EBH_UART_ERROR_PART_ADDRESS);
+    check("write over main end", ebh_write_region(0x24400 - 16, data, 32), EBH_UART_ERROR_PART_ADDRESS);
+    check("erase ram", ebh_erase_segment(0x2400), EBH_UART_ERROR_PART_ADDRESS);
+    check("erase 32 tlv", ebh_erase_segment_32(0x1A00), EBH_UART_ERROR_PART_ADDRESS);
+    size = test_elf(file, EM_MSP430, bsl, 1);
+    check("elf bsl", ebh_elf_write(file, size, ebh_device_msp430_flash), EBH_UART_ERROR_IMAGE_ADDRESS);
+    check("nothing sent", target.commands[EBH_CMD_RX_DATA_BLOCK] + target.commands[EBH_CMD_ERASE_SEGMENT] +
+                          target.commands[EBH_CMD_ERASE_SEGMENT_32], 0);
+
+    check("write main", ebh_write_region(0x4400, data, sizeof(data)), EBH_UART_ERROR_ACK);
+    check("frames", target.commands[EBH_CMD_RX_DATA_BLOCK], sizeof(data) / 256);
+    check("no buffer query", target.commands[EBH_CMD_TX_BUFFER_SIZE], 0);
+    check("memory", memcmp(sim_target_memory(&target, 0x4400), data, sizeof(data)), 0);
+    check("erase info", ebh_erase_segment(0x1880), EBH_UART_ERROR_ACK);
+}
+
+int main(void) {
+    table();
+    ranges();
+    protocol();
+
+    printf("%u/%u tests passed\n", test_pass, test_total);
+    return test_fail ? 1 : 0;
+}
@@ -0,0 +1,279 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Max Groening
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+/*
+ * Host side test (Linux / POSIX)
+ *
+ * Write planner (plan.h): blank runs, gap bridging, alignment and the schedule limits, and
+ * a half empty MSP430 image written with the plan and range by range on the simulated
+ * target, comparing the predicted with the simulated time.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "embedded_bootloader/embedded_bootloader.h"
+#include "embedded_bootloader/bootloader_protocol.h"
+#include "embedded_bootloader/plan.h"
+#include "embedded_bootloader/tests/test_support.h"
+#include "embedded_bootloader/tests/sim_bsp.h"
+
+#define IMAGE_ADDR     0x4400u
+#define IMAGE_SIZE     0x10000u
+#define MAX_PACKETS    512
+
+uint16_t test_pass = 0;
+uint16_t test_fail = 0;
+uint16_t test_total = 0;
+
+static sim_target target;
+static uint8_t image[IMAGE_SIZE];
+static ebh_plan_packet packets[MAX_PACKETS];
+
+static void start(void) {
+    sim_target_init(&target, ebh_device_msp430_flash);
+    sim_bsp_attach(&target);
+    ebh_set_transport(&ebh_transport_uart_poll);
+    ebh_set_baud(115200);
+    target.baud = 115200;
+    target.locked = 0;
+}
+
+static void options(ebh_plan_options *o, uint16_t block, uint16_t align, uint16_t blank, uint16_t bridge) {
+    o->block = block;
+    o->align = align;
+    o->blank = blank;
+    o->bridge = bridge;
+    o->part = 0;
+}
+
+static void rules(void) {
+    static uint8_t data[1024];
+    ebh_plan_options o;
+    ebh_plan plan;
+    ebh_range ranges[3];
+    uint16_t i = 0;
+    uint8_t aligned = 1;
+
+    memset(data, 0x11, sizeof(data));
+
+    // Blank runs: 31 bytes are sent, 32 are left out
+    memset(&data[40], 0xFF, 31);
+    memset(&data[100], 0xFF, 32);
+    ranges[0].addr = 0x1000;
+    ranges[0].data = data;
+    ranges[0].length = 200;
+    options(&o, 256, 1, 32, 0);
+    check("blank", ebh_plan_make(&plan, ranges, 1, &o, packets, MAX_PACKETS), EBH_UART_ERROR_ACK);
+    check("blank packets", plan.count, 2);
+    check("blank first", packets[0].addr + packets[0].length, 0x1000 + 100);
+    check("blank second", packets[1].addr, 0x1000 + 132);
+    check("blank skipped", plan.skipped, 32);
+    check("blank bytes", plan.bytes, 168);
+    options(&o, 256, 1, 0, 0);
+    check("blank off", ebh_plan_make(&plan, ranges, 1, &o, packets, MAX_PACKETS), EBH_UART_ERROR_ACK);
+    check("blank off packets", plan.count, 1);
+
+    // Leading and trailing runs, a range of 0xFF only
+    memset(data, 0xFF, sizeof(data));
+    memset(&data[64], 0x22, 64);
+    ranges[0].length = 256;
+    ranges[1].addr = 0x2000;
+    ranges[1].data = data;
+    ranges[1].length = 48;
+    options(&o, 256, 1, 32, 0);
+    check("edges", ebh_plan_make(&plan, ranges, 2, &o, packets, MAX_PACKETS), EBH_UART_ERROR_ACK);
+    check("edges packets", plan.count, 1);
+    check("edges packet", (packets[0].addr << 8) | packets[0].length, (0x1040u << 8) | 64);
+    check("edges skipped", plan.skipped, 64 + 128 + 48);
+
+    // Gaps between ranges up to `bridge` bytes are sent as 0xFF
+    memset(data, 0x33, sizeof(data));
+    ranges[0].addr = 0x1000;
+    ranges[0].length = 100;
+    ranges[1].addr = 0x1000 + 110;
+    ranges[1].length = 50;
+    ranges[2].addr = 0x1000 + 200;
+    ranges[2].data = data;
+    ranges[2].length = 20;
+    options(&o, 256, 1, 32, 10);
+    check("bridge", ebh_plan_make(&plan, ranges, 3, &o, packets, MAX_PACKETS), EBH_UART_ERROR_ACK);
+    check("bridge packets", plan.count, 2);
+    check("bridge first", packets[0].length, 160);
+    check("bridge filled", plan.filled, 10);
+    options(&o, 256, 1, 32, 40);
+    check("bridge all", ebh_plan_make(&plan, ranges, 3, &o, packets, MAX_PACKETS), EBH_UART_ERROR_ACK);
+    check("bridge all packets", plan.count, 1);
+    check("bridge all filled", plan.filled, 50);
+
+    // Aligned packets, blocks rounded down to the alignment
+    options(&o, 250, 16, 32, 0);
+    ranges[0].addr = 0x1003;
+    ranges[0].length = 600;
+    check("align", ebh_plan_make(&plan, ranges, 1, &o, packets, MAX_PACKETS), EBH_UART_ERROR_ACK);
+    for(i = 0; i < plan.count; i++) {
+        aligned &= ((packets[i].addr | packets[i].length) & 15) == 0;
+    }
+    check("align packets", aligned, 1);
+    check("align block", packets[0].length, 240);
+    check("align span", packets[plan.count - 1].addr + packets[plan.count - 1].length - packets[0].addr, 0x1260 - 0x1000);
+
+    // Packets do not cross the 24 bit address limit
+    ranges[0].addr = 0xFFFF80;
+    ranges[0].length = 256;
+    options(&o, 256, 1, 0, 0);
+    check("limit", ebh_plan_make(&plan, ranges, 1, &o, packets, MAX_PACKETS), EBH_UART_ERROR_ACK);
+    check("limit packets", plan.count, 2);
+    check("limit split", packets[1].addr, 0x1000000);
+
+    // Invalid input
+    ranges[0].addr = 0x1000;
+    ranges[0].length = 200;
+    ranges[1].addr = 0x1000 + 199;
+    check("overlap", ebh_plan_make(&plan, ranges, 2, &o, packets, MAX_PACKETS), EBH_UART_ERROR_PLAN_RANGES);
+    ranges[1].addr = 0x800;
+    check("order", ebh_plan_make(&plan, ranges, 2, &o, packets, MAX_PACKETS), EBH_UART_ERROR_PLAN_RANGES);
+    options(&o, 256, 12, 0, 0);
+    check("align power of two", ebh_plan_make(&plan, ranges, 1, &o, packets, MAX_PACKETS), EBH_UART_ERROR_PLAN_RANGES);
+    options(&o, 16, 1, 0, 0);
+    check("full", ebh_plan_make(&plan, ranges, 1, &o, packets, 4), EBH_UART_ERROR_PLAN_FULL);
+    check("full count", plan.count, 4);
+
+    // With a part: no writes to protected memory, 0xFF runs are sent where nothing is erased
+    o.part = &ebh_part_msp430f5529;
+    ranges[0].addr = 0x1A00;
+    check("tlv", ebh_plan_make(&plan, ranges, 1, &o, packets, MAX_PACKETS), EBH_UART_ERROR_PART_ADDRESS);
+    memset(data, 0xFF, sizeof(data));
+    ranges[0].addr = 0x2400;
+    options(&o, 256, 1, 32, 0);
+    o.part = &ebh_part_msp430f5529;
+    check("ram", ebh_plan_make(&plan, ranges, 1, &o, packets, MAX_PACKETS), EBH_UART_ERROR_ACK);
+    check("ram sent", plan.bytes, 200);
+    ranges[0].addr = 0x4400;
+    check("flash", ebh_plan_make(&plan, ranges, 1, &o, packets, MAX_PACKETS), EBH_UART_ERROR_ACK);
+    check("flash skipped", plan.skipped, 200);
+
+    // Block per address length: 256 bytes with RX_DATA_BLOCK, 255 with RX_DATA_BLOCK_32
+    memset(data, 0x44, sizeof(data));
+    options(&o, 0, 1, 0, 0);
+    o.part = &ebh_part_msp430f5529;
+    ranges[0].addr = 0x4400;
+    ranges[0].length = 0x300;
+    check("part block", ebh_plan_make(&plan, ranges, 1, &o, packets, MAX_PACKETS), EBH_UART_ERROR_ACK);
+    check("part packets", plan.count, 3);
+    check("part packet", packets[0].length, 256);
+    start();
+    o.part = 0;
+    ranges[0].addr = 0xFFFF00;
+    ranges[0].length = 0x200;
+    check("target block", ebh_plan_make(&plan, ranges, 1, &o, packets, MAX_PACKETS), EBH_UART_ERROR_ACK);
+    check("target packets", plan.count, 3);
+    check("target 24 bit", packets[0].length, 256);
+    check("target 32 bit", packets[1].length, 255);
+}
+
+/* Code, constant tables with erased holes, an unused middle and the interrupt vectors */
+static void half_empty(ebh_range *ranges) {
+    uint32_t i = 0;
+
+    memset(image, 0xFF, sizeof(image));
+    for(i = 0; i < 0x5000; i++) {
+        image[i] = (uint8_t)(i * 7 + 1);
+        if((i % 512) >= 448) {
+            image[i] = 0xFF;  // Alignment holes the linker left
+        }
+    }
+    for(i = 0x9000; i < 0xA000; i++) {
+        image[i] = ((i / 64) & 1) ? (uint8_t)i : 0xFF;
+    }
+    for(i = 0xA000; i < 0xA600; i++) {
+        if((i % 40) < 34) {
+            image[i] = (uint8_t)(i ^ 0x5A);  // Records with short gaps
+        }
+    }
+
+    // As the image file has it: one range for the code and tables, one for the vectors
+    ranges[0].addr = IMAGE_ADDR;
+    ranges[0].data = image;
+    ranges[0].length = 0xBB80;
+    ranges[1].addr = 0xFF80;
+    ranges[1].data = &image[0xFF80 - IMAGE_ADDR];
+    ranges[1].length = 0x80;
+    for(i = 0xBB80; i < 0xBC00; i++) {
+        image[i] = (uint8_t)i;
+    }
+}
+
+static void session(void) {
+    ebh_range ranges[2];
+    ebh_plan_options o;
+    ebh_plan plan;
+    uint64_t start_ns = 0;
+    uint64_t naive_ns = 0;
+    uint64_t plan_ns = 0;
+    uint32_t naive_frames = 0;
+    uint16_t i = 0;
+
+    half_empty(ranges);
+
+    // Every byte as it is
+    start();
+    start_ns = sim_bsp_time_ns;
+    for(i = 0; i < 2; i++) {
+        check("naive", ebh_write_region(ranges[i].addr, ranges[i].data, ranges[i].length), EBH_UART_ERROR_ACK);
+    }
+    naive_ns = sim_bsp_time_ns - start_ns;
+    naive_frames = target.commands[EBH_CMD_RX_DATA_BLOCK];
+
+    start();
+    ebh_plan_defaults(&o, &ebh_part_msp430f5529);
+    check("default bridge", o.bridge, ebh_plan_packet_time(0, 0) / (ebh_plan_packet_time(0, 1) - ebh_plan_packet_time(0, 0)));
+    check("plan", ebh_plan_make(&plan, ranges, 2, &o, packets, MAX_PACKETS), EBH_UART_ERROR_ACK);
+    start_ns = sim_bsp_time_ns;
+    check("plan write", ebh_plan_write(&plan), EBH_UART_ERROR_ACK);
+    plan_ns = sim_bsp_time_ns - start_ns;
+    check("plan frames", target.commands[EBH_CMD_RX_DATA_BLOCK], plan.count);
+    check("plan memory", memcmp(sim_target_memory(&target, IMAGE_ADDR), image, 0xBB80), 0);
+    check("plan vectors", memcmp(sim_target_memory(&target, 0xFF80), &image[0xFF80 - IMAGE_ADDR], 0x80), 0);
+    check("plan faster", plan_ns * 10 < naive_ns * 7, 1);
+
+    // The prediction is close to the simulated time (TX_BUFFER_SIZE query not included)
+    check("plan prediction", (plan.time_us * 1000ull > plan_ns * 9 / 10) && (plan.time_us * 1000ull < plan_ns * 11 / 10), 1);
+    check("naive prediction", (plan.naive_us * 1000ull > naive_ns * 9 / 10) && (plan.naive_us * 1000ull < naive_ns * 11 / 10), 1);
+
+    printf("%u byte image, %u bytes blank: %u frames %.0f ms (predicted %.0f ms) range by range, "
+           "%u frames %.0f ms (predicted %.0f ms) planned, %u bytes left out, %u filled\n",
+           ranges[0].length + ranges[1].length, plan.skipped, naive_frames, naive_ns / 1e6, plan.naive_us / 1e3,
+           plan.count, plan_ns / 1e6, plan.time_us / 1e3, plan.skipped, plan.filled);
+}
+
+int main(void) {
+    rules();
+    session();
+
+    printf("%u/%u tests passed\n", test_pass, test_total);
+    return test_fail ? 1 : 0;
+}
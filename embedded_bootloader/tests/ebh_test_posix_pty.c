@@ -0,0 +1,276 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Max Groening
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+/*
+ * Host side test (Linux)
+ *
+ * Runs the POSIX BSP (devices/bsp_posix.c) end to end against a pseudo terminal pair:
+ * the library opens the slave side like a USB-serial adapter, a thread on the master
+ * side plays the BSL target (sim_target.c) in real time. The written data is dumped back
+ * into a file with ebh_posix_write_sink().
+ *
+ * Link devices/bsp_posix.c instead of sim_bsp.c.
+ */
+
+#define _XOPEN_SOURCE 600
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "embedded_bootloader/embedded_bootloader.h"
+#include "embedded_bootloader/bootloader_protocol.h"
+#include "embedded_bootloader/link.h"
+#include "embedded_bootloader/elf.h"
+#include "embedded_bootloader/timing.h"
+#include "embedded_bootloader/devices/bsp_posix.h"
+#include "embedded_bootloader/tests/test_support.h"
+#include "embedded_bootloader/tests/sim_target.h"
+
+#define BULK_SIZE  8192u
+
+uint16_t test_pass = 0;
+uint16_t test_fail = 0;
+uint16_t test_total = 0;
+
+static sim_target target;
+static pthread_mutex_t target_lock = PTHREAD_MUTEX_INITIALIZER;
+static int master = -1;
+static volatile uint8_t running = 1;
+static uint64_t epoch_ns = 0;
+
+static uint8_t bulk[BULK_SIZE];
+static char pin_trace[32];
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec - epoch_ns;
+}
+
+
+/*
+ * BSL target on the master side of the pty
+ */
+
+static void *target_thread(void *arg) {
+    struct pollfd pfd;
+    uint8_t buffer[512];
+    uint64_t next = 0;
+    uint64_t now = 0;
+    int timeout_ms = 0;
+    ssize_t n = 0;
+    ssize_t i = 0;
+
+    pfd.fd = master;
+    pfd.events = POLLIN;
+    while(running) {
+        pthread_mutex_lock(&target_lock);
+        next = sim_target_next_ready(&target);
+        pthread_mutex_unlock(&target_lock);
+        now = now_ns();
+        timeout_ms = (next == UINT64_MAX) ? 1 : (int)((next > now) ? (next - now) / 1000000u : 0);
+
+        if(poll(&pfd, 1, timeout_ms) > 0) {
+            n = read(master, buffer, sizeof(buffer));
+            pthread_mutex_lock(&target_lock);
+            for(i = 0; i < n; i++) {
+                sim_target_receive(&target, buffer[i], now_ns());
+            }
+            pthread_mutex_unlock(&target_lock);
+        }
+
+        pthread_mutex_lock(&target_lock);
+        n = 0;
+        while((n < (ssize_t)sizeof(buffer)) && sim_target_pending(&target, now_ns())) {
+            buffer[n++] = sim_target_transmit(&target);
+        }
+        pthread_mutex_unlock(&target_lock);
+        if(n > 0) {
+            write(master, buffer, n);
+        }
+    }
+    return 0;
+}
+
+
+/*
+ * RST / TEST pins
+ */
+
+static void trace_pin(void *context, uint8_t level) {
+    size_t length = strlen(pin_trace);
+
+    if(length < sizeof(pin_trace) - 1) {
+        pin_trace[length] = level ? ((const char *)context)[0] : ((const char *)context)[1];
+    }
+}
+
+static void trace_rst(void *context, uint8_t level) {
+    trace_pin("Rr", level);
+}
+
+static void trace_test(void *context, uint8_t level) {
+    trace_pin("Tt", level);
+}
+
+static const ebh_posix_gpio trace_gpio = {
+    trace_rst,
+    trace_test,
+    0
+};
+
+
+/*
+ * BSL session on the serial port
+ */
+
+static void dump(void) {
+    static uint8_t file[BULK_SIZE];
+    char path[] = "/tmp/ebh_dump_XXXXXX";
+    int fd = mkstemp(path);
+
+    check("dump", ebh_tx_data_block_32(0x20000000, sizeof(bulk), ebh_posix_write_sink, &fd), EBH_UART_ERROR_ACK);
+    check("dump size", lseek(fd, 0, SEEK_CUR), sizeof(bulk));
+    lseek(fd, 0, SEEK_SET);
+    check("dump read", read(fd, file, sizeof(file)), sizeof(file));
+    check("dump content", memcmp(file, bulk, sizeof(bulk)), 0);
+    close(fd);
+    unlink(path);
+}
+
+/* ELF file mapped into memory and written from the mapping */
+static void elf_file(void) {
+    static uint8_t elf[BULK_SIZE + 256];
+    const test_elf_segment segments[] = {{1, 0x20004000, 0x20004000, payload3, sizeof(payload3), sizeof(payload3)}};
+    char path[] = "/tmp/ebh_elf_XXXXXX";
+    const uint8_t *mapped = 0;
+    uint32_t length = test_elf(elf, 40, segments, 1);
+    uint32_t size = 0;
+    int fd = mkstemp(path);
+
+    check("elf file", write(fd, elf, length), length);
+    close(fd);
+    mapped = ebh_posix_map(path, &size);
+    check("elf map", (mapped != 0) && (size == length), 1);
+    if(mapped) {
+        check("elf write", ebh_elf_write(mapped, size, ebh_device_msp432), EBH_UART_ERROR_ACK);
+        ebh_posix_unmap(mapped, size);
+    }
+    pthread_mutex_lock(&target_lock);
+    check("elf content", memcmp(sim_target_memory(&target, 0x20004000), payload3, sizeof(payload3)), 0);
+    pthread_mutex_unlock(&target_lock);
+    unlink(path);
+    check("elf missing", ebh_posix_map(path, &size) == 0, 1);
+}
+
+static void run_session(const char *name, const ebh_transport *transport) {
+    uint64_t start = 0;
+    uint64_t bulk_ns = 0;
+    uint64_t timeout_ns = 0;
+    uint32_t expected_us = 0;
+    uint16_t crc = 0;
+
+    pthread_mutex_lock(&target_lock);
+    sim_target_init(&target, ebh_device_msp432);
+    pthread_mutex_unlock(&target_lock);
+    check("open", ebh_posix_open(ptsname(master), 9600), 0);
+    ebh_set_transport(transport);
+
+    check("link sync", ebh_link_sync(115200), EBH_UART_ERROR_ACK);
+
+    check("locked", ebh_rx_data_block_32(0x20001080, payload0, sizeof(payload0)), EBH_CORE_MSG_BSL_LOCKED);
+    check("password", ebh_rx_password_32(password_empty_msp432), EBH_CORE_MSG_OPERATION_SUCCESSFUL);
+
+    start = now_ns();
+    check("rx data block", ebh_rx_data_block_32(0x20000000, bulk, sizeof(bulk)), EBH_CORE_MSG_OPERATION_SUCCESSFUL);
+    check("crc check", ebh_crc_check_32(0x20000000, sizeof(bulk), &crc), EBH_UART_ERROR_ACK);
+    bulk_ns = now_ns() - start;
+    check("crc value", crc, ebh_crc_update(0xFFFF, bulk, sizeof(bulk)));
+    dump();
+    elf_file();
+    check("frame errors", target.frame_errors, 0);
+
+    // Silent target: the ACK timeout ends at its deadline in real time, not after a number of polls
+    pthread_mutex_lock(&target_lock);
+    target.rx_count = 3;
+    target.rx_length = 200;
+    pthread_mutex_unlock(&target_lock);
+    expected_us = EBH_ACK_TIMEOUT + ebh_line_time_us(EBH_FRAME_OVERHEAD + 1 + 1);
+    start = now_ns();
+    ebh_format_package(EBH_CMD_TX_BSL_VERSION, 0, 0, 0, 0, 0, 0, 0);
+    check("ack timeout", ebh_receive_ack(), EBH_UART_ERROR_TIME_OUT);
+    timeout_ns = now_ns() - start;
+    check("ack timeout early", timeout_ns < expected_us * 1000ull, 0);
+    check("ack timeout late", timeout_ns > expected_us * 1000ull + 40000000u, 0);  // Scheduling latency of a loaded host
+    ebh_resync();
+
+    printf("%-10s %u byte write + verify %.2f ms (%.0f byte/s), ACK timeout after %.2f ms (deadline %.2f ms)\n",
+           name, BULK_SIZE, bulk_ns / 1e6, BULK_SIZE * 1e9 / bulk_ns, timeout_ns / 1e6, expected_us / 1e3);
+    ebh_posix_close();
+}
+
+int main(void) {
+    pthread_t thread;
+    struct timespec ts;
+    uint16_t i = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    epoch_ns = (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+    for(i = 0; i < sizeof(bulk); i++) {
+        bulk[i] = (uint8_t)(i * 7 + (i >> 8));
+    }
+
+    master = posix_openpt(O_RDWR | O_NOCTTY);
+    if((master < 0) || grantpt(master) || unlockpt(master)) {
+        printf("no pty available\n");
+        return 1;
+    }
+    sim_target_init(&target, ebh_device_msp432);
+    pthread_create(&thread, 0, target_thread, 0);
+
+    // Pins without callbacks are not connected, with callbacks they follow the invoke sequence
+    ebh_invoke_sequence();
+    ebh_posix_set_gpio(&trace_gpio);
+    ebh_invoke_sequence();
+    ebh_posix_set_gpio(0);
+    check("invoke sequence", strcmp(pin_trace, "RTtrTtTRt"), 0);
+
+    run_session("uart poll", &ebh_transport_uart_poll);
+    run_session("posix", &ebh_transport_posix);
+
+    running = 0;
+    pthread_join(thread, 0);
+    close(master);
+
+    printf("%u/%u tests passed\n", test_pass, test_total);
+    return test_fail ? 1 : 0;
+}
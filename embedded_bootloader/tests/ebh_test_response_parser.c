@@ -0,0 +1,138 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Max Groening
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+/*
+ * Host side test (Linux / POSIX)
+ *
+ * Core response parser: resynchronization, length validation, CRC and buffer feeding.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "embedded_bootloader/bsl_frame.h"
+#include "embedded_bootloader/bootloader_protocol.h"
+
+uint16_t test_pass = 0;
+uint16_t test_fail = 0;
+uint16_t test_total = 0;
+
+static void check(const char *name, uint32_t result, uint32_t expected) {
+    if(result != expected) {
+        printf("FAIL %s: %lu != %lu\n", name, (unsigned long)result, (unsigned long)expected);
+        test_fail++;
+    } else {
+        test_pass++;
+    }
+    test_total++;
+}
+
+/* Core response "operation successful": 0x80 0x02 0x00 0x3B 0x00 CKL CKH */
+static uint16_t message_frame(uint8_t *frame) {
+    const uint8_t message[] = {EBH_CORE_MSG_MESSAGE, EBH_CORE_MSG_OPERATION_SUCCESSFUL};
+    uint16_t crc = ebh_crc_update(0xFFFF, message, sizeof(message));
+
+    frame[0] = EBH_HEADER;
+    frame[1] = 0x02;
+    frame[2] = 0x00;
+    frame[3] = message[0];
+    frame[4] = message[1];
+    frame[5] = crc & 0xFF;
+    frame[6] = (crc >> 8) & 0xFF;
+    return 7;
+}
+
+int main(void) {
+    ebh_response_parser parser;
+    uint8_t payload[4];
+    uint8_t stream[32];
+    uint16_t length = 0;
+    uint16_t consumed = 0;
+    uint16_t i = 0;
+    uint8_t status = 0;
+
+    /* Clean frame, fed as one buffer */
+    length = message_frame(stream);
+    ebh_parser_init(&parser, payload, sizeof(payload));
+    check("clean status", ebh_parser_feed(&parser, stream, length, &consumed), EBH_UART_ERROR_ACK);
+    check("clean consumed", consumed, length);
+    check("clean payload", payload[0], EBH_CORE_MSG_MESSAGE);
+    check("clean discarded", parser.discarded, 0);
+
+    /* Noise bytes and a false header (impossible length) in front of the frame */
+    stream[0] = 0x12;
+    stream[1] = 0x00;
+    stream[2] = EBH_HEADER;
+    stream[3] = 0xFF;
+    stream[4] = 0xFF;
+    length = 5 + message_frame(&stream[5]);
+    ebh_parser_init(&parser, payload, sizeof(payload));
+    check("resync status", ebh_parser_feed(&parser, stream, length, &consumed), EBH_UART_ERROR_ACK);
+    check("resync discarded", parser.discarded, 5);
+
+    /* Noise header directly followed by the real header */
+    stream[0] = EBH_HEADER;
+    length = 1 + message_frame(&stream[1]);
+    ebh_parser_init(&parser, payload, sizeof(payload));
+    status = EBH_PARSER_IN_PROGRESS;
+    for(i = 0; (i < length) && (status == EBH_PARSER_IN_PROGRESS); i++) {
+        status = ebh_parser_feed_byte(&parser, stream[i]);
+    }
+    check("double header status", status, EBH_UART_ERROR_ACK);
+    check("double header discarded", parser.discarded, 1);
+
+    /* False header with a possible length, the real frame starts inside the candidate */
+    stream[0] = EBH_HEADER;
+    stream[1] = 0x02;
+    stream[2] = 0x00;
+    length = 3 + message_frame(&stream[3]);
+    ebh_parser_init(&parser, payload, sizeof(payload));
+    check("replay status", ebh_parser_feed(&parser, stream, length, &consumed), EBH_UART_ERROR_ACK);
+    check("replay consumed", consumed, length);
+    check("replay payload", payload[1], EBH_CORE_MSG_OPERATION_SUCCESSFUL);
+    check("replay discarded", parser.discarded, 3);
+
+    /* Corrupted CRC */
+    length = message_frame(stream);
+    stream[6] ^= 0x01;
+    ebh_parser_init(&parser, payload, sizeof(payload));
+    check("crc status", ebh_parser_feed(&parser, stream, length, 0), EBH_UART_ERROR_CHECKSUM_INCORRECT);
+
+    /* Frame larger than the caller's buffer is consumed completely */
+    length = message_frame(stream);
+    length += message_frame(&stream[length]);
+    ebh_parser_init(&parser, payload, 1);
+    check("small buffer status", ebh_parser_feed(&parser, stream, length, &consumed), EBH_UART_ERROR_PACKET_SIZE_EXCEEDS_BUFFER);
+    check("small buffer consumed", consumed, 7);
+
+    /* Split over several buffers, the parser stops at the end of the frame */
+    ebh_parser_init(&parser, payload, sizeof(payload));
+    check("split first", ebh_parser_feed(&parser, stream, 3, &consumed), EBH_PARSER_IN_PROGRESS);
+    check("split second", ebh_parser_feed(&parser, &stream[3], length - 3, &consumed), EBH_UART_ERROR_ACK);
+    check("split consumed", consumed, 4);
+
+    printf("%u/%u tests passed\n", test_pass, test_total);
+    return test_fail ? 1 : 0;
+}
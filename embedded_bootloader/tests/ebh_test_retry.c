@@ -0,0 +1,173 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Max Groening
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+/*
+ * Host side test (Linux / POSIX)
+ *
+ * Retransmission of failed data block frames on the simulated target: BSL answers that are
+ * not retried, the retry limit, the downshift hook, and fault injection with random bit
+ * errors on the line (1e-4 and 1e-3 per byte) comparing goodput with and without retries.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "embedded_bootloader/embedded_bootloader.h"
+#include "embedded_bootloader/bootloader_protocol.h"
+#include "embedded_bootloader/link.h"
+#include "embedded_bootloader/tests/test_support.h"
+#include "embedded_bootloader/tests/sim_bsp.h"
+
+#define IMAGE_SIZE  0x10000u
+
+uint16_t test_pass = 0;
+uint16_t test_fail = 0;
+uint16_t test_total = 0;
+
+static sim_target target;
+static uint8_t image[IMAGE_SIZE];
+static uint8_t downshifts = 0;
+
+static uint8_t count_downshift(void) {
+    downshifts++;
+    return EBH_UART_ERROR_ACK;
+}
+
+static void start(uint32_t error_ppm) {
+    ebh_retry_policy policy = {EBH_RETRIES, EBH_RETRY_BACKOFF, EBH_RETRY_JITTER, 0, 0};
+
+    sim_target_init(&target, ebh_device_msp430_flash);
+    sim_bsp_attach(&target);
+    ebh_set_transport(&ebh_transport_uart_poll);
+    ebh_set_baud(115200);
+    target.baud = 115200;
+    target.locked = 0;
+    ebh_set_retry_policy(&policy);
+    sim_bsp_error_ppm = error_ppm;
+    sim_bsp_error_min_baud = 0;
+}
+
+static void policy(void) {
+    ebh_retry_policy none = {0, 0, 0, 0, 0};
+    ebh_retry_policy hook = {4, 100, 0, count_downshift, 2};
+    uint8_t version[4];
+
+    // Answers of the BSL are final
+    start(0);
+    target.locked = 1;
+    check("locked", ebh_rx_data_block(0x4400, image, 256), EBH_CORE_MSG_BSL_LOCKED);
+    check("locked frames", target.commands[EBH_CMD_RX_DATA_BLOCK], 1);
+    check("locked retries", ebh_retries(), 0);
+
+    // A frame the target rejects for what it is (NAK) would be rejected again
+    start(0);
+    check("learn buffer", ebh_write_region(0x4400, image, 16), EBH_UART_ERROR_ACK);
+    target.buffer_size = 100;
+    check("exceeds", ebh_write_region(0x4400, image, 0x400), EBH_UART_ERROR_PACKET_SIZE_EXCEEDS_BUFFER);
+    check("exceeds retries", ebh_retries(), 0);
+    check("exceeds frames", target.commands[EBH_CMD_RX_DATA_BLOCK], 1);
+
+    start(0);
+    check("learn buffer", ebh_write_region(0x4400, image, 16), EBH_UART_ERROR_ACK);
+    target.buffer_size = 100;
+    ebh_set_retry_policy(&none);
+    check("no retries", ebh_write_region(0x4400, image, 0x400), EBH_UART_ERROR_PACKET_SIZE_EXCEEDS_BUFFER);
+    check("no retries count", ebh_retries(), 0);
+
+    // Target at another baud rate: garbled NAKs, the hook is called once after the second failed attempt
+    start(0);
+    check("version", ebh_tx_bsl_version(ebh_device_msp430_flash, version), EBH_UART_ERROR_ACK);
+    ebh_set_retry_policy(&hook);
+    target.baud = 9600;
+    check("garbled", ebh_rx_data_block(0x4400, image, 16), EBH_UART_ERROR_HEADER_INCORRECT ^ 0x5A);
+    check("garbled retries", ebh_retries(), 4);
+    check("downshift hook", downshifts, 1);
+
+    // Silent target: timeouts, each followed by a resync
+    start(0);
+    check("version", ebh_tx_bsl_version(ebh_device_msp430_flash, version), EBH_UART_ERROR_ACK);
+    target.rx_count = 3;
+    target.rx_length = 200;  // Still collecting a frame with a corrupted length
+    check("timeout", ebh_rx_data_block(0x4400, image, 16), EBH_UART_ERROR_ACK);
+    check("timeout retries", ebh_retries(), 1);
+    check("timeout memory", memcmp(sim_target_memory(&target, 0x4400), image, 16), 0);
+}
+
+static void noisy_write(uint32_t error_ppm, uint8_t retries) {
+    ebh_retry_policy policy = {retries, EBH_RETRY_BACKOFF, EBH_RETRY_JITTER, 0, 0};
+    ebh_verify verify;
+    uint64_t start_ns = 0;
+    uint8_t status = 0;
+
+    start(0);
+    memset(sim_target_memory(&target, 0x4400), 0xFF, IMAGE_SIZE);
+    ebh_set_retry_policy(&policy);
+    sim_bsp_error_ppm = error_ppm;
+
+    start_ns = sim_bsp_time_ns;
+    status = ebh_write_region(0x4400, image, IMAGE_SIZE);
+    printf("byte error rate %.0e, %u retries: %s after %5.2f s, %3u frames sent again, %4u bit errors, goodput %5.0f byte/s\n",
+           error_ppm / 1e6, retries, status ? "failed" : "done  ", (sim_bsp_time_ns - start_ns) / 1e9,
+           (unsigned)ebh_retries(), (unsigned)sim_bsp_errors, status ? 0.0 : IMAGE_SIZE * 1e9 / (sim_bsp_time_ns - start_ns));
+
+    if(retries && ((error_ppm < 1000) || (retries > EBH_RETRIES))) {
+        check("noisy write", status, EBH_UART_ERROR_ACK);
+        check("noisy memory", memcmp(sim_target_memory(&target, 0x4400), image, IMAGE_SIZE), 0);
+
+        // Readback over the same line
+        ebh_verify_init(&verify, 0x4400, image);
+        check("noisy readback", ebh_tx_data_block(0x4400, IMAGE_SIZE, ebh_verify_sink, &verify), EBH_UART_ERROR_ACK);
+        check("noisy readback mismatches", verify.mismatches, 0);
+    }
+}
+
+static void noisy_fast(uint32_t error_ppm) {
+    start(error_ppm);
+    memset(sim_target_memory(&target, 0x4400), 0xFF, IMAGE_SIZE);
+    check("noisy fast", ebh_rx_data_block_fast(0x4400, image, 0x4000), EBH_UART_ERROR_ACK);
+    check("noisy fast memory", memcmp(sim_target_memory(&target, 0x4400), image, 0x4000), 0);
+}
+
+int main(void) {
+    uint32_t i = 0;
+
+    for(i = 0; i < IMAGE_SIZE; i++) {
+        image[i] = (uint8_t)(i * 11 + (i >> 8));
+    }
+
+    policy();
+
+    noisy_write(0, 0);
+    noisy_write(100, 0);
+    noisy_write(100, EBH_RETRIES);
+    noisy_write(1000, 0);
+    noisy_write(1000, EBH_RETRIES);
+    noisy_write(1000, 8);
+    noisy_fast(100);
+
+    printf("%u/%u tests passed\n", test_pass, test_total);
+    return test_fail ? 1 : 0;
+}
@@ -0,0 +1,131 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Max Groening
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+/*
+ * Host side test (Linux / POSIX)
+ *
+ * Runs RX_DATA_BLOCK_FAST against the simulated MSP430 target: write and verify,
+ * detection of a corrupted range by the final CRC check, and wall-clock time (simulated)
+ * of fast writes compared with the ACKed RX_DATA_BLOCK path at 115200 baud.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "embedded_bootloader/embedded_bootloader.h"
+#include "embedded_bootloader/bootloader_protocol.h"
+#include "embedded_bootloader/tests/test_support.h"
+#include "embedded_bootloader/tests/sim_bsp.h"
+
+#define BULK_ADDRESS  0x4400u
+#define BULK_SIZE     16384u
+
+uint16_t test_pass = 0;
+uint16_t test_fail = 0;
+uint16_t test_total = 0;
+
+static sim_target target;
+static uint8_t bulk[BULK_SIZE];
+
+static void start(ebh_device device) {
+    sim_target_init(&target, device);
+    sim_bsp_attach(&target);
+    ebh_set_transport(&ebh_transport_uart_poll);
+    ebh_set_baud(115200);
+    target.baud = 115200;
+}
+
+static void session(void) {
+    start(ebh_device_msp430_flash);
+
+    check("locked", ebh_rx_data_block_fast(0x1000, payload1, sizeof(payload1)), EBH_CORE_MSG_BSL_LOCKED);
+    check("locked memory", *sim_target_memory(&target, 0x1000), 0xFF);
+    check("password", ebh_rx_password(password_empty_msp430), EBH_CORE_MSG_OPERATION_SUCCESSFUL);
+
+    check("fast 1", ebh_rx_data_block_fast(0x1000, payload0, sizeof(payload0)), EBH_UART_ERROR_ACK);
+    check("fast 256", ebh_rx_data_block_fast(0x1000, payload2, sizeof(payload2)), EBH_UART_ERROR_ACK);
+    check("fast 513", ebh_rx_data_block_fast(0x1000, payload3, sizeof(payload3)), EBH_UART_ERROR_ACK);
+    check("memory", memcmp(sim_target_memory(&target, 0x1000), payload3, sizeof(payload3)), 0);
+    check("fast frames", target.commands[EBH_CMD_RX_DATA_BLOCK_FAST], 1 + 1 + 1 + 3);
+    check("nothing left", ebh_receive_char_available(), 0);
+    check("frame errors", target.frame_errors, 0);
+
+    // MSP432 does not know the command
+    start(ebh_device_msp432);
+    check("msp432 password", ebh_rx_password_32(password_empty_msp432), EBH_CORE_MSG_OPERATION_SUCCESSFUL);
+    check("msp432", ebh_rx_data_block_fast(0x1000, payload1, sizeof(payload1)) != EBH_UART_ERROR_ACK, 1);
+}
+
+static void corrupted(void) {
+    start(ebh_device_msp430_flash);
+    check("password", ebh_rx_password(password_empty_msp430), EBH_CORE_MSG_OPERATION_SUCCESSFUL);
+
+    // Flash that does not take the data is only seen by the final CRC check
+    target.write_error = 0x10;
+    check("write", ebh_rx_data_block_fast(0x4400, payload3, sizeof(payload3)), EBH_UART_ERROR_VERIFY_FAILED);
+    target.write_error = 0;
+    check("rewrite", ebh_rx_data_block_fast(0x4400, payload3, sizeof(payload3)), EBH_UART_ERROR_ACK);
+}
+
+static uint64_t bulk_write(uint8_t fast) {
+    uint64_t begin = 0;
+    uint16_t crc = 0;
+
+    start(ebh_device_msp430_flash);
+    check("password", ebh_rx_password(password_empty_msp430), EBH_CORE_MSG_OPERATION_SUCCESSFUL);
+
+    begin = sim_bsp_time_ns;
+    if(fast) {
+        check("bulk fast", ebh_rx_data_block_fast(BULK_ADDRESS, bulk, sizeof(bulk)), EBH_UART_ERROR_ACK);
+    } else {
+        check("bulk", ebh_rx_data_block(BULK_ADDRESS, bulk, sizeof(bulk)), EBH_CORE_MSG_OPERATION_SUCCESSFUL);
+        check("bulk crc", ebh_crc_check(BULK_ADDRESS, sizeof(bulk), &crc), EBH_UART_ERROR_ACK);
+        check("bulk crc value", crc, ebh_crc_update(0xFFFF, bulk, sizeof(bulk)));
+    }
+    check("bulk memory", memcmp(sim_target_memory(&target, BULK_ADDRESS), bulk, sizeof(bulk)), 0);
+    return sim_bsp_time_ns - begin;
+}
+
+int main(void) {
+    uint64_t acked_ns = 0;
+    uint64_t fast_ns = 0;
+    uint16_t i = 0;
+
+    for(i = 0; i < sizeof(bulk); i++) {
+        bulk[i] = (uint8_t)(i * 13 + (i >> 8));
+    }
+
+    session();
+    corrupted();
+
+    acked_ns = bulk_write(0);
+    fast_ns = bulk_write(1);
+    check("fast is faster", fast_ns < acked_ns, 1);
+
+    printf("%u byte write + verify at 115200 baud: acked %7.1f ms (%5.0f byte/s), fast %7.1f ms (%5.0f byte/s), simulated\n",
+           BULK_SIZE, acked_ns / 1e6, BULK_SIZE * 1e9 / acked_ns, fast_ns / 1e6, BULK_SIZE * 1e9 / fast_ns);
+
+    printf("%u/%u tests passed\n", test_pass, test_total);
+    return test_fail ? 1 : 0;
+}
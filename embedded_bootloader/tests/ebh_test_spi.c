@@ -0,0 +1,126 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Max Groening
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+/*
+ * Host side test (Linux / POSIX)
+ *
+ * Runs the SPI transport against the mock SPI device of the simulated BSP with the
+ * simulated target behind it: a BSL session, answers containing 0xFF (same as the idle
+ * fill of MISO) and write throughput per SPI clock rate, compared with UART at 115200 baud.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "embedded_bootloader/embedded_bootloader.h"
+#include "embedded_bootloader/bootloader_protocol.h"
+#include "embedded_bootloader/tests/test_support.h"
+#include "embedded_bootloader/tests/sim_bsp.h"
+
+#define BULK_SIZE  8192u
+
+uint16_t test_pass = 0;
+uint16_t test_fail = 0;
+uint16_t test_total = 0;
+
+static sim_target target;
+static uint8_t bulk[BULK_SIZE];
+
+static void start(uint8_t interface) {
+    sim_target_init(&target, ebh_device_msp432);
+    target.interface = interface;
+    sim_bsp_attach(&target);
+}
+
+static void session(void) {
+    uint8_t version[10];
+    uint16_t length = 0;
+    uint16_t crc = 0;
+
+    start(SIM_TARGET_SPI);
+    ebh_set_transport(&ebh_transport_spi);
+    check("set clock", ebh_set_baud(4000000), 0);
+
+    check("locked", ebh_rx_data_block_32(0x20001080, payload0, sizeof(payload0)), EBH_CORE_MSG_BSL_LOCKED);
+    check("password", ebh_rx_password_32(password_empty_msp432), EBH_CORE_MSG_OPERATION_SUCCESSFUL);
+    check("bsl version", ebh_tx_bsl_version(ebh_device_msp432, version), EBH_UART_ERROR_ACK);
+    check("rx data block 513", ebh_rx_data_block_32(0x20001080, payload3, sizeof(payload3)), EBH_CORE_MSG_OPERATION_SUCCESSFUL);
+    check("memory", memcmp(sim_target_memory(&target, 0x20001080), payload3, sizeof(payload3)), 0);
+
+    // A checksum with a 0xFF byte: data, not fill
+    for(length = 1; length < sizeof(payload3); length++) {
+        crc = ebh_crc_update(0xFFFF, payload3, length);
+        if(((crc & 0xFF) == 0xFF) || ((crc >> 8) == 0xFF)) {
+            break;
+        }
+    }
+    check("crc with 0xFF", ebh_crc_check_32(0x20001080, length, &crc), EBH_UART_ERROR_ACK);
+    check("crc with 0xFF value", crc, ebh_crc_update(0xFFFF, payload3, length));
+
+    check("mass erase", ebh_mass_erase(ebh_device_msp432), EBH_CORE_MSG_OPERATION_SUCCESSFUL);
+    check("frame errors", target.frame_errors, 0);
+    check("discarded", ebh_receive_discarded(), 0);
+}
+
+static void throughput(const char *name, const ebh_transport *transport, uint8_t interface, uint32_t rate) {
+    uint64_t begin = 0;
+    uint64_t time_ns = 0;
+    uint16_t crc = 0;
+
+    start(interface);
+    ebh_set_transport(transport);
+    ebh_set_baud(rate);
+    target.baud = rate;
+    check("password", ebh_rx_password_32(password_empty_msp432), EBH_CORE_MSG_OPERATION_SUCCESSFUL);
+
+    begin = sim_bsp_time_ns;
+    check("bulk write", ebh_rx_data_block_32(0x20000000, bulk, sizeof(bulk)), EBH_CORE_MSG_OPERATION_SUCCESSFUL);
+    check("bulk crc", ebh_crc_check_32(0x20000000, sizeof(bulk), &crc), EBH_UART_ERROR_ACK);
+    time_ns = sim_bsp_time_ns - begin;
+    check("bulk crc value", crc, ebh_crc_update(0xFFFF, bulk, sizeof(bulk)));
+
+    printf("%-5s %8lu: %u byte write + verify %7.2f ms (%6.0f byte/s, simulated)\n",
+           name, (unsigned long)rate, BULK_SIZE, time_ns / 1e6, BULK_SIZE * 1e9 / time_ns);
+}
+
+int main(void) {
+    uint16_t i = 0;
+
+    for(i = 0; i < sizeof(bulk); i++) {
+        bulk[i] = (uint8_t)(i * 7 + (i >> 8));
+    }
+
+    session();
+
+    throughput("uart", &ebh_transport_uart_poll, SIM_TARGET_UART, 115200);
+    throughput("spi", &ebh_transport_spi, SIM_TARGET_SPI, 1000000);
+    throughput("spi", &ebh_transport_spi, SIM_TARGET_SPI, 4000000);
+    throughput("spi", &ebh_transport_spi, SIM_TARGET_SPI, 8000000);
+    throughput("spi", &ebh_transport_spi, SIM_TARGET_SPI, 16000000);
+
+    printf("%u/%u tests passed\n", test_pass, test_total);
+    return test_fail ? 1 : 0;
+}
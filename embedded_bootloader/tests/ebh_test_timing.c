@@ -0,0 +1,162 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Max Groening
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+/*
+ * Host side test (Linux / POSIX)
+ *
+ * Microsecond clock and deadlines (timing.h) on the simulated clock: comparisons across
+ * the wrap around of the counter, line times, and the ACK deadline for a prompt, a slow
+ * and a silent target.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "embedded_bootloader/embedded_bootloader.h"
+#include "embedded_bootloader/bootloader_protocol.h"
+#include "embedded_bootloader/config.h"
+#include "embedded_bootloader/timing.h"
+#include "embedded_bootloader/devices/devices.h"
+#include "embedded_bootloader/tests/test_support.h"
+#include "embedded_bootloader/tests/sim_bsp.h"
+
+uint16_t test_pass = 0;
+uint16_t test_fail = 0;
+uint16_t test_total = 0;
+
+static sim_target target;
+
+static void deadlines(void) {
+    ebh_deadline deadline = 0;
+
+    // 100 us before the counter wraps around
+    sim_bsp_time_ns = (0x100000000ull - 100u) * 1000u;
+    check("clock", ebh_time_us(), 0xFFFFFF9C);
+    deadline = ebh_deadline_in(1000);
+    check("deadline wraps", deadline, 900);
+    check("pending", ebh_deadline_expired(deadline), 0);
+    check("left", ebh_deadline_left(deadline), 1000);
+
+    ebh_delay_us(500);
+    check("pending after wrap", ebh_deadline_expired(deadline), 0);
+    check("left after wrap", ebh_deadline_left(deadline), 500);
+
+    ebh_delay_us(500);
+    check("expired", ebh_deadline_expired(deadline), 1);
+    check("left expired", ebh_deadline_left(deadline), 0);
+    ebh_delay_us(700);
+    check("still expired", ebh_deadline_expired(deadline), 1);
+    check("left still expired", ebh_deadline_left(deadline), 0);
+
+    check("immediate", ebh_deadline_expired(ebh_deadline_in(0)), 1);
+}
+
+static void line_times(void) {
+    sim_target_init(&target, ebh_device_msp430_flash);
+    sim_bsp_attach(&target);
+    ebh_set_transport(&ebh_transport_uart_poll);
+
+    check("9600 byte", ebh_line_time_us(1), 1145);
+    check("9600 frame", ebh_line_time_us(EBH_MAX_FRAME_SIZE), EBH_MAX_FRAME_SIZE * 11000000ull / 9600);
+    check("set baud", ebh_set_baud(115200), 0);
+    check("get baud", ebh_get_baud(), 115200);
+    check("115200 byte", ebh_line_time_us(1), 95);
+}
+
+/* Time from sending TX_BSL_VERSION until ebh_receive_ack() returns */
+static uint32_t ack_time(uint8_t *ack) {
+    uint64_t start = 0;
+
+    start = sim_bsp_time_ns;
+    ebh_format_package(EBH_CMD_TX_BSL_VERSION, 0, 0, 0, 0, 0, 0, 0);
+    *ack = ebh_receive_ack();
+    return (uint32_t)((sim_bsp_time_ns - start) / 1000u);
+}
+
+static void ack_deadline(void) {
+    uint32_t deadline_us = 0;
+    uint32_t prompt_us = 0;
+    uint32_t slow_us = 0;
+    uint32_t silent_us = 0;
+    uint8_t response[16];
+    uint8_t version[4];
+    uint8_t ack = 0;
+
+    sim_target_init(&target, ebh_device_msp430_flash);
+    sim_bsp_attach(&target);
+    ebh_set_transport(&ebh_transport_uart_poll);
+    ebh_set_baud(115200);
+    target.baud = 115200;
+    target.locked = 0;
+    deadline_us = EBH_ACK_TIMEOUT + ebh_line_time_us(EBH_FRAME_OVERHEAD + 1 + 1);
+
+    prompt_us = ack_time(&ack);
+    check("prompt ack", ack, EBH_UART_ERROR_ACK);
+    check("prompt response", ebh_receive_core_response(response, sizeof(response), 0), EBH_UART_ERROR_ACK);
+    check("prompt time", prompt_us < 1000, 1);
+
+    // Busy for 8 ms: still within the deadline
+    ebh_delay_between_commands();
+    target.busy_until_ns = sim_bsp_time_ns + 8000000u;
+    slow_us = ack_time(&ack);
+    printf("ACK of a target busy for 8 ms after %u us\n", slow_us);
+    check("slow ack", ack, EBH_UART_ERROR_ACK);
+    check("slow response", ebh_receive_core_response(response, sizeof(response), 0), EBH_UART_ERROR_ACK);
+    check("slow time", (slow_us > 8000) && (slow_us < deadline_us), 1);
+
+    // Busy for 20 ms: the wait ends at the deadline
+    ebh_delay_between_commands();
+    target.busy_until_ns = sim_bsp_time_ns + 20000000u;
+    slow_us = ack_time(&ack);
+    check("busy timeout", (slow_us >= deadline_us) && (slow_us < deadline_us + EBH_UART_POLL_INTERVAL), 1);
+    check("busy ack", ack, EBH_UART_ERROR_TIME_OUT);
+    ebh_delay_us(EBH_ACK_TIMEOUT);
+    ebh_flush();
+
+    // Silent target (still collecting a frame with a corrupted length)
+    ebh_delay_between_commands();
+    target.rx_count = 3;
+    target.rx_length = 200;
+    silent_us = ack_time(&ack);
+    check("silent ack", ack, EBH_UART_ERROR_TIME_OUT);
+    check("silent time", (silent_us >= deadline_us) && (silent_us < deadline_us + EBH_UART_POLL_INTERVAL), 1);
+    ebh_resync();
+
+    // A sync character without a frame before only waits for the ACK itself
+    ebh_delay_between_commands();
+    check("version after resync", ebh_tx_bsl_version(ebh_device_msp430_flash, version), EBH_UART_ERROR_ACK);
+
+    printf("ACK at 115200 baud: prompt %u us, silent target times out after %u us (deadline %u us)\n",
+           prompt_us, silent_us, deadline_us);
+}
+
+int main(void) {
+    deadlines();
+    line_times();
+    ack_deadline();
+
+    printf("%u/%u tests passed\n", test_pass, test_total);
+    return test_fail ? 1 : 0;
+}
@@ -0,0 +1,85 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Max Groening
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+/*
+ * Host side test (Linux / POSIX)
+ *
+ * Runs the same BSL session over transports selected at runtime: the polling and DMA UART
+ * (on the simulated BSP) and the mock transport. All talk to the simulated target.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "embedded_bootloader/embedded_bootloader.h"
+#include "embedded_bootloader/bootloader_protocol.h"
+#include "embedded_bootloader/link.h"
+#include "embedded_bootloader/tests/test_support.h"
+#include "embedded_bootloader/tests/sim_bsp.h"
+
+uint16_t test_pass = 0;
+uint16_t test_fail = 0;
+uint16_t test_total = 0;
+uint8_t status = 0;
+
+static sim_target target;
+
+static void run_session(const char *name, const ebh_transport *transport) {
+    uint16_t crc = 0;
+
+    sim_target_init(&target, ebh_device_msp432);
+    sim_bsp_attach(&target);
+    ebh_set_transport(transport);
+
+    check("link sync", ebh_link_sync(115200), EBH_UART_ERROR_ACK);
+
+    /* Locked BSL shall respond with BSL LOCKED */
+    check("locked", ebh_rx_data_block_32(0x20001080, payload0, sizeof(payload0)), EBH_CORE_MSG_BSL_LOCKED);
+    ebh_delay_between_commands();
+
+    check("password", ebh_rx_password_32(password_empty_msp432), EBH_CORE_MSG_OPERATION_SUCCESSFUL);
+    ebh_delay_between_commands();
+
+    check("rx data block 513", ebh_rx_data_block_32(0x20001080, payload3, sizeof(payload3)), EBH_CORE_MSG_OPERATION_SUCCESSFUL);
+    ebh_delay_between_commands();
+    check("memory", memcmp(sim_target_memory(&target, 0x20001080), payload3, sizeof(payload3)), 0);
+
+    check("crc check", ebh_crc_check_32(0x20001080, sizeof(payload3), &crc), EBH_UART_ERROR_ACK);
+    check("crc value", crc, ebh_crc_update(0xFFFF, payload3, sizeof(payload3)));
+    ebh_delay_between_commands();
+
+    printf("%-10s session took %.1f ms (simulated)\n", name, sim_bsp_time_ns / 1e6);
+}
+
+int main(void) {
+    run_session("uart poll", &ebh_transport_uart_poll);
+    ebh_uart_dma_start();
+    run_session("uart dma", &ebh_transport_uart_dma);
+    run_session("mock", &ebh_transport_mock);
+
+    printf("%u/%u tests passed\n", test_pass, test_total);
+    return test_fail ? 1 : 0;
+}
@@ -0,0 +1,138 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Max Groening
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+/*
+ * Host side test (Linux / POSIX)
+ *
+ * Checks TX_BUFFER_SIZE on the simulated target: the answer is cached per session, the
+ * data block writers size their packets to it and fall back to 256 byte blocks on targets
+ * not knowing the command. Compares the write time of a standard and an enlarged BSL buffer.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "embedded_bootloader/embedded_bootloader.h"
+#include "embedded_bootloader/bootloader_protocol.h"
+#include "embedded_bootloader/tests/test_support.h"
+#include "embedded_bootloader/tests/sim_bsp.h"
+
+#define BULK_ADDRESS  0x4400u
+#define BULK_SIZE     16384u
+
+uint16_t test_pass = 0;
+uint16_t test_fail = 0;
+uint16_t test_total = 0;
+
+static sim_target target;
+static uint8_t bulk[BULK_SIZE];
+
+static void start(ebh_device device, uint16_t buffer_size) {
+    sim_target_init(&target, device);
+    if(buffer_size) {
+        target.buffer_size = buffer_size;
+    }
+    sim_bsp_attach(&target);
+    ebh_set_transport(&ebh_transport_uart_poll);
+    ebh_set_baud(115200);
+    target.baud = 115200;
+}
+
+static void session(void) {
+    uint16_t size = 0;
+
+    start(ebh_device_msp430_flash, 0);
+    check("locked", ebh_tx_buffer_size(&size), EBH_CORE_MSG_BSL_LOCKED);
+    check("locked write", ebh_rx_data_block(0x1000, payload3, sizeof(payload3)), EBH_CORE_MSG_BSL_LOCKED);
+    check("password", ebh_rx_password(password_empty_msp430), EBH_CORE_MSG_OPERATION_SUCCESSFUL);
+    check("buffer size", ebh_tx_buffer_size(&size), EBH_UART_ERROR_ACK);
+    check("buffer size value", size, 256 + 1 + 3);
+
+    // Queried once, 513 bytes are three 256 byte blocks at most
+    target.commands[EBH_CMD_TX_BUFFER_SIZE] = 0;
+    target.commands[EBH_CMD_RX_DATA_BLOCK] = 0;
+    check("write", ebh_rx_data_block(0x1000, payload3, sizeof(payload3)), EBH_CORE_MSG_OPERATION_SUCCESSFUL);
+    check("write again", ebh_rx_data_block(0x1000, payload3, sizeof(payload3)), EBH_CORE_MSG_OPERATION_SUCCESSFUL);
+    check("memory", memcmp(sim_target_memory(&target, 0x1000), payload3, sizeof(payload3)), 0);
+    check("cached", target.commands[EBH_CMD_TX_BUFFER_SIZE], 0);
+    check("blocks", target.commands[EBH_CMD_RX_DATA_BLOCK], 2 * 3);
+
+    // Enlarged buffer of a custom BSL, learned again after a session reset
+    target.buffer_size = 1024 + 1 + 3;
+    ebh_session_reset();
+    target.commands[EBH_CMD_RX_DATA_BLOCK] = 0;
+    check("write 1024", ebh_rx_data_block(0x4400, bulk, 2048 + 1), EBH_CORE_MSG_OPERATION_SUCCESSFUL);
+    check("memory 1024", memcmp(sim_target_memory(&target, 0x4400), bulk, 2048 + 1), 0);
+    check("queried", target.commands[EBH_CMD_TX_BUFFER_SIZE], 1);
+    check("blocks 1024", target.commands[EBH_CMD_RX_DATA_BLOCK], 3);
+    check("fast 1024", ebh_rx_data_block_fast(0x4400, bulk, 4096), EBH_UART_ERROR_ACK);
+    check("fast blocks 1024", target.commands[EBH_CMD_RX_DATA_BLOCK_FAST], 4);
+    check("frame errors", target.frame_errors, 0);
+
+    // MSP432 does not know the command: 256 byte blocks, not asked again
+    start(ebh_device_msp432, 0);
+    check("msp432 password", ebh_rx_password_32(password_empty_msp432), EBH_CORE_MSG_OPERATION_SUCCESSFUL);
+    check("msp432 write", ebh_rx_data_block_32(0x20000000, payload3, sizeof(payload3)), EBH_CORE_MSG_OPERATION_SUCCESSFUL);
+    check("msp432 write again", ebh_rx_data_block_32(0x20000000, payload3, sizeof(payload3)), EBH_CORE_MSG_OPERATION_SUCCESSFUL);
+    check("msp432 memory", memcmp(sim_target_memory(&target, 0x20000000), payload3, sizeof(payload3)), 0);
+    check("msp432 queried", target.commands[EBH_CMD_TX_BUFFER_SIZE], 1);
+    check("msp432 blocks", target.commands[EBH_CMD_RX_DATA_BLOCK_32], 2 * 3);
+    check("msp432 discarded", ebh_receive_char_available(), 0);
+}
+
+static uint64_t bulk_write(uint16_t buffer_size) {
+    uint64_t begin = 0;
+    uint16_t crc = 0;
+
+    start(ebh_device_msp430_flash, buffer_size);
+    check("password", ebh_rx_password(password_empty_msp430), EBH_CORE_MSG_OPERATION_SUCCESSFUL);
+
+    begin = sim_bsp_time_ns;
+    check("bulk", ebh_rx_data_block(BULK_ADDRESS, bulk, sizeof(bulk)), EBH_CORE_MSG_OPERATION_SUCCESSFUL);
+    check("bulk crc", ebh_crc_check(BULK_ADDRESS, sizeof(bulk), &crc), EBH_UART_ERROR_ACK);
+    check("bulk crc value", crc, ebh_crc_update(0xFFFF, bulk, sizeof(bulk)));
+    return sim_bsp_time_ns - begin;
+}
+
+int main(void) {
+    uint64_t standard_ns = 0;
+    uint64_t large_ns = 0;
+    uint16_t i = 0;
+
+    for(i = 0; i < sizeof(bulk); i++) {
+        bulk[i] = (uint8_t)(i * 13 + (i >> 8));
+    }
+
+    session();
+
+    standard_ns = bulk_write(0);
+    large_ns = bulk_write(1024 + 1 + 3);
+    check("large buffer is faster", large_ns < standard_ns, 1);
+
+    printf("%u byte write + verify at 115200 baud: 260 byte buffer %7.1f ms (%5.0f byte/s), 1028 byte buffer %7.1f ms (%5.0f byte/s), simulated\n",
+           BULK_SIZE, standard_ns / 1e6, BULK_SIZE * 1e9 / standard_ns, large_ns / 1e6, BULK_SIZE * 1e9 / large_ns);
+
+    printf("%u/%u tests passed\n", test_pass, test_total);
+    return test_fail ? 1 : 0;
+}
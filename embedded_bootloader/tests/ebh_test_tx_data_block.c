@@ -0,0 +1,160 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Max Groening
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+/*
+ * Host side test (Linux / POSIX)
+ *
+ * Reads memory back from the simulated target with TX_DATA_BLOCK / TX_DATA_BLOCK_32:
+ * block sizing, sink abort, the verify sink locating differing bytes, and the time to
+ * dump a 256 kB MSP432 flash at 115200 baud compared with the raw line rate.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "embedded_bootloader/embedded_bootloader.h"
+#include "embedded_bootloader/bootloader_protocol.h"
+#include "embedded_bootloader/tests/test_support.h"
+#include "embedded_bootloader/tests/sim_bsp.h"
+
+#define FLASH_SIZE  0x40000u
+
+uint16_t test_pass = 0;
+uint16_t test_fail = 0;
+uint16_t test_total = 0;
+
+static sim_target target;
+static uint8_t image[FLASH_SIZE];
+static uint8_t readback[FLASH_SIZE];
+static uint32_t readback_base = 0;
+static uint32_t readback_blocks = 0;
+static uint16_t readback_largest = 0;
+
+static uint8_t collect(void *context, uint32_t addr, const uint8_t *data, uint16_t length) {
+    memcpy(&readback[addr - readback_base], data, length);
+    readback_blocks++;
+    if(length > readback_largest) {
+        readback_largest = length;
+    }
+    return 0;
+}
+
+static uint8_t abort_second(void *context, uint32_t addr, const uint8_t *data, uint16_t length) {
+    return (addr == readback_base) ? 0 : 0x42;
+}
+
+static void start(ebh_device device) {
+    sim_target_init(&target, device);
+    sim_bsp_attach(&target);
+    ebh_set_transport(&ebh_transport_uart_poll);
+    ebh_set_baud(115200);
+    target.baud = 115200;
+}
+
+static void msp430(void) {
+    ebh_verify verify;
+
+    start(ebh_device_msp430_flash);
+    readback_base = 0x4400;
+    check("locked", ebh_tx_data_block(0x4400, 16, collect, 0), EBH_CORE_MSG_BSL_LOCKED);
+    check("password", ebh_rx_password(password_empty_msp430), EBH_CORE_MSG_OPERATION_SUCCESSFUL);
+    check("write", ebh_rx_data_block(0x4400, payload3, sizeof(payload3)), EBH_CORE_MSG_OPERATION_SUCCESSFUL);
+
+    readback_blocks = 0;
+    readback_largest = 0;
+    check("read", ebh_tx_data_block(0x4400, sizeof(payload3), collect, 0), EBH_UART_ERROR_ACK);
+    check("read content", memcmp(readback, payload3, sizeof(payload3)), 0);
+    check("read blocks", readback_blocks, 3);
+    check("read largest", readback_largest, 256);
+    check("read nothing", ebh_tx_data_block(0x4400, 0, collect, 0), EBH_UART_ERROR_ACK);
+    check("abort", ebh_tx_data_block(0x4400, sizeof(payload3), abort_second, 0), 0x42);
+
+    ebh_verify_init(&verify, 0x4400, payload3);
+    check("verify", ebh_tx_data_block(0x4400, sizeof(payload3), ebh_verify_sink, &verify), EBH_UART_ERROR_ACK);
+    check("verify mismatches", verify.mismatches, 0);
+
+    *sim_target_memory(&target, 0x4400 + 17) ^= 0x01;
+    *sim_target_memory(&target, 0x4400 + 300) ^= 0x80;
+    *sim_target_memory(&target, 0x4400 + 512) = ~payload3[512];
+    ebh_verify_init(&verify, 0x4400, payload3);
+    check("verify damaged", ebh_tx_data_block(0x4400, sizeof(payload3), ebh_verify_sink, &verify), EBH_UART_ERROR_ACK);
+    check("verify damaged mismatches", verify.mismatches, 3);
+    check("verify damaged first", verify.first_mismatch, 0x4400 + 17);
+    check("verify damaged last", verify.last_mismatch, 0x4400 + 512);
+
+    // A short block is not passed on, it would shift the rest of the image
+    target.read_short = 1;
+    readback_blocks = 0;
+    check("short block", ebh_tx_data_block(0x4400, sizeof(payload3), collect, 0), EBH_UART_ERROR_RESPONSE_INVALID);
+    check("short block sink", readback_blocks, 0);
+    target.read_short = 0;
+
+    check("frame errors", target.frame_errors, 0);
+}
+
+static void msp432_dump(void) {
+    ebh_verify verify;
+    uint64_t begin = 0;
+    uint64_t dump_ns = 0;
+    uint64_t line_ns = 0;
+
+    start(ebh_device_msp432);
+    memcpy(sim_target_memory(&target, 0), image, sizeof(image));
+    check("msp432 password", ebh_rx_password_32(password_empty_msp432), EBH_CORE_MSG_OPERATION_SUCCESSFUL);
+
+    readback_base = 0;
+    readback_blocks = 0;
+    readback_largest = 0;
+    begin = sim_bsp_time_ns;
+    check("dump", ebh_tx_data_block_32(0, FLASH_SIZE, collect, 0), EBH_UART_ERROR_ACK);
+    dump_ns = sim_bsp_time_ns - begin;
+    check("dump content", memcmp(readback, image, sizeof(image)), 0);
+    check("dump blocks", readback_blocks, FLASH_SIZE / 256);
+
+    // Only the payload counted: 11 bit per byte at 115200 baud
+    line_ns = FLASH_SIZE * 11000000000ull / 115200;
+    printf("256 kB dump at 115200 baud %.2f s (%.0f byte/s, %.0f %% of the line rate, simulated)\n",
+           dump_ns / 1e9, FLASH_SIZE * 1e9 / dump_ns, 100.0 * line_ns / dump_ns);
+
+    *sim_target_memory(&target, 0x3FFFF) ^= 0xFF;
+    ebh_verify_init(&verify, 0, image);
+    check("verify", ebh_tx_data_block_32(0, FLASH_SIZE, ebh_verify_sink, &verify), EBH_UART_ERROR_ACK);
+    check("verify mismatches", verify.mismatches, 1);
+    check("verify first", verify.first_mismatch, 0x3FFFF);
+    check("frame errors", target.frame_errors, 0);
+}
+
+int main(void) {
+    uint32_t i = 0;
+
+    for(i = 0; i < sizeof(image); i++) {
+        image[i] = (uint8_t)(i * 13 + (i >> 8) + (i >> 16));
+    }
+
+    msp430();
+    msp432_dump();
+
+    printf("%u/%u tests passed\n", test_pass, test_total);
+    return test_fail ? 1 : 0;
+}
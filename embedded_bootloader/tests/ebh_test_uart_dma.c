@@ -0,0 +1,179 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Max Groening
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+/*
+ * Host side test (Linux / POSIX threads)
+ *
+ * Exercises the DMA UART backend on the emulated UART peripheral (emu_bsp.c), where a
+ * worker thread plays the DMA controller:
+ *   - a BSL session over polling and DMA, with the time the application is blocked,
+ *   - frames queued from the TX completion hook (pipelining),
+ *   - wrap around of the circular RX buffer.
+ *
+ * Link emu_bsp.c instead of sim_bsp.c.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "embedded_bootloader/embedded_bootloader.h"
+#include "embedded_bootloader/bootloader_protocol.h"
+#include "embedded_bootloader/tests/test_support.h"
+#include "embedded_bootloader/tests/emu_bsp.h"
+
+#define PIPELINE_FRAMES  8u
+#define RESPONSE_SIZE    8u   // ACK + "operation successful" core message frame
+#define WRAP_CHECKS      100u
+
+uint16_t test_pass = 0;
+uint16_t test_fail = 0;
+uint16_t test_total = 0;
+
+
+/*
+ * BSL session on both backends
+ */
+
+static void run_session(const char *name, const ebh_transport *transport) {
+    uint64_t start = 0;
+    uint64_t send_ns = 0;
+    uint64_t session_ns = 0;
+    uint8_t rx_buf[2];
+    uint16_t crc = 0;
+
+    emu_bsp_reset(ebh_device_msp432);
+    ebh_set_transport(transport);
+    check("password", ebh_rx_password_32(password_empty_msp432), EBH_CORE_MSG_OPERATION_SUCCESSFUL);
+
+    start = emu_bsp_now_ns();
+    ebh_format_package(EBH_CMD_RX_DATA_BLOCK_32, 4, 0x80, 0x10, 0x00, 0x20, payload2, sizeof(payload2));
+    send_ns = emu_bsp_now_ns() - start;
+    check("ack", ebh_receive_ack(), EBH_UART_ERROR_ACK);
+    check("response", ebh_receive_core_response(rx_buf, 2, 0), EBH_UART_ERROR_ACK);
+
+    start = emu_bsp_now_ns();
+    check("rx data block", ebh_rx_data_block_32(0x20001080, payload3, sizeof(payload3)), EBH_CORE_MSG_OPERATION_SUCCESSFUL);
+    check("crc check", ebh_crc_check_32(0x20001080, sizeof(payload3), &crc), EBH_UART_ERROR_ACK);
+    session_ns = emu_bsp_now_ns() - start;
+    check("crc value", crc, ebh_crc_update(0xFFFF, payload3, sizeof(payload3)));
+
+    printf("%-8s send returns after %7.1f us, 513 byte write + verify %6.2f ms\n",
+           name, send_ns / 1e3, session_ns / 1e6);
+}
+
+
+/*
+ * Pipelining: the TX completion hook queues the next frame
+ */
+
+static uint8_t frames[PIPELINE_FRAMES][EBH_MAX_FRAME_SIZE];
+static uint16_t frame_lengths[PIPELINE_FRAMES];
+static volatile uint8_t frames_sent = 0;
+static volatile uint8_t hook_calls = 0;
+
+static void pipeline_hook(void) {
+    hook_calls++;
+    if(frames_sent < PIPELINE_FRAMES) {
+        ebh_send_buf(frames[frames_sent], frame_lengths[frames_sent]);
+        frames_sent++;
+    }
+}
+
+static void pipeline(void) {
+    uint8_t responses[PIPELINE_FRAMES * RESPONSE_SIZE];
+    uint64_t start = 0;
+    uint64_t app_ns = 0;
+    uint64_t total_ns = 0;
+    uint32_t addr = 0;
+    uint16_t crc = 0;
+    uint8_t i = 0;
+
+    for(i = 0; i < PIPELINE_FRAMES; i++) {
+        addr = 0x20002000 + i * sizeof(payload2);
+        frame_lengths[i] = ebh_build_frame(frames[i], sizeof(frames[i]), EBH_CMD_RX_DATA_BLOCK_32, 4,
+                                           (uint8_t)addr, (uint8_t)(addr >> 8), (uint8_t)(addr >> 16), (uint8_t)(addr >> 24),
+                                           payload2, sizeof(payload2));
+    }
+
+    // The application only starts the first frame, everything else runs from the completion interrupt
+    start = emu_bsp_now_ns();
+    frames_sent = 1;
+    ebh_uart_dma_set_tx_hook(pipeline_hook);
+    ebh_send_buf(frames[0], frame_lengths[0]);
+    app_ns = emu_bsp_now_ns() - start;
+
+    check("pipeline responses", ebh_receive_buf(responses, sizeof(responses), 1000000), sizeof(responses));
+    total_ns = emu_bsp_now_ns() - start;
+    ebh_uart_dma_set_tx_hook(0);
+
+    check("pipeline frames sent", frames_sent, PIPELINE_FRAMES);
+    check("pipeline hook calls", hook_calls, PIPELINE_FRAMES);
+    for(i = 0; i < PIPELINE_FRAMES; i++) {
+        check("pipeline ack", responses[i * RESPONSE_SIZE], EBH_UART_ERROR_ACK);
+        check("pipeline message", responses[i * RESPONSE_SIZE + 5], EBH_CORE_MSG_OPERATION_SUCCESSFUL);
+    }
+    check("pipeline crc check", ebh_crc_check_32(0x20002000, PIPELINE_FRAMES * sizeof(payload2), &crc), EBH_UART_ERROR_ACK);
+    check("pipeline target frames", emu_bsp_target.frame_errors, 0);
+
+    printf("pipeline %u frames: application busy %.1f us, %.2f ms total (%.0f byte/s)\n",
+           PIPELINE_FRAMES, app_ns / 1e3, total_ns / 1e6, PIPELINE_FRAMES * sizeof(payload2) * 1e9 / total_ns);
+}
+
+
+/*
+ * Circular RX buffer: more answer bytes than EBH_UART_DMA_RX_SIZE
+ */
+
+static void rx_wrap(void) {
+    uint16_t expected = ebh_crc_update(0xFFFF, payload3, sizeof(payload3));
+    uint16_t errors = 0;
+    uint16_t crc = 0;
+    uint16_t i = 0;
+
+    for(i = 0; i < WRAP_CHECKS; i++) {
+        crc = 0;
+        if((ebh_crc_check_32(0x20001080, sizeof(payload3), &crc) != EBH_UART_ERROR_ACK) || (crc != expected)) {
+            errors++;
+        }
+    }
+    check("rx wrap", errors, 0);
+    check("rx overruns", ebh_uart_dma_rx_overruns(), 0);
+}
+
+int main(void) {
+    emu_bsp_start();
+
+    run_session("polling", &ebh_transport_uart_poll);
+    ebh_uart_dma_start();
+    run_session("dma", &ebh_transport_uart_dma);
+    pipeline();
+    rx_wrap();
+    check("tx idle", ebh_uart_dma_tx_idle(), 1);
+
+    emu_bsp_stop();
+
+    printf("%u/%u tests passed\n", test_pass, test_total);
+    return test_fail ? 1 : 0;
+}
@@ -0,0 +1,162 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Max Groening
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+/*
+ * Host side test (Linux / POSIX threads)
+ *
+ * Exercises the interrupt driven UART backend on the emulated UART peripheral (emu_bsp.c).
+ * Also stress tests the SPSC ring buffer between two threads and compares throughput
+ * and latency with the polling backend on the same emulated peripheral.
+ *
+ * Link emu_bsp.c instead of sim_bsp.c.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sched.h>
+#include <pthread.h>
+
+#include "embedded_bootloader/embedded_bootloader.h"
+#include "embedded_bootloader/bootloader_protocol.h"
+#include "embedded_bootloader/ring_buffer.h"
+#include "embedded_bootloader/tests/test_support.h"
+#include "embedded_bootloader/tests/emu_bsp.h"
+
+#define RING_STRESS_BYTES  500000u
+
+uint16_t test_pass = 0;
+uint16_t test_fail = 0;
+uint16_t test_total = 0;
+
+
+/*
+ * SPSC ring buffer stress test: producer and consumer on different threads
+ */
+
+static uint8_t stress_buffer[64];
+static ebh_ring_buffer stress_ring;
+
+static void *stress_producer(void *arg) {
+    uint32_t sent = 0;
+    uint32_t before = 0;
+    uint8_t chunk[7];
+    uint16_t i = 0;
+
+    while(sent < RING_STRESS_BYTES) {
+        before = sent;
+        if(sent & 1) {
+            for(i = 0; i < sizeof(chunk); i++) {
+                chunk[i] = (uint8_t)(sent + i);
+            }
+            sent += ebh_ring_put(&stress_ring, chunk, sizeof(chunk));
+        } else {
+            sent += ebh_ring_put_char(&stress_ring, (uint8_t)sent);
+        }
+        if(sent == before) {
+            sched_yield();
+        }
+    }
+    return 0;
+}
+
+static void ring_stress(void) {
+    pthread_t producer;
+    uint32_t received = 0;
+    uint32_t errors = 0;
+    uint8_t chunk[5];
+    uint16_t n = 0;
+    uint16_t i = 0;
+
+    ebh_ring_init(&stress_ring, stress_buffer, sizeof(stress_buffer));
+    pthread_create(&producer, 0, stress_producer, 0);
+    while(received < RING_STRESS_BYTES) {
+        n = ebh_ring_get(&stress_ring, chunk, sizeof(chunk));
+        for(i = 0; i < n; i++) {
+            if(chunk[i] != (uint8_t)(received + i)) {
+                errors++;
+            }
+        }
+        received += n;
+        if(n == 0) {
+            sched_yield();
+        }
+    }
+    pthread_join(producer, 0);
+    check("ring stress order", errors, 0);
+    check("ring empty", ebh_ring_count(&stress_ring), 0);
+}
+
+
+/*
+ * BSL session on both backends
+ */
+
+static void run_session(const char *name, const ebh_transport *transport) {
+    uint64_t start = 0;
+    uint64_t send_ns = 0;
+    uint64_t ack_ns = 0;
+    uint64_t session_ns = 0;
+    uint16_t crc = 0;
+
+    emu_bsp_reset(ebh_device_msp432);
+    ebh_set_transport(transport);
+
+    start = emu_bsp_now_ns();
+    check("password", ebh_rx_password_32(password_empty_msp432), EBH_CORE_MSG_OPERATION_SUCCESSFUL);
+
+    // Latency: how long the application is blocked by sending a 256 byte block
+    start = emu_bsp_now_ns();
+    ebh_format_package(EBH_CMD_RX_DATA_BLOCK_32, 4, 0x80, 0x10, 0x00, 0x20, payload2, sizeof(payload2));
+    send_ns = emu_bsp_now_ns() - start;
+    check("ack", ebh_receive_ack(), EBH_UART_ERROR_ACK);
+    ack_ns = emu_bsp_now_ns() - start;
+    check("response", ebh_receive_core_response(stress_buffer, 2, 0), EBH_UART_ERROR_ACK);
+
+    // Throughput: complete write and verify
+    start = emu_bsp_now_ns();
+    check("rx data block", ebh_rx_data_block_32(0x20001080, payload3, sizeof(payload3)), EBH_CORE_MSG_OPERATION_SUCCESSFUL);
+    check("crc check", ebh_crc_check_32(0x20001080, sizeof(payload3), &crc), EBH_UART_ERROR_ACK);
+    session_ns = emu_bsp_now_ns() - start;
+    check("crc value", crc, ebh_crc_update(0xFFFF, payload3, sizeof(payload3)));
+
+    printf("%-10s send returns after %7.1f us, ACK after %7.1f us, 513 byte write + verify %6.2f ms (%.0f byte/s)\n",
+           name, send_ns / 1e3, ack_ns / 1e3, session_ns / 1e6, sizeof(payload3) * 1e9 / session_ns);
+}
+
+int main(void) {
+    ring_stress();
+    emu_bsp_start();
+
+    run_session("polling", &ebh_transport_uart_poll);
+    ebh_uart_irq_start();
+    run_session("interrupt", &ebh_transport_uart_irq);
+    check("rx overruns", ebh_uart_irq_rx_overruns(), 0);
+
+    emu_bsp_stop();
+
+    printf("%u/%u tests passed\n", test_pass, test_total);
+    return test_fail ? 1 : 0;
+}
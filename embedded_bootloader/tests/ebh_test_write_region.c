@@ -0,0 +1,186 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Max Groening
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+/*
+ * Host side test (Linux / POSIX)
+ *
+ * Writes whole images with ebh_write_region() / ebh_write_stream() on the simulated target:
+ * a 256 kB MSP432 flash image in one call, MSP432 SRAM with 32 bit addresses, a region
+ * crossing the 24 bit address limit, an MSP430 image above 64 kB, pull callbacks that
+ * deliver odd-sized pieces or end early, and the progress report.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "embedded_bootloader/embedded_bootloader.h"
+#include "embedded_bootloader/bootloader_protocol.h"
+#include "embedded_bootloader/tests/test_support.h"
+#include "embedded_bootloader/tests/sim_bsp.h"
+
+#define IMAGE_SIZE  0x40000u
+
+uint16_t test_pass = 0;
+uint16_t test_fail = 0;
+uint16_t test_total = 0;
+
+static sim_target target;
+static uint8_t image[IMAGE_SIZE];
+
+typedef struct {
+    const uint8_t *data;
+    uint32_t length;
+    uint32_t offset;
+    uint16_t piece;  // Largest number of bytes delivered per call
+} stream;
+
+typedef struct {
+    uint32_t calls;
+    uint32_t done;
+    uint32_t total;
+    uint8_t backwards;
+} progress;
+
+static uint16_t pull(void *context, uint8_t *data, uint16_t length) {
+    stream *s = context;
+
+    if(length > s->piece) {
+        length = s->piece;
+    }
+    if(length > s->length - s->offset) {
+        length = s->length - s->offset;
+    }
+    memcpy(data, &s->data[s->offset], length);
+    s->offset += length;
+    return length;
+}
+
+static void report(void *context, uint32_t done, uint32_t total) {
+    progress *p = context;
+
+    if(done <= p->done) {
+        p->backwards = 1;
+    }
+    p->calls++;
+    p->done = done;
+    p->total = total;
+}
+
+static void start(ebh_device device) {
+    sim_target_init(&target, device);
+    sim_bsp_attach(&target);
+    ebh_set_transport(&ebh_transport_uart_poll);
+    ebh_set_baud(115200);
+    target.baud = 115200;
+    target.locked = 0;
+}
+
+static uint32_t frames(void) {
+    return target.commands[EBH_CMD_RX_DATA_BLOCK] + target.commands[EBH_CMD_RX_DATA_BLOCK_32];
+}
+
+static void msp432(void) {
+    progress p = {0, 0, 0, 0};
+    stream s = {image, 0x10000, 0, 100};
+    uint64_t start_ns = 0;
+
+    start(ebh_device_msp432);
+    ebh_set_progress(report, &p);
+
+    // 256 kB of flash in one call, 24 bit addresses
+    start_ns = sim_bsp_time_ns;
+    check("flash", ebh_write_region(0, image, IMAGE_SIZE), EBH_CORE_MSG_OPERATION_SUCCESSFUL);
+    check("flash memory", memcmp(sim_target_memory(&target, 0), image, IMAGE_SIZE), 0);
+    check("flash commands", target.commands[EBH_CMD_RX_DATA_BLOCK], IMAGE_SIZE / EBH_DEFAULT_DATA_BLOCK);  // No TX_BUFFER_SIZE on MSP432
+    check("flash commands 32", target.commands[EBH_CMD_RX_DATA_BLOCK_32], 0);
+    check("progress calls", p.calls, frames());
+    check("progress done", p.done, IMAGE_SIZE);
+    check("progress total", p.total, IMAGE_SIZE);
+    check("progress order", p.backwards, 0);
+    printf("256 kB in one call: %u frames, %.2f s at 115200 baud\n", (unsigned)frames(), (sim_bsp_time_ns - start_ns) / 1e9);
+
+    // SRAM needs 32 bit addresses
+    memset(target.commands, 0, sizeof(target.commands));
+    ebh_set_progress(0, 0);
+    check("sram", ebh_write_region(0x20000000, image, 0x8000), EBH_CORE_MSG_OPERATION_SUCCESSFUL);
+    check("sram memory", memcmp(sim_target_memory(&target, 0x20000000), image, 0x8000), 0);
+    check("sram commands", target.commands[EBH_CMD_RX_DATA_BLOCK], 0);
+    check("sram commands 32", target.commands[EBH_CMD_RX_DATA_BLOCK_32], 0x8000 / EBH_DEFAULT_DATA_BLOCK);
+
+    // No frame crosses 16 MB with a 24 bit address
+    memset(target.commands, 0, sizeof(target.commands));
+    check("24 bit limit", ebh_write_region(0xFFFF00, image, 0x300), EBH_CORE_MSG_OPERATION_SUCCESSFUL);
+    check("24 bit commands", target.commands[EBH_CMD_RX_DATA_BLOCK], 1);
+    check("24 bit commands 32", target.commands[EBH_CMD_RX_DATA_BLOCK_32], 2);
+    check("24 bit below", memcmp(sim_target_memory(&target, 0xFFFF00), image, 0x100), 0);
+    check("24 bit above", memcmp(sim_target_memory(&target, 0x1000000), &image[0x100], 0x200), 0);
+
+    // Streamed in pieces of 100 bytes
+    memset(sim_target_memory(&target, 0), 0xFF, 0x10000);
+    check("stream", ebh_write_stream(0, 0x10000, pull, &s), EBH_CORE_MSG_OPERATION_SUCCESSFUL);
+    check("stream memory", memcmp(sim_target_memory(&target, 0), image, 0x10000), 0);
+    check("stream consumed", s.offset, 0x10000);
+
+    // The source ends before the length
+    memset(target.commands, 0, sizeof(target.commands));
+    s.offset = 0;
+    s.length = 3000;
+    check("stream ended", ebh_write_stream(0x20000000, 4000, pull, &s), EBH_UART_ERROR_SOURCE_ENDED);
+    check("stream ended frames", frames(), 3000 / EBH_DEFAULT_DATA_BLOCK);
+
+    // Errors of the target are returned
+    target.locked = 1;
+    check("locked", ebh_write_region(0, image, 0x1000), EBH_CORE_MSG_BSL_LOCKED);
+    check("locked frames", frames(), 3000 / EBH_DEFAULT_DATA_BLOCK + 1);
+}
+
+static void msp430(void) {
+    progress p = {0, 0, 0, 0};
+
+    // 20 bit addresses: an image crossing 64 kB in one call
+    start(ebh_device_msp430_flash);
+    ebh_set_progress(report, &p);
+    check("msp430", ebh_write_region(0x4400, image, 0x20000), EBH_CORE_MSG_OPERATION_SUCCESSFUL);
+    check("msp430 memory", memcmp(sim_target_memory(&target, 0x4400), image, 0x20000), 0);
+    check("msp430 commands 32", target.commands[EBH_CMD_RX_DATA_BLOCK_32], 0);
+    check("msp430 block", target.commands[EBH_CMD_RX_DATA_BLOCK], 0x20000 / 256);  // TX_BUFFER_SIZE: 260 byte buffer
+    check("msp430 progress", p.done, 0x20000);
+    ebh_set_progress(0, 0);
+}
+
+int main(void) {
+    uint32_t i = 0;
+
+    for(i = 0; i < IMAGE_SIZE; i++) {
+        image[i] = (uint8_t)(i * 7 + (i >> 9));
+    }
+
+    msp432();
+    msp430();
+
+    printf("%u/%u tests passed\n", test_pass, test_total);
+    return test_fail ? 1 : 0;
+}
@@ -0,0 +1,435 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Max Groening
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+
+#include "embedded_bootloader/tests/emu_bsp.h"
+#include "embedded_bootloader/transport.h"
+#include "embedded_bootloader/devices/devices.h"
+
+sim_target emu_bsp_target;
+
+static uint64_t emu_bsp_epoch_ns = 0;
+static pthread_t emu_bsp_threads[3];
+
+static pthread_mutex_t emu_bsp_hw_lock = PTHREAD_MUTEX_INITIALIZER;  // Peripheral registers
+static pthread_mutex_t emu_bsp_cpu_lock;                              // Held while the "ISR" runs (recursive)
+static uint8_t emu_bsp_tx_fifo[EMU_BSP_FIFO_SIZE];
+static uint8_t emu_bsp_rx_fifo[EMU_BSP_FIFO_SIZE];
+static uint16_t emu_bsp_tx_count = 0;
+static uint16_t emu_bsp_rx_count = 0;
+static uint8_t emu_bsp_tx_shifting = 0;
+static volatile uint8_t emu_bsp_tx_int_enabled = 0;
+static volatile uint8_t emu_bsp_int_pending = 0;
+static volatile uint8_t emu_bsp_irq_mode = 0;
+static volatile uint8_t emu_bsp_running = 0;
+
+// DMA channels, the remaining lengths are the channel state
+static ebh_dma_callback emu_bsp_dma_tx_done = 0;
+static ebh_dma_callback emu_bsp_dma_rx_done = 0;
+static const uint8_t *emu_bsp_dma_tx_data = 0;
+static uint16_t emu_bsp_dma_tx_length = 0;
+static uint8_t *emu_bsp_dma_rx_data = 0;
+static uint16_t emu_bsp_dma_rx_length = 0;
+
+uint64_t emu_bsp_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static uint64_t emu_bsp_target_now(void) {
+    return emu_bsp_now_ns() - emu_bsp_epoch_ns;
+}
+
+static uint8_t emu_bsp_fifo_pop(uint8_t *fifo, uint16_t *count) {
+    uint8_t character = fifo[0];
+    memmove(fifo, &fifo[1], --(*count));
+    return character;
+}
+
+static void *emu_bsp_hardware_thread(void *arg) {
+    uint64_t byte_ns = 11000000000ull / EMU_BSP_LINE_BAUD;
+    uint64_t next = emu_bsp_now_ns();
+
+    while(emu_bsp_running) {
+        if(emu_bsp_now_ns() < next) {
+            sched_yield();
+            continue;
+        }
+        next += byte_ns;  // Catches up byte by byte if the thread was not scheduled in time
+
+        pthread_mutex_lock(&emu_bsp_hw_lock);
+        // One byte time: shift out one TX byte, shift in one RX byte
+        if(emu_bsp_tx_count) {
+            emu_bsp_tx_shifting = 1;
+            sim_target_receive(&emu_bsp_target, emu_bsp_fifo_pop(emu_bsp_tx_fifo, &emu_bsp_tx_count), emu_bsp_target_now());
+        } else {
+            emu_bsp_tx_shifting = 0;
+        }
+        if((emu_bsp_rx_count < EMU_BSP_FIFO_SIZE) && sim_target_pending(&emu_bsp_target, emu_bsp_target_now())) {
+            emu_bsp_rx_fifo[emu_bsp_rx_count++] = sim_target_transmit(&emu_bsp_target);
+        }
+        pthread_mutex_unlock(&emu_bsp_hw_lock);
+    }
+    return 0;
+}
+
+static void *emu_bsp_isr_thread(void *arg) {
+    uint8_t fire = 0;
+
+    while(emu_bsp_running) {
+        pthread_mutex_lock(&emu_bsp_hw_lock);
+        fire = emu_bsp_irq_mode && (emu_bsp_int_pending || emu_bsp_rx_count ||
+                                    (emu_bsp_tx_int_enabled && (emu_bsp_tx_count <= EMU_BSP_FIFO_SIZE / 4)));
+        pthread_mutex_unlock(&emu_bsp_hw_lock);
+
+        if(fire) {
+            pthread_mutex_lock(&emu_bsp_cpu_lock);
+            emu_bsp_int_pending = 0;
+            ebh_uart_irq_isr();
+            pthread_mutex_unlock(&emu_bsp_cpu_lock);
+        } else {
+            sched_yield();
+        }
+    }
+    return 0;
+}
+
+static void *emu_bsp_dma_thread(void *arg) {
+    uint8_t moved = 0;
+    uint8_t tx_complete = 0;
+    uint8_t rx_complete = 0;
+
+    while(emu_bsp_running) {
+        moved = 0;
+        tx_complete = 0;
+        rx_complete = 0;
+
+        pthread_mutex_lock(&emu_bsp_hw_lock);
+        // The UART requests a transfer as long as the TX FIFO has space / the RX FIFO has data
+        while(emu_bsp_dma_tx_length && (emu_bsp_tx_count < EMU_BSP_FIFO_SIZE)) {
+            emu_bsp_tx_fifo[emu_bsp_tx_count++] = *emu_bsp_dma_tx_data++;
+            tx_complete = (--emu_bsp_dma_tx_length == 0);
+            moved = 1;
+        }
+        while(emu_bsp_dma_rx_length && emu_bsp_rx_count) {
+            *emu_bsp_dma_rx_data++ = emu_bsp_fifo_pop(emu_bsp_rx_fifo, &emu_bsp_rx_count);
+            rx_complete = (--emu_bsp_dma_rx_length == 0);
+            moved = 1;
+        }
+        pthread_mutex_unlock(&emu_bsp_hw_lock);
+
+        // Completion interrupt
+        if(tx_complete || rx_complete) {
+            pthread_mutex_lock(&emu_bsp_cpu_lock);
+            if(tx_complete && emu_bsp_dma_tx_done) {
+                emu_bsp_dma_tx_done();
+            }
+            if(rx_complete && emu_bsp_dma_rx_done) {
+                emu_bsp_dma_rx_done();
+            }
+            pthread_mutex_unlock(&emu_bsp_cpu_lock);
+        } else if(!moved) {
+            sched_yield();
+        }
+    }
+    return 0;
+}
+
+void emu_bsp_start(void) {
+    pthread_mutexattr_t attr;
+
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&emu_bsp_cpu_lock, &attr);
+
+    emu_bsp_reset(ebh_device_msp432);
+    emu_bsp_running = 1;
+    pthread_create(&emu_bsp_threads[0], 0, emu_bsp_hardware_thread, 0);
+    pthread_create(&emu_bsp_threads[1], 0, emu_bsp_isr_thread, 0);
+    pthread_create(&emu_bsp_threads[2], 0, emu_bsp_dma_thread, 0);
+}
+
+void emu_bsp_stop(void) {
+    uint8_t i = 0;
+
+    emu_bsp_running = 0;
+    for(i = 0; i < 3; i++) {
+        pthread_join(emu_bsp_threads[i], 0);
+    }
+}
+
+void emu_bsp_reset(ebh_device device) {
+    pthread_mutex_lock(&emu_bsp_hw_lock);
+    sim_target_init(&emu_bsp_target, device);
+    emu_bsp_epoch_ns = emu_bsp_now_ns();
+    emu_bsp_tx_count = 0;
+    emu_bsp_rx_count = 0;
+    pthread_mutex_unlock(&emu_bsp_hw_lock);
+    ebh_session_reset();
+}
+
+
+/*
+ * General device initialization and support functions
+ */
+
+void ebh_device_init(void) {
+}
+
+void ebh_delay_100_us(void) {
+    ebh_delay_us(100);
+}
+
+void ebh_delay_us(uint16_t time) {
+    uint64_t end = emu_bsp_now_ns() + time * 1000ull;
+    while(emu_bsp_now_ns() < end) {
+        sched_yield();
+    }
+}
+
+uint32_t ebh_time_us(void) {
+    return (uint32_t)(emu_bsp_now_ns() / 1000u);
+}
+
+
+/*
+ * UART peripheral interface - polling based
+ */
+
+void ebh_uart_poll_init() {
+}
+
+void ebh_uart_poll_configure_9600_baud() {
+}
+
+void ebh_uart_poll_configure_115200_baud() {
+}
+
+uint8_t ebh_uart_poll_configure_baud(uint32_t baud) {
+    return 0;  // The emulated line runs at EMU_BSP_LINE_BAUD
+}
+
+void ebh_uart_poll_send_char(uint8_t character) {
+    uint8_t done = 0;
+
+    while(!done) {
+        pthread_mutex_lock(&emu_bsp_hw_lock);
+        if(emu_bsp_tx_count < EMU_BSP_FIFO_SIZE) {
+            emu_bsp_tx_fifo[emu_bsp_tx_count++] = character;
+            done = 1;
+        }
+        pthread_mutex_unlock(&emu_bsp_hw_lock);
+        if(!done) {
+            sched_yield();
+        }
+    }
+}
+
+void ebh_uart_poll_send_buf(const uint8_t *data, uint16_t length) {
+    while(length--) {
+        ebh_uart_poll_send_char(*data++);
+    }
+}
+
+uint16_t ebh_uart_poll_receive_char_available() {
+    uint16_t count = 0;
+    pthread_mutex_lock(&emu_bsp_hw_lock);
+    count = emu_bsp_rx_count;
+    pthread_mutex_unlock(&emu_bsp_hw_lock);
+    return count;
+}
+
+uint8_t ebh_uart_poll_receive_char() {
+    uint8_t character = 0;
+    while(!ebh_uart_poll_receive_char_available()) {
+        sched_yield();
+    }
+    pthread_mutex_lock(&emu_bsp_hw_lock);
+    character = emu_bsp_fifo_pop(emu_bsp_rx_fifo, &emu_bsp_rx_count);
+    pthread_mutex_unlock(&emu_bsp_hw_lock);
+    return character;
+}
+
+
+/*
+ * UART peripheral interface - interrupt based
+ */
+
+void ebh_uart_irq_init(void) {
+    emu_bsp_irq_mode = 1;
+}
+
+uint8_t ebh_uart_irq_hw_rx_ready(void) {
+    return ebh_uart_poll_receive_char_available() ? 1 : 0;
+}
+
+uint8_t ebh_uart_irq_hw_read(void) {
+    return ebh_uart_poll_receive_char();
+}
+
+uint8_t ebh_uart_irq_hw_tx_ready(void) {
+    uint8_t ready = 0;
+    pthread_mutex_lock(&emu_bsp_hw_lock);
+    ready = emu_bsp_tx_count < EMU_BSP_FIFO_SIZE;
+    pthread_mutex_unlock(&emu_bsp_hw_lock);
+    return ready;
+}
+
+void ebh_uart_irq_hw_write(uint8_t character) {
+    ebh_uart_poll_send_char(character);
+}
+
+uint8_t ebh_uart_irq_hw_tx_done(void) {
+    uint8_t done = 0;
+    pthread_mutex_lock(&emu_bsp_hw_lock);
+    done = (emu_bsp_tx_count == 0) && !emu_bsp_tx_shifting;
+    pthread_mutex_unlock(&emu_bsp_hw_lock);
+    return done;
+}
+
+void ebh_uart_irq_hw_tx_enable(uint8_t enable) {
+    // Register write from the application: the interrupt cannot run in the middle of it
+    pthread_mutex_lock(&emu_bsp_cpu_lock);
+    emu_bsp_tx_int_enabled = enable;
+    if(enable) {
+        emu_bsp_int_pending = 1;
+    }
+    pthread_mutex_unlock(&emu_bsp_cpu_lock);
+}
+
+
+/*
+ * UART peripheral interface - DMA based
+ */
+
+void ebh_uart_dma_init(ebh_dma_callback tx_done, ebh_dma_callback rx_done) {
+    pthread_mutex_lock(&emu_bsp_cpu_lock);
+    emu_bsp_irq_mode = 0;
+    emu_bsp_dma_tx_done = tx_done;
+    emu_bsp_dma_rx_done = rx_done;
+    pthread_mutex_unlock(&emu_bsp_cpu_lock);
+}
+
+void ebh_uart_dma_tx_start(const uint8_t *data, uint16_t length) {
+    pthread_mutex_lock(&emu_bsp_hw_lock);
+    emu_bsp_dma_tx_data = data;
+    emu_bsp_dma_tx_length = length;
+    pthread_mutex_unlock(&emu_bsp_hw_lock);
+}
+
+void ebh_uart_dma_rx_start(uint8_t *data, uint16_t length) {
+    pthread_mutex_lock(&emu_bsp_hw_lock);
+    emu_bsp_dma_rx_data = data;
+    emu_bsp_dma_rx_length = length;
+    pthread_mutex_unlock(&emu_bsp_hw_lock);
+}
+
+uint8_t ebh_uart_dma_tx_busy(void) {
+    uint8_t busy = 0;
+    pthread_mutex_lock(&emu_bsp_hw_lock);
+    busy = emu_bsp_dma_tx_length || emu_bsp_tx_count || emu_bsp_tx_shifting;
+    pthread_mutex_unlock(&emu_bsp_hw_lock);
+    return busy;
+}
+
+uint16_t ebh_uart_dma_rx_remaining(void) {
+    uint16_t remaining = 0;
+
+    // A register read cannot happen while the completion interrupt runs
+    pthread_mutex_lock(&emu_bsp_cpu_lock);
+    pthread_mutex_lock(&emu_bsp_hw_lock);
+    remaining = emu_bsp_dma_rx_length;
+    pthread_mutex_unlock(&emu_bsp_hw_lock);
+    pthread_mutex_unlock(&emu_bsp_cpu_lock);
+    return remaining;
+}
+
+
+/*
+ * SPI peripheral interface - nothing connected, MISO stays high
+ */
+
+void ebh_spi_init(void) {
+}
+
+void ebh_spi_configure(uint32_t clock_hz) {
+}
+
+void ebh_spi_select(uint8_t active) {
+}
+
+void ebh_spi_transfer(const uint8_t *tx, uint8_t *rx, uint16_t length) {
+    if(rx) {
+        memset(rx, 0xFF, length);
+    }
+}
+
+
+/*
+ * I2C peripheral interface - nothing connected, no acknowledge
+ */
+
+void ebh_i2c_init(void) {
+}
+
+void ebh_i2c_configure(uint32_t clock_hz) {
+}
+
+uint8_t ebh_i2c_write(uint8_t address, const ebh_iovec *iov, uint8_t count) {
+    return EBH_I2C_NACK;
+}
+
+uint8_t ebh_i2c_read(uint8_t address, uint8_t *data, uint16_t length) {
+    return EBH_I2C_NACK;
+}
+
+
+/*
+ * Reset and Test pin
+ */
+
+void ebh_invoke_seqence_pre(void) {
+}
+
+void ebh_invoke_seqence_post(void) {
+}
+
+void ebh_rst_pin_high(void) {
+}
+
+void ebh_rst_pin_low(void) {
+}
+
+void ebh_test_pin_high(void) {
+}
+
+void ebh_test_pin_low(void) {
+}
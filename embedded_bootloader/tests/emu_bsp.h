@@ -0,0 +1,57 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Max Groening
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#ifndef EMBEDDED_BOOTLOADER_TESTS_EMU_BSP_H_
+#define EMBEDDED_BOOTLOADER_TESTS_EMU_BSP_H_
+
+#include <stdint.h>
+#include "embedded_bootloader/embedded_bootloader.h"
+#include "embedded_bootloader/tests/sim_target.h"
+
+/*
+ * Emulated host BSP for host side tests (Linux / POSIX threads).
+ *
+ * Unlike sim_bsp.c this runs in real time:
+ *   - a hardware thread shifts bytes between 16 byte UART FIFOs and a sim_target
+ *     at EMU_BSP_LINE_BAUD,
+ *   - an ISR thread stands in for the UART interrupt and runs ebh_uart_irq_isr(),
+ *   - a DMA worker thread serves the UART DMA requests and runs the completion callbacks,
+ *   - the calling thread is the application.
+ * The ISR and the callbacks run under a CPU lock, like an interrupt the application
+ * cannot be preempted by in the middle of a register access.
+ * All waiting loops yield, so it also works on a single CPU.
+ */
+
+#define EMU_BSP_LINE_BAUD  1000000u  // 11 us per byte (8E1)
+#define EMU_BSP_FIFO_SIZE  16u
+
+extern sim_target emu_bsp_target;
+
+uint64_t emu_bsp_now_ns(void);
+void emu_bsp_start(void);
+void emu_bsp_stop(void);
+void emu_bsp_reset(ebh_device device);  // Fresh target, empty FIFOs
+
+#endif /* EMBEDDED_BOOTLOADER_TESTS_EMU_BSP_H_ */
@@ -0,0 +1,431 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Max Groening
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include <stdint.h>
+
+#include "embedded_bootloader/tests/sim_bsp.h"
+#include "embedded_bootloader/config.h"
+#include "embedded_bootloader/devices/devices.h"
+#include "embedded_bootloader/bootloader_protocol.h"
+
+uint64_t sim_bsp_time_ns = 0;
+uint32_t sim_bsp_baud = 9600;
+uint32_t sim_bsp_spi_clock = 1000000;
+uint32_t sim_bsp_i2c_clock = 100000;
+uint8_t sim_bsp_i2c_stretch = 0;
+uint64_t sim_bsp_i2c_stretch_limit_ns = EBH_I2C_STRETCH_TIMEOUT * 1000ull;
+uint32_t sim_bsp_error_ppm = 0;
+uint32_t sim_bsp_error_min_baud = 0;
+uint32_t sim_bsp_errors = 0;
+
+static sim_target *sim_bsp_target = 0;
+static uint32_t sim_bsp_random = 1;
+static uint8_t sim_bsp_irq_enabled = 0;
+static ebh_dma_callback sim_bsp_dma_tx_done = 0;
+static ebh_dma_callback sim_bsp_dma_rx_done = 0;
+static uint8_t *sim_bsp_dma_rx_data = 0;
+static uint16_t sim_bsp_dma_rx_length = 0;
+static uint16_t sim_bsp_dma_rx_count = 0;
+
+void sim_bsp_attach(sim_target *target) {
+    sim_bsp_target = target;
+    sim_bsp_time_ns = 0;
+    sim_bsp_baud = 9600;
+    sim_bsp_irq_enabled = 0;
+    sim_bsp_random = 1;
+    sim_bsp_errors = 0;
+    ebh_session_reset();  // A new target does not share what was learned about the last one
+}
+
+static uint64_t sim_bsp_byte_ns(void) {
+    return 11000000000ull / sim_bsp_baud;
+}
+
+/* Random bit errors (xorshift32, same sequence after every sim_bsp_attach()) */
+static uint8_t sim_bsp_noise(uint8_t character) {
+    sim_bsp_random ^= sim_bsp_random << 13;
+    sim_bsp_random ^= sim_bsp_random >> 17;
+    sim_bsp_random ^= sim_bsp_random << 5;
+    if((sim_bsp_baud >= sim_bsp_error_min_baud) && (sim_bsp_random % 1000000u < sim_bsp_error_ppm)) {
+        sim_bsp_errors++;
+        return character ^ (1 << ((sim_bsp_random >> 20) & 7));
+    }
+    return character;
+}
+
+/* Both sides have to use the same baud rate, otherwise every byte arrives garbled. */
+static uint8_t sim_bsp_line(uint8_t character) {
+    return (sim_bsp_baud == sim_bsp_target->baud) ? character : (character ^ 0x5A);
+}
+
+static void sim_bsp_line_send(uint8_t character) {
+    sim_bsp_time_ns += sim_bsp_byte_ns();
+    sim_target_line(sim_bsp_target, sim_bsp_baud);
+    sim_target_receive(sim_bsp_target, sim_bsp_noise(sim_bsp_line(character)), sim_bsp_time_ns);
+}
+
+static uint8_t sim_bsp_line_wait(uint64_t timeout_ns) {
+    uint64_t ready = sim_target_next_ready(sim_bsp_target);
+
+    if(ready <= sim_bsp_time_ns) {
+        return 1;
+    }
+    if((ready == UINT64_MAX) || (ready - sim_bsp_time_ns > timeout_ns)) {
+        if(timeout_ns != UINT64_MAX) {
+            sim_bsp_time_ns += timeout_ns;
+        }
+        return 0;
+    }
+    sim_bsp_time_ns = ready;
+    return 1;
+}
+
+static uint8_t sim_bsp_line_receive(void) {
+    uint8_t garbled = (sim_bsp_baud != sim_bsp_target->baud);  // Sampled before a pending baud rate change applies
+    uint8_t character = sim_target_transmit(sim_bsp_target);
+
+    sim_bsp_time_ns += sim_bsp_byte_ns();
+    sim_target_sent(sim_bsp_target, sim_bsp_time_ns);
+    return sim_bsp_noise(character ^ (garbled ? 0x5A : 0x00));
+}
+
+
+/*
+ * General device initialization and support functions
+ */
+
+void ebh_device_init(void) {
+}
+
+void ebh_delay_100_us(void) {
+    sim_bsp_time_ns += 100000u;
+}
+
+void ebh_delay_us(uint16_t time) {
+    sim_bsp_time_ns += time * 1000ull;
+
+    // Received bytes raise the UART interrupt while the application waits
+    if(sim_bsp_irq_enabled && sim_target_pending(sim_bsp_target, sim_bsp_time_ns)) {
+        ebh_uart_irq_isr();
+    }
+}
+
+uint32_t ebh_time_us(void) {
+    return (uint32_t)(sim_bsp_time_ns / 1000u);
+}
+
+
+/*
+ * UART peripheral interface - polling based
+ */
+
+void ebh_uart_poll_init() {
+}
+
+void ebh_uart_poll_configure_9600_baud() {
+    sim_bsp_baud = 9600;
+}
+
+void ebh_uart_poll_configure_115200_baud() {
+    sim_bsp_baud = 115200;
+}
+
+uint8_t ebh_uart_poll_configure_baud(uint32_t baud) {
+    if(baud == 0) {
+        return EBH_UART_ERROR_UNKNOWN_BAUD_RATE;
+    }
+    sim_bsp_baud = baud;
+    return 0;
+}
+
+void ebh_uart_poll_send_char(uint8_t character) {
+    sim_bsp_line_send(character);
+}
+
+void ebh_uart_poll_send_buf(const uint8_t *data, uint16_t length) {
+    while(length--) {
+        sim_bsp_line_send(*data++);
+    }
+}
+
+uint8_t ebh_uart_poll_receive_char() {
+    sim_bsp_line_wait(UINT64_MAX);
+    return sim_bsp_line_receive();
+}
+
+uint16_t ebh_uart_poll_receive_char_available() {
+    return sim_target_pending(sim_bsp_target, sim_bsp_time_ns);
+}
+
+
+/*
+ * UART peripheral interface - interrupt based
+ * The interrupt runs synchronously: when TX is enabled and while delays let received bytes in.
+ */
+
+void ebh_uart_irq_init(void) {
+    sim_bsp_irq_enabled = 1;
+}
+
+uint8_t ebh_uart_irq_hw_rx_ready(void) {
+    return sim_target_pending(sim_bsp_target, sim_bsp_time_ns) ? 1 : 0;
+}
+
+uint8_t ebh_uart_irq_hw_read(void) {
+    return sim_bsp_line_receive();
+}
+
+uint8_t ebh_uart_irq_hw_tx_ready(void) {
+    return 1;
+}
+
+void ebh_uart_irq_hw_write(uint8_t character) {
+    sim_bsp_line_send(character);
+}
+
+uint8_t ebh_uart_irq_hw_tx_done(void) {
+    return 1;
+}
+
+void ebh_uart_irq_hw_tx_enable(uint8_t enable) {
+    if(enable) {
+        ebh_uart_irq_isr();
+    }
+}
+
+
+/*
+ * UART peripheral interface - DMA based
+ * Transfers run synchronously: TX completes within ebh_uart_dma_tx_start(), RX moves the
+ * bytes received up to now whenever the remaining count is polled.
+ */
+
+void ebh_uart_dma_init(ebh_dma_callback tx_done, ebh_dma_callback rx_done) {
+    sim_bsp_dma_tx_done = tx_done;
+    sim_bsp_dma_rx_done = rx_done;
+    sim_bsp_dma_rx_data = 0;
+}
+
+void ebh_uart_dma_tx_start(const uint8_t *data, uint16_t length) {
+    while(length--) {
+        sim_bsp_line_send(*data++);
+    }
+    if(sim_bsp_dma_tx_done) {
+        sim_bsp_dma_tx_done();
+    }
+}
+
+void ebh_uart_dma_rx_start(uint8_t *data, uint16_t length) {
+    sim_bsp_dma_rx_data = data;
+    sim_bsp_dma_rx_length = length;
+    sim_bsp_dma_rx_count = 0;
+}
+
+uint8_t ebh_uart_dma_tx_busy(void) {
+    return 0;
+}
+
+uint16_t ebh_uart_dma_rx_remaining(void) {
+    while(sim_bsp_dma_rx_data && sim_target_pending(sim_bsp_target, sim_bsp_time_ns)) {
+        sim_bsp_dma_rx_data[sim_bsp_dma_rx_count++] = sim_bsp_line_receive();
+        if(sim_bsp_dma_rx_count == sim_bsp_dma_rx_length) {
+            sim_bsp_dma_rx_data = 0;
+            if(sim_bsp_dma_rx_done) {
+                sim_bsp_dma_rx_done();
+            }
+        }
+    }
+    return sim_bsp_dma_rx_data ? (sim_bsp_dma_rx_length - sim_bsp_dma_rx_count) : 0;
+}
+
+
+/*
+ * SPI peripheral interface - mock SPI device with the target behind it
+ * Each byte takes 8 clock cycles, MISO is 0xFF while the target has nothing to send.
+ */
+
+void ebh_spi_init(void) {
+}
+
+void ebh_spi_configure(uint32_t clock_hz) {
+    sim_bsp_spi_clock = clock_hz;
+}
+
+void ebh_spi_select(uint8_t active) {
+}
+
+void ebh_spi_transfer(const uint8_t *tx, uint8_t *rx, uint16_t length) {
+    uint8_t miso = 0;
+    uint16_t i = 0;
+
+    for(i = 0; i < length; i++) {
+        sim_bsp_time_ns += 8000000000ull / sim_bsp_spi_clock;
+        miso = sim_target_pending(sim_bsp_target, sim_bsp_time_ns) ? sim_target_transmit(sim_bsp_target) : 0xFF;
+        sim_target_receive(sim_bsp_target, tx ? tx[i] : 0xFF, sim_bsp_time_ns);
+        if(rx) {
+            rx[i] = miso;
+        }
+    }
+}
+
+
+/*
+ * I2C peripheral interface - mock I2C bus with the target behind it
+ * Each byte takes 9 clock cycles (data + acknowledge), START and STOP one each.
+ */
+
+static void sim_bsp_i2c_clocks(uint32_t clocks) {
+    sim_bsp_time_ns += clocks * 1000000000ull / sim_bsp_i2c_clock;
+}
+
+void ebh_i2c_init(void) {
+}
+
+void ebh_i2c_configure(uint32_t clock_hz) {
+    sim_bsp_i2c_clock = clock_hz;
+}
+
+uint8_t ebh_i2c_write(uint8_t address, const ebh_iovec *iov, uint8_t count) {
+    uint16_t i = 0;
+
+    sim_bsp_i2c_clocks(1 + 9);
+    if(address != EBH_I2C_ADDRESS) {
+        sim_bsp_i2c_clocks(1);
+        return EBH_I2C_NACK;
+    }
+    while(count--) {
+        for(i = 0; i < iov->length; i++) {
+            sim_bsp_i2c_clocks(9);
+            sim_target_receive(sim_bsp_target, iov->data[i], sim_bsp_time_ns);
+        }
+        iov++;
+    }
+    sim_bsp_i2c_clocks(1);
+    return EBH_I2C_OK;
+}
+
+uint8_t ebh_i2c_read(uint8_t address, uint8_t *data, uint16_t length) {
+    uint64_t ready = 0;
+    uint16_t i = 0;
+
+    sim_bsp_i2c_clocks(1 + 9);
+    ready = sim_target_next_ready(sim_bsp_target);
+    if((address != EBH_I2C_ADDRESS) || (ready == UINT64_MAX) || ((ready > sim_bsp_time_ns) && !sim_bsp_i2c_stretch)) {
+        sim_bsp_i2c_clocks(1);
+        return EBH_I2C_NACK;
+    }
+
+    for(i = 0; i < length; i++) {
+        ready = sim_target_next_ready(sim_bsp_target);
+        if(ready == UINT64_MAX) {
+            data[i] = 0xFF;  // Nothing left, SDA stays released
+        } else {
+            if(ready > sim_bsp_time_ns) {
+                if(ready - sim_bsp_time_ns > sim_bsp_i2c_stretch_limit_ns) {
+                    sim_bsp_time_ns += sim_bsp_i2c_stretch_limit_ns;
+                    return EBH_I2C_TIMEOUT;
+                }
+                sim_bsp_time_ns = ready;  // Clock stretched until the byte is ready
+            }
+            data[i] = sim_target_transmit(sim_bsp_target);
+        }
+        sim_bsp_i2c_clocks(9);
+    }
+    sim_bsp_i2c_clocks(1);
+    return EBH_I2C_OK;
+}
+
+
+/*
+ * Reset and Test pin
+ */
+
+void ebh_invoke_seqence_pre(void) {
+}
+
+void ebh_invoke_seqence_post(void) {
+}
+
+void ebh_rst_pin_high(void) {
+}
+
+void ebh_rst_pin_low(void) {
+}
+
+void ebh_test_pin_high(void) {
+}
+
+void ebh_test_pin_low(void) {
+}
+
+
+/*
+ * Mock transport
+ */
+
+static void ebh_mock_send(void *context, const ebh_iovec *iov, uint8_t count) {
+    uint16_t i = 0;
+
+    while(count--) {
+        for(i = 0; i < iov->length; i++) {
+            sim_bsp_line_send(iov->data[i]);
+        }
+        iov++;
+    }
+}
+
+static uint8_t ebh_mock_wait_readable(void *context, uint32_t timeout_us) {
+    return sim_bsp_line_wait((timeout_us == EBH_TIMEOUT_INFINITE) ? UINT64_MAX : timeout_us * 1000ull);
+}
+
+static uint16_t ebh_mock_receive(void *context, uint8_t *data, uint16_t length, uint32_t timeout_us) {
+    uint16_t received = 0;
+
+    while((received < length) && ebh_mock_wait_readable(context, timeout_us)) {
+        data[received++] = sim_bsp_line_receive();
+    }
+    return received;
+}
+
+static void ebh_mock_flush(void *context) {
+    while(sim_target_pending(sim_bsp_target, sim_bsp_time_ns)) {
+        sim_target_transmit(sim_bsp_target);
+    }
+}
+
+static uint8_t ebh_mock_set_baud(void *context, uint32_t baud) {
+    sim_bsp_baud = baud;
+    return 0;
+}
+
+const ebh_transport ebh_transport_mock = {
+    ebh_mock_send,
+    ebh_mock_receive,
+    ebh_mock_wait_readable,
+    ebh_mock_flush,
+    ebh_mock_set_baud,
+    0,
+    0
+};
@@ -0,0 +1,56 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Max Groening
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#ifndef EMBEDDED_BOOTLOADER_TESTS_SIM_BSP_H_
+#define EMBEDDED_BOOTLOADER_TESTS_SIM_BSP_H_
+
+#include <stdint.h>
+#include "embedded_bootloader/transport.h"
+#include "embedded_bootloader/tests/sim_target.h"
+
+/*
+ * Simulated host BSP for host side tests.
+ *
+ * Implements devices.h against a sim_target on a simulated clock: delays and UART
+ * transfers (11 bit per byte, 8E1) only advance sim_bsp_time_ns, so tests run fast and
+ * timing results do not depend on the machine running them.
+ */
+
+extern uint64_t sim_bsp_time_ns;
+extern uint32_t sim_bsp_baud;
+extern uint32_t sim_bsp_spi_clock;
+extern uint32_t sim_bsp_i2c_clock;
+extern uint8_t sim_bsp_i2c_stretch;              // Busy target stretches the clock instead of not acknowledging
+extern uint64_t sim_bsp_i2c_stretch_limit_ns;    // Longest stretching the host accepts
+extern uint32_t sim_bsp_error_ppm;               // UART bytes (both directions) with a flipped bit per million
+extern uint32_t sim_bsp_error_min_baud;          // Bit errors only at or above this baud rate
+extern uint32_t sim_bsp_errors;                  // Bit errors injected since sim_bsp_attach()
+
+void sim_bsp_attach(sim_target *target);
+
+/* Direct bulk transport to the attached target (the "wire" without a UART driver) */
+extern const ebh_transport ebh_transport_mock;
+
+#endif /* EMBEDDED_BOOTLOADER_TESTS_SIM_BSP_H_ */
@@ -0,0 +1,365 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Max Groening
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include <stdint.h>
+#include <string.h>
+
+#include "embedded_bootloader/tests/sim_target.h"
+#include "embedded_bootloader/bootloader_protocol.h"
+#include "embedded_bootloader/crc_ccitt.h"
+
+/* Processing times of the modeled target */
+#define SIM_ACK_NS             20000u     // Peripheral interface answers with ACK
+#define SIM_COMMAND_NS         100000u    // Any command
+#define SIM_WRITE_NS_PER_BYTE  15000u     // Flash programming
+#define SIM_ERASE_SEGMENT_NS   25000000u
+#define SIM_MASS_ERASE_NS      100000000u
+
+void sim_target_init(sim_target *target, ebh_device device) {
+    memset(target, 0, sizeof(*target));
+    target->device = device;
+    target->locked = 1;
+    memset(target->password, 0xFF, sizeof(target->password));
+    memset(target->memory, 0xFF, sizeof(target->memory));
+    target->buffer_size = (device == ebh_device_msp432) ? 4096 + 1 + 4 : 256 + 1 + 3;
+    target->baud = 9600;
+    target->autobaud_max = (device == ebh_device_msp432) ? 115200 : 0;
+}
+
+/* The BSL needs gap_ns after its last answer left the line before it listens again */
+void sim_target_sent(sim_target *target, uint64_t now_ns) {
+    if(target->gap_ns && (target->tx_head == target->tx_tail)) {
+        target->listen_ns = now_ns + target->gap_ns;
+    }
+}
+
+uint8_t *sim_target_memory(sim_target *target, uint32_t addr) {
+    // MSP432 SRAM (0x20000000) is folded above the 512 kB of flash
+    if(addr >= 0x20000000u) {
+        return &target->memory[0x80000u | (addr & 0x7FFFFu)];
+    }
+    return &target->memory[addr & (SIM_TARGET_MEMORY_SIZE - 1)];
+}
+
+static void sim_target_queue(sim_target *target, uint8_t character, uint64_t ready_ns) {
+    target->tx[target->tx_tail] = character;
+    target->tx_ready_ns[target->tx_tail] = ready_ns;
+    target->tx_tail = (target->tx_tail + 1) % SIM_TARGET_TX_SIZE;
+}
+
+static void sim_target_respond(sim_target *target, const uint8_t *core, uint16_t length, uint64_t ready_ns) {
+    uint16_t crc = ebh_crc_update(0xFFFF, core, length);
+    uint16_t i = 0;
+
+    sim_target_queue(target, EBH_HEADER, ready_ns);
+    sim_target_queue(target, length & 0xFF, ready_ns);
+    sim_target_queue(target, (length >> 8) & 0xFF, ready_ns);
+    for(i = 0; i < length; i++) {
+        sim_target_queue(target, core[i], ready_ns);
+    }
+    sim_target_queue(target, crc & 0xFF, ready_ns);
+    sim_target_queue(target, (crc >> 8) & 0xFF, ready_ns);
+}
+
+static void sim_target_message(sim_target *target, uint8_t message, uint64_t ready_ns) {
+    uint8_t core[2] = {EBH_CORE_MSG_MESSAGE, message};
+    sim_target_respond(target, core, 2, ready_ns);
+}
+
+static uint32_t sim_target_address(const uint8_t *core, uint8_t a_len) {
+    uint32_t addr = core[1] + (core[2] << 8) + ((uint32_t)core[3] << 16);
+    if(a_len == 4) {
+        addr += (uint32_t)core[4] << 24;
+    }
+    return addr;
+}
+
+static uint32_t sim_target_segment_size(const sim_target *target) {
+    return (target->device == ebh_device_msp432) ? 4096 : 512;
+}
+
+static uint32_t sim_target_baud_rate(uint8_t code) {
+    switch(code) {
+    case EBH_UART_BAUD_RATE_9600:   return 9600;
+    case EBH_UART_BAUD_RATE_19200:  return 19200;
+    case EBH_UART_BAUD_RATE_38400:  return 38400;
+    case EBH_UART_BAUD_RATE_56700:  return 57600;
+    case EBH_UART_BAUD_RATE_115200: return 115200;
+    default:                        return 0;
+    }
+}
+
+static void sim_target_execute(sim_target *target, const uint8_t *core, uint16_t length, uint64_t now_ns) {
+    uint8_t cmd = core[0];
+    uint8_t a_len = (cmd & 0x20) ? 4 : 3;
+    uint64_t ack_ns = 0;
+    uint64_t done_ns = 0;
+    uint32_t addr = 0;
+    uint32_t i = 0;
+
+    // A frame arriving while the previous write is still programming waits for it
+    if(target->busy_until_ns > now_ns) {
+        now_ns = target->busy_until_ns;
+    }
+    ack_ns = now_ns + SIM_ACK_NS;
+    done_ns = now_ns + SIM_COMMAND_NS;
+
+    target->commands[cmd]++;
+
+    // Every complete and valid frame is acknowledged by the peripheral interface
+    sim_target_queue(target, EBH_UART_ERROR_ACK, ack_ns);
+
+    switch(cmd) {
+    case EBH_CMD_RX_PASSWORD:
+    case EBH_CMD_RX_PASSWORD_32:
+        if(memcmp(&core[1], target->password, length - 1) == 0) {
+            target->locked = 0;
+            sim_target_message(target, EBH_CORE_MSG_OPERATION_SUCCESSFUL, done_ns);
+        } else {
+            sim_target_message(target, EBH_CORE_MSG_BSL_PASSWORD_ERROR, done_ns);
+        }
+        return;
+
+    case EBH_CMD_TX_BSL_VERSION: {
+        uint8_t version[11] = {EBH_CORE_MSG_DATA, 0x00, 0x04, 0x00, 0x01, 0x00, 0x03, 0x00, 0x02, 0x00, 0x01};
+        sim_target_respond(target, version, (target->device == ebh_device_msp432) ? 11 : 5, done_ns);
+        return;
+    }
+
+    case EBH_CMD_CHANGE_BAUD_RATE:
+        // The ACK (queued above) is replaced by the result of the baud rate check
+        target->tx_tail = (target->tx_tail + SIM_TARGET_TX_SIZE - 1) % SIM_TARGET_TX_SIZE;
+        target->pending_baud = sim_target_baud_rate(core[1]);
+        sim_target_queue(target, target->pending_baud ? EBH_UART_ERROR_ACK : EBH_UART_ERROR_UNKNOWN_BAUD_RATE, ack_ns);
+        return;
+    }
+
+    if(target->locked) {
+        if((cmd == EBH_CMD_LOAD_PC) || (cmd == EBH_CMD_RX_DATA_BLOCK_FAST) || (cmd == EBH_CMD_LOAD_PC_32) || (cmd == EBH_CMD_REBOOT_RESET)) {
+            return;
+        }
+        sim_target_message(target, EBH_CORE_MSG_BSL_LOCKED, done_ns);
+        return;
+    }
+
+    switch(cmd) {
+    case EBH_CMD_RX_DATA_BLOCK:
+    case EBH_CMD_RX_DATA_BLOCK_32:
+        addr = sim_target_address(core, a_len);
+        for(i = 0; i < (uint32_t)(length - 1 - a_len); i++) {
+            *sim_target_memory(target, addr + i) = core[1 + a_len + i] ^ target->write_error;
+        }
+        sim_target_message(target, EBH_CORE_MSG_OPERATION_SUCCESSFUL, done_ns + (uint64_t)i * SIM_WRITE_NS_PER_BYTE);
+        break;
+
+    case EBH_CMD_RX_DATA_BLOCK_FAST:
+        if(target->device == ebh_device_msp432) {
+            sim_target_message(target, EBH_CORE_MSG_UNKNOWN_COMMAND, done_ns);
+            break;
+        }
+        // Programmed without a core response, the next frame is taken once the write is done
+        addr = sim_target_address(core, a_len);
+        for(i = 0; i < (uint32_t)(length - 1 - a_len); i++) {
+            *sim_target_memory(target, addr + i) = core[1 + a_len + i] ^ target->write_error;
+        }
+        target->busy_until_ns = done_ns + (uint64_t)i * SIM_WRITE_NS_PER_BYTE;
+        break;
+
+    case EBH_CMD_ERASE_SEGMENT:
+    case EBH_CMD_ERASE_SEGMENT_32:
+        addr = sim_target_address(core, a_len) & ~(sim_target_segment_size(target) - 1);
+        for(i = 0; i < sim_target_segment_size(target); i++) {
+            *sim_target_memory(target, addr + i) = 0xFF;
+        }
+        sim_target_message(target, EBH_CORE_MSG_OPERATION_SUCCESSFUL, done_ns + SIM_ERASE_SEGMENT_NS);
+        break;
+
+    case EBH_CMD_MASS_ERASE:
+        memset(target->memory, 0xFF, 0x80000u);
+        if(target->device == ebh_device_msp430_fram) {
+            // FRAM devices reboot without answering
+            target->tx_tail = (target->tx_tail + SIM_TARGET_TX_SIZE - 1) % SIM_TARGET_TX_SIZE;
+            target->locked = 1;
+        } else {
+            sim_target_message(target, EBH_CORE_MSG_OPERATION_SUCCESSFUL, done_ns + SIM_MASS_ERASE_NS);
+        }
+        break;
+
+    case EBH_CMD_TX_BUFFER_SIZE: {
+        uint8_t data[3] = {EBH_CORE_MSG_DATA, target->buffer_size & 0xFF, (target->buffer_size >> 8) & 0xFF};
+        if(target->device == ebh_device_msp432) {
+            sim_target_message(target, EBH_CORE_MSG_UNKNOWN_COMMAND, done_ns);
+        } else {
+            sim_target_respond(target, data, 3, done_ns);
+        }
+        break;
+    }
+
+    case EBH_CMD_UNLOCK_AND_LOCK_INFO:
+        sim_target_message(target, EBH_CORE_MSG_OPERATION_SUCCESSFUL, done_ns);
+        break;
+
+    case EBH_CMD_TX_DATA_BLOCK:
+    case EBH_CMD_TX_DATA_BLOCK_32: {
+        uint16_t tx_length = core[1 + a_len] + (core[2 + a_len] << 8);
+        uint8_t data[4097];
+        if((tx_length + 1u > target->buffer_size) || (tx_length + 1u > sizeof(data))) {
+            sim_target_message(target, EBH_CORE_MSG_UNKNOWN_COMMAND, done_ns);
+            break;
+        }
+        addr = sim_target_address(core, a_len);
+        data[0] = EBH_CORE_MSG_DATA;
+        for(i = 0; i < tx_length; i++) {
+            data[1 + i] = *sim_target_memory(target, addr + i);
+        }
+        sim_target_respond(target, data, 1 + tx_length - ((tx_length < target->read_short) ? tx_length : target->read_short), done_ns);
+        break;
+    }
+
+    case EBH_CMD_CRC_CHECK:
+    case EBH_CMD_CRC_CHECK_32: {
+        uint16_t crc_length = core[1 + a_len] + (core[2 + a_len] << 8);
+        uint16_t crc = 0xFFFF;
+        uint8_t data[3];
+        addr = sim_target_address(core, a_len);
+        for(i = 0; i < crc_length; i++) {
+            crc = ebh_crc_update(crc, sim_target_memory(target, addr + i), 1);
+        }
+        data[0] = EBH_CORE_MSG_DATA;
+        data[1] = crc & 0xFF;
+        data[2] = (crc >> 8) & 0xFF;
+        sim_target_respond(target, data, 3, done_ns + crc_length * 100u);
+        break;
+    }
+
+    case EBH_CMD_LOAD_PC:
+    case EBH_CMD_LOAD_PC_32:
+    case EBH_CMD_REBOOT_RESET:
+    case EBH_CMD_FACTORY_RESET:
+        // The target leaves the BSL (the host does not read an answer)
+        target->tx_tail = (target->tx_tail + SIM_TARGET_TX_SIZE - 1) % SIM_TARGET_TX_SIZE;
+        target->locked = 1;
+        break;
+
+    default:
+        sim_target_message(target, EBH_CORE_MSG_UNKNOWN_COMMAND, done_ns);
+        break;
+    }
+}
+
+/* The MSP432 BSL measures the baud rate on the first byte (the sync character), up to autobaud_max */
+void sim_target_line(sim_target *target, uint32_t baud) {
+    if(!target->synced && (baud <= target->autobaud_max)) {
+        target->baud = baud;
+    }
+    target->synced = 1;
+}
+
+void sim_target_receive(sim_target *target, uint8_t character, uint64_t now_ns) {
+    uint16_t crc = 0;
+
+    if(now_ns < target->listen_ns) {
+        target->dropped++;
+        return;
+    }
+
+    if(target->rx_count == 0) {
+        if((character == 0xFF) && (target->interface == SIM_TARGET_SPI)) {
+            return;
+        }
+        if((character == EBH_SYNC_CHARACTER) && (target->device == ebh_device_msp432)) {
+            sim_target_queue(target, EBH_UART_ERROR_ACK, now_ns + SIM_ACK_NS);
+            return;
+        }
+        if(character != EBH_HEADER) {
+            target->frame_errors++;
+            sim_target_queue(target, EBH_UART_ERROR_HEADER_INCORRECT, now_ns + SIM_ACK_NS);
+            return;
+        }
+    }
+
+    target->rx[target->rx_count++] = character;
+
+    if(target->rx_count == 3) {
+        target->rx_length = target->rx[1] + (target->rx[2] << 8);
+        if(target->rx_length == 0) {
+            target->frame_errors++;
+            target->rx_count = 0;
+            sim_target_queue(target, EBH_UART_ERROR_PACKET_SIZE_ZERO, now_ns + SIM_ACK_NS);
+        } else if(target->rx_length > target->buffer_size) {
+            target->frame_errors++;
+            target->rx_count = 0;
+            sim_target_queue(target, EBH_UART_ERROR_PACKET_SIZE_EXCEEDS_BUFFER, now_ns + SIM_ACK_NS);
+        }
+        return;
+    }
+
+    if((target->rx_count < 3) || (target->rx_count < target->rx_length + EBH_FRAME_OVERHEAD)) {
+        return;
+    }
+
+    // Frame complete
+    target->rx_count = 0;
+    crc = target->rx[3 + target->rx_length] + (target->rx[4 + target->rx_length] << 8);
+    if(crc != ebh_crc_update(0xFFFF, &target->rx[3], target->rx_length)) {
+        target->frame_errors++;
+        sim_target_queue(target, EBH_UART_ERROR_CHECKSUM_INCORRECT, now_ns + SIM_ACK_NS);
+        return;
+    }
+
+    target->frames++;
+    sim_target_execute(target, &target->rx[3], target->rx_length, now_ns);
+}
+
+uint16_t sim_target_pending(const sim_target *target, uint64_t now_ns) {
+    uint16_t index = target->tx_head;
+    uint16_t count = 0;
+
+    while((index != target->tx_tail) && (target->tx_ready_ns[index] <= now_ns)) {
+        count++;
+        index = (index + 1) % SIM_TARGET_TX_SIZE;
+    }
+    return count;
+}
+
+uint64_t sim_target_next_ready(const sim_target *target) {
+    if(target->tx_head == target->tx_tail) {
+        return UINT64_MAX;
+    }
+    return target->tx_ready_ns[target->tx_head];
+}
+
+uint8_t sim_target_transmit(sim_target *target) {
+    uint8_t character = target->tx[target->tx_head];
+
+    target->tx_head = (target->tx_head + 1) % SIM_TARGET_TX_SIZE;
+
+    // A new baud rate is applied once the ACK of CHANGE_BAUD_RATE left the target
+    if(target->pending_baud && (target->tx_head == target->tx_tail)) {
+        target->baud = target->pending_baud;
+        target->pending_baud = 0;
+    }
+    return character;
+}
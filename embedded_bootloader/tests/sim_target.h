@@ -0,0 +1,93 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Max Groening
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#ifndef EMBEDDED_BOOTLOADER_TESTS_SIM_TARGET_H_
+#define EMBEDDED_BOOTLOADER_TESTS_SIM_TARGET_H_
+
+#include <stdint.h>
+#include "embedded_bootloader/embedded_bootloader.h"
+
+/*
+ * Software model of the MSP430/MSP432 BSL for host side tests.
+ *
+ * Bytes sent by the host are fed with sim_target_receive(), the answers (ACK and core
+ * responses) are read back with sim_target_transmit(). Processing time of the target
+ * is modeled on the simulated clock: every answer byte carries the time it becomes
+ * visible to the host.
+ */
+
+#define SIM_TARGET_MEMORY_SIZE  0x100000u  // 1 MB, see sim_target_memory()
+#define SIM_TARGET_TX_SIZE      8192u  // Holds a TX_DATA_BLOCK answer of the whole MSP432 buffer
+
+/* Peripheral interface of the BSL */
+#define SIM_TARGET_UART  0
+#define SIM_TARGET_SPI   1  // 0xFF between frames are dummy bytes of the master
+
+typedef struct {
+    ebh_device device;
+    uint8_t locked;
+    uint8_t password[256];
+    uint8_t memory[SIM_TARGET_MEMORY_SIZE];
+    uint16_t buffer_size;  // Largest BSL core data packet accepted
+    uint8_t interface;     // SIM_TARGET_UART (default) or SIM_TARGET_SPI
+    uint8_t write_error;   // XORed into every programmed byte (failing flash)
+    uint8_t read_short;    // Bytes missing from every TX_DATA_BLOCK answer
+
+    // Frame reception
+    uint8_t rx[4200];
+    uint16_t rx_count;
+    uint16_t rx_length;
+
+    // Answers to the host, each byte becomes visible at its ready time
+    uint8_t tx[SIM_TARGET_TX_SIZE];
+    uint64_t tx_ready_ns[SIM_TARGET_TX_SIZE];
+    uint16_t tx_head;
+    uint16_t tx_tail;
+    uint64_t busy_until_ns;
+
+    uint32_t baud;            // Current baud rate of the target UART
+    uint32_t pending_baud;    // Applied once the ACK of CHANGE_BAUD_RATE is sent
+    uint32_t autobaud_max;    // MSP432: highest baud rate detected on the first byte, 0 = none
+    uint8_t synced;           // Baud rate measured
+    uint64_t gap_ns;          // Bytes arriving sooner after the last answer are lost
+    uint64_t listen_ns;
+    uint32_t dropped;
+
+    // Statistics
+    uint32_t frames;
+    uint32_t frame_errors;
+    uint32_t commands[256];
+} sim_target;
+
+void sim_target_init(sim_target *target, ebh_device device);
+void sim_target_line(sim_target *target, uint32_t baud);  // Baud rate of the next byte from the host
+void sim_target_receive(sim_target *target, uint8_t character, uint64_t now_ns);
+uint16_t sim_target_pending(const sim_target *target, uint64_t now_ns);
+uint64_t sim_target_next_ready(const sim_target *target);  // UINT64_MAX if nothing is queued
+uint8_t sim_target_transmit(sim_target *target);
+void sim_target_sent(sim_target *target, uint64_t now_ns);  // UART: byte of sim_target_transmit() left the line
+uint8_t *sim_target_memory(sim_target *target, uint32_t addr);
+
+#endif /* EMBEDDED_BOOTLOADER_TESTS_SIM_TARGET_H_ */
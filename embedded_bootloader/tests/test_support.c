@@ -24,6 +24,8 @@
 
 
 #include <stdint.h>
+#include <stdio.h>
+#include "embedded_bootloader/tests/test_support.h"
 
 
 uint8_t password_empty_msp430[] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
@@ -117,3 +119,153 @@ uint8_t payload3[513] = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0
                       0xE0, 0xE1, 0xE2, 0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xEB, 0xEC, 0xED, 0xEE, 0xEF,
                       0xF0, 0xF1, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8, 0xF9, 0xFA, 0xFB, 0xFC, 0xFD, 0xFE, 0xFF,
                       0x00};
+
+
+/*
+ * Checks
+ */
+
+void check(const char *name, uint32_t result, uint32_t expected) {
+    if(result != expected) {
+        printf("FAIL %s: 0x%lX != 0x%lX\n", name, (unsigned long)result, (unsigned long)expected);
+        test_fail++;
+    } else {
+        test_pass++;
+    }
+    test_total++;
+}
+
+
+/*
+ * Image files
+ */
+
+static char *test_image_byte(char *out, uint8_t value) {
+    static const char digits[] = "0123456789ABCDEF";
+    out[0] = digits[value >> 4];
+    out[1] = digits[value & 0x0F];
+    return out + 2;
+}
+
+static char *test_image_hex_record(char *out, uint8_t type, uint16_t offset, const uint8_t *data, uint8_t length) {
+    uint8_t checksum = length + (offset >> 8) + offset + type;
+    uint8_t i = 0;
+
+    *out++ = ':';
+    out = test_image_byte(out, length);
+    out = test_image_byte(out, offset >> 8);
+    out = test_image_byte(out, offset & 0xFF);
+    out = test_image_byte(out, type);
+    for(i = 0; i < length; i++) {
+        out = test_image_byte(out, data[i]);
+        checksum += data[i];
+    }
+    out = test_image_byte(out, (uint8_t)-checksum);
+    *out++ = '\r';
+    *out++ = '\n';
+    return out;
+}
+
+uint32_t test_image_hex(char *out, uint32_t addr, const uint8_t *data, uint32_t length, uint8_t record, uint8_t end) {
+    char *start = out;
+    uint32_t offset = 0;
+    uint32_t chunk = 0;
+    uint8_t upper[2];
+
+    while(offset < length) {
+        if((offset == 0) || (((addr + offset) & 0xFFFF) == 0)) {
+            upper[0] = (addr + offset) >> 24;
+            upper[1] = (addr + offset) >> 16;
+            out = test_image_hex_record(out, 0x04, 0, upper, 2);
+        }
+        chunk = (length - offset < record) ? length - offset : record;
+        if(chunk > 0x10000u - ((addr + offset) & 0xFFFF)) {
+            chunk = 0x10000u - ((addr + offset) & 0xFFFF);  // Records do not cross 64 kB
+        }
+        out = test_image_hex_record(out, 0x00, (addr + offset) & 0xFFFF, &data[offset], chunk);
+        offset += chunk;
+    }
+    if(end) {
+        out = test_image_hex_record(out, 0x01, 0, 0, 0);
+    }
+    return out - start;
+}
+
+uint32_t test_image_txt(char *out, uint32_t addr, const uint8_t *data, uint32_t length, uint8_t record, uint8_t end) {
+    char *start = out;
+    uint32_t i = 0;
+    int8_t shift = 28;
+
+    *out++ = '@';
+    while((shift > 0) && !((addr >> shift) & 0x0F)) {
+        shift -= 4;
+    }
+    for(; shift >= 0; shift -= 4) {
+        *out++ = "0123456789ABCDEF"[(addr >> shift) & 0x0F];
+    }
+    *out++ = '\n';
+    for(i = 0; i < length; i++) {
+        out = test_image_byte(out, data[i]);
+        *out++ = (((i + 1) % record == 0) || (i + 1 == length)) ? '\n' : ' ';
+    }
+    if(end) {
+        *out++ = 'q';
+        *out++ = '\n';
+    }
+    return out - start;
+}
+
+
+/*
+ * ELF files
+ */
+
+static void test_elf_u16(uint8_t *out, uint16_t value) {
+    out[0] = value & 0xFF;
+    out[1] = value >> 8;
+}
+
+static void test_elf_u32(uint8_t *out, uint32_t value) {
+    test_elf_u16(out, value & 0xFFFF);
+    test_elf_u16(&out[2], value >> 16);
+}
+
+uint32_t test_elf(uint8_t *out, uint16_t machine, const test_elf_segment *segments, uint8_t count) {
+    uint32_t offset = 52 + 32u * count;
+    uint8_t *phdr = &out[52];
+    uint32_t i = 0;
+    uint8_t n = 0;
+
+    for(i = 0; i < offset; i++) {
+        out[i] = 0;
+    }
+    out[0] = 0x7F;
+    out[1] = 'E';
+    out[2] = 'L';
+    out[3] = 'F';
+    out[4] = 1;  // 32 bit
+    out[5] = 1;  // Little endian
+    out[6] = 1;
+    test_elf_u16(&out[16], 2);  // Executable
+    test_elf_u16(&out[18], machine);
+    test_elf_u32(&out[20], 1);
+    test_elf_u32(&out[28], 52);
+    test_elf_u16(&out[40], 52);
+    test_elf_u16(&out[42], 32);
+    test_elf_u16(&out[44], count);
+
+    for(n = 0; n < count; n++, phdr += 32) {
+        test_elf_u32(&phdr[0], segments[n].type);
+        test_elf_u32(&phdr[4], offset);
+        test_elf_u32(&phdr[8], segments[n].vaddr);
+        test_elf_u32(&phdr[12], segments[n].paddr);
+        test_elf_u32(&phdr[16], segments[n].filesz);
+        test_elf_u32(&phdr[20], segments[n].memsz);
+        test_elf_u32(&phdr[28], 4);
+        for(i = 0; i < segments[n].filesz; i++) {
+            out[offset + i] = segments[n].data[i];
+        }
+        offset += (segments[n].filesz + 3) & ~3u;
+    }
+    return offset;
+}
@@ -37,4 +37,39 @@ extern uint8_t payload1[16];
 extern uint8_t payload2[256];
 extern uint8_t payload3[513];
 
+/*
+ * Host tests: counts the result, prints name and values if it is not the expected one.
+ * The counters are defined by the test.
+ */
+
+extern uint16_t test_pass;
+extern uint16_t test_fail;
+extern uint16_t test_total;
+
+void check(const char *name, uint32_t result, uint32_t expected);
+
+/*
+ * Image files of a memory range, `record` data bytes per line. Return the length of the text
+ * written to out (no terminating zero). HEX: extended linear address records as needed.
+ */
+
+uint32_t test_image_hex(char *out, uint32_t addr, const uint8_t *data, uint32_t length, uint8_t record, uint8_t end);
+uint32_t test_image_txt(char *out, uint32_t addr, const uint8_t *data, uint32_t length, uint8_t record, uint8_t end);
+
+/*
+ * ELF32 executable (little endian) with one program header per segment, the segment data
+ * follows the headers. Returns the file size.
+ */
+
+typedef struct {
+    uint32_t type;
+    uint32_t vaddr;
+    uint32_t paddr;
+    const uint8_t *data;
+    uint32_t filesz;
+    uint32_t memsz;
+} test_elf_segment;
+
+uint32_t test_elf(uint8_t *out, uint16_t machine, const test_elf_segment *segments, uint8_t count);
+
 #endif /* EMBEDDED_BOOTLOADER_TESTS_TEST_SUPPORT_H_ */
@@ -0,0 +1,46 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Max Groening
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <stdint.h>
+#include "timing.h"
+#include "transport.h"
+#include "devices/devices.h"
+
+ebh_deadline ebh_deadline_in(uint32_t timeout_us) {
+    return ebh_time_us() + timeout_us;
+}
+
+uint8_t ebh_deadline_expired(ebh_deadline deadline) {
+    return (int32_t)(ebh_time_us() - deadline) >= 0;
+}
+
+uint32_t ebh_deadline_left(ebh_deadline deadline) {
+    int32_t left = (int32_t)(deadline - ebh_time_us());
+    return (left > 0) ? (uint32_t)left : 0;
+}
+
+uint32_t ebh_line_time_us(uint32_t bytes) {
+    return (uint32_t)((uint64_t)bytes * 11000000u / ebh_get_baud());
+}
@@ -0,0 +1,46 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Max Groening
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef EMBEDDED_BOOTLOADER_TIMING_H_
+#define EMBEDDED_BOOTLOADER_TIMING_H_
+
+#include <stdint.h>
+
+/*
+ * Deadlines on the free-running microsecond counter of the BSP (ebh_time_us())
+ *
+ * The counter wraps around after 2^32 us (71 minutes), deadlines up to half of that
+ * are compared correctly across the wrap.
+ */
+
+typedef uint32_t ebh_deadline;
+
+ebh_deadline ebh_deadline_in(uint32_t timeout_us);
+uint8_t ebh_deadline_expired(ebh_deadline deadline);
+uint32_t ebh_deadline_left(ebh_deadline deadline);  // 0 once expired
+
+uint32_t ebh_line_time_us(uint32_t bytes);  // 8E1 (11 bit per byte) at the rate of the last ebh_set_baud()
+
+#endif /* EMBEDDED_BOOTLOADER_TIMING_H_ */
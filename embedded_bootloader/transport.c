@@ -0,0 +1,96 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Max Groening
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include <stdint.h>
+#include "config.h"
+#include "transport.h"
+
+
+static const ebh_transport *ebh_transport_active = EBH_DEFAULT_TRANSPORT;
+static uint32_t ebh_transport_baud = 9600;  // Slowest BSL rate until ebh_set_baud() tells otherwise
+
+void ebh_set_transport(const ebh_transport *transport) {
+    ebh_transport_active = transport;
+}
+
+const ebh_transport *ebh_get_transport(void) {
+    return ebh_transport_active;
+}
+
+void ebh_send_char(uint8_t character) {
+    ebh_send_buf(&character, 1);
+}
+
+void ebh_send_buf(const uint8_t *data, uint16_t length) {
+    ebh_iovec iov;
+    iov.data = data;
+    iov.length = length;
+    ebh_transport_active->send(ebh_transport_active->context, &iov, 1);
+}
+
+void ebh_send_iov(const ebh_iovec *iov, uint8_t count) {
+    ebh_transport_active->send(ebh_transport_active->context, iov, count);
+}
+
+uint8_t ebh_receive_char(void) {
+    uint8_t character = 0;
+    ebh_transport_active->receive(ebh_transport_active->context, &character, 1, EBH_TIMEOUT_INFINITE);
+    return character;
+}
+
+uint16_t ebh_receive_char_available(void) {
+    return ebh_transport_active->wait_readable(ebh_transport_active->context, 0);
+}
+
+uint16_t ebh_receive_buf(uint8_t *data, uint16_t length, uint32_t timeout_us) {
+    return ebh_transport_active->receive(ebh_transport_active->context, data, length, timeout_us);
+}
+
+uint8_t ebh_wait_readable(uint32_t timeout_us) {
+    return ebh_transport_active->wait_readable(ebh_transport_active->context, timeout_us);
+}
+
+void ebh_flush(void) {
+    ebh_transport_active->flush(ebh_transport_active->context);
+}
+
+void ebh_wait_tx_idle(void) {
+    if(ebh_transport_active->wait_tx_idle) {
+        ebh_transport_active->wait_tx_idle(ebh_transport_active->context);
+    }
+}
+
+uint8_t ebh_set_baud(uint32_t baud) {
+    uint8_t status = ebh_transport_active->set_baud(ebh_transport_active->context, baud);
+
+    if(status == 0) {
+        ebh_transport_baud = baud;
+    }
+    return status;
+}
+
+uint32_t ebh_get_baud(void) {
+    return ebh_transport_baud;
+}
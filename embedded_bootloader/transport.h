@@ -0,0 +1,104 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2017 Max Groening
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef EMBEDDED_BOOTLOADER_TRANSPORT_H_
+#define EMBEDDED_BOOTLOADER_TRANSPORT_H_
+
+#include <stdint.h>
+
+/*
+ * Transport abstraction
+ *
+ * The protocol layer talks to the BSL through the active ebh_transport. Each peripheral
+ * backend (UART polling, interrupt, DMA, SPI, I2C, host mock ...) provides one instance.
+ * Select it at runtime with ebh_set_transport(); EBH_DEFAULT_TRANSPORT (config.h) is used otherwise.
+ */
+
+#define EBH_TIMEOUT_INFINITE  0xFFFFFFFFu
+
+typedef struct {
+    const uint8_t *data;
+    uint16_t length;
+} ebh_iovec;
+
+typedef struct {
+    void (*send)(void *context, const ebh_iovec *iov, uint8_t count);  // Sends the segments back to back, one frame per call
+    uint16_t (*receive)(void *context, uint8_t *data, uint16_t length, uint32_t timeout_us);  // Returns the number of bytes received
+    uint8_t (*wait_readable)(void *context, uint32_t timeout_us);  // Returns 1 as soon as a byte is available, 0 on timeout
+    void (*flush)(void *context);  // Discards all received but unread bytes
+    uint8_t (*set_baud)(void *context, uint32_t baud);  // Returns 0 or EBH_UART_ERROR_UNKNOWN_BAUD_RATE
+    void (*wait_tx_idle)(void *context);  // Returns once the last byte has left the line, 0 if send does not return earlier
+    void *context;
+} ebh_transport;
+
+void ebh_set_transport(const ebh_transport *transport);
+const ebh_transport *ebh_get_transport(void);
+
+/*
+ * Helpers on the active transport
+ */
+
+void ebh_send_char(uint8_t character);
+void ebh_send_buf(const uint8_t *data, uint16_t length);
+void ebh_send_iov(const ebh_iovec *iov, uint8_t count);
+uint8_t ebh_receive_char(void);
+uint16_t ebh_receive_char_available(void);
+uint16_t ebh_receive_buf(uint8_t *data, uint16_t length, uint32_t timeout_us);
+uint8_t ebh_wait_readable(uint32_t timeout_us);
+void ebh_flush(void);
+void ebh_wait_tx_idle(void);
+uint8_t ebh_set_baud(uint32_t baud);
+uint32_t ebh_get_baud(void);  // Last rate set with ebh_set_baud(), 9600 before
+
+/*
+ * Available transports
+ */
+
+extern const ebh_transport ebh_transport_uart_poll;  // interface_uart_poll.c
+extern const ebh_transport ebh_transport_uart_irq;   // interface_uart_irq.c, call ebh_uart_irq_start() first
+extern const ebh_transport ebh_transport_uart_dma;   // interface_uart_dma.c, call ebh_uart_dma_start() first
+extern const ebh_transport ebh_transport_spi;        // interface_spi.c, ebh_set_baud() sets the SPI clock (Hz)
+extern const ebh_transport ebh_transport_i2c;        // interface_i2c.c, ebh_set_baud() sets the I2C clock (Hz)
+
+/*
+ * UART (interrupt) interface
+ */
+
+void ebh_uart_irq_start(void);
+void ebh_uart_irq_isr(void);  // Called by the BSP from the UART interrupt handler
+uint16_t ebh_uart_irq_rx_overruns(void);
+uint8_t ebh_uart_irq_tx_idle(void);
+
+/*
+ * UART (DMA) interface
+ * The TX hook runs in interrupt context after each completed frame, e.g. to queue the next one.
+ */
+
+void ebh_uart_dma_start(void);
+void ebh_uart_dma_set_tx_hook(void (*hook)(void));
+uint16_t ebh_uart_dma_rx_overruns(void);
+uint8_t ebh_uart_dma_tx_idle(void);
+
+#endif /* EMBEDDED_BOOTLOADER_TRANSPORT_H_ */
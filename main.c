@@ -28,6 +28,7 @@
 
 #include "embedded_bootloader/embedded_bootloader.h"  // Embedded Bootloader Host header
 #include "embedded_bootloader/bootloader_protocol.h"
+#include "embedded_bootloader/link.h"
 
 /*
  * Example passwords for MSP430 and MSP432
@@ -115,17 +116,14 @@ void main(void) {
     ebh_device_init();  // Initialize the host device
 	
     ebh_uart_poll_init();  // Initialize the communication peripheral on the host device
-    ebh_uart_poll_configure_9600_baud();  // Set UART to 9600 baud
 
-    ebh_sync_character();  // Send the initial UART sync character for MSP432 devices
+    if(ebh_link_sync(115200)) {while(1);}  // MSP432: sync character sent directly at 115200 baud
     /* or */
 //    ebh_invoke_sequence();  // Invoke sequence for MSP430 devices
-
-
-    ebh_change_baud_rate(EBH_UART_BAUD_RATE_115200);
-    ebh_delay_between_commands();
-
-    ebh_uart_poll_configure_115200_baud();
+//    ebh_uart_poll_configure_9600_baud();  // Set UART to 9600 baud
+//    ebh_change_baud_rate(EBH_UART_BAUD_RATE_115200);
+//    ebh_delay_between_commands();
+//    ebh_uart_poll_configure_115200_baud();
 
     /* Send the password */
     if(ebh_rx_password_32(password_empty_msp432)) {while(1);}